@@ -19,12 +19,14 @@
 #include <mfast.h>
 #include <mfast/coder/fast_decoder_v2.h>
 #include <mfast/coder/fast_encoder_v2.h>
+#include <mfast/coder/fast_frame_reader.h>
 #include <cstdio>
 #include <iostream>
 #include <cstring>
 #include <limits>
 #include <vector>
 #include "example.h"
+#include "mapped_capture.h"
 
 #include <boost/exception/diagnostic_information.hpp>
 #include <chrono>
@@ -39,7 +41,13 @@ const char usage[] =
   "  -head n     : process only the first 'n' messages\n"
   "  -c count    : repeat the test 'count' times\n"
   "  -r          : Toggle 'reset encoder on every message' (default false).\n"
-  "  -hfix n     : Skip n byte header before each message, (default n=4)\n\n";
+  "  -hfix n     : Skip n byte header before each message, (default n=4)\n"
+  "  -hlen n     : Each message is preceded by its n byte little endian length\n"
+  "  -m          : Map the file into memory instead of reading it\n"
+  "  -p n        : Map the file and prefetch n MB ahead of the decoder in a\n"
+  "                background thread\n"
+  "  -b          : Decode all messages with a single decode_all() call\n"
+  "                instead of one decode() call per message.\n\n";
 
 int read_file(const char* filename, std::vector<char>& contents)
 {
@@ -63,7 +71,11 @@ int main(int argc, const char** argv)
   std::size_t head_n = (std::numeric_limits<std::size_t>::max)();
   std::size_t repeat_count = 1;
   bool force_reset = false;
+  bool batch = false;
   std::size_t skip_header_bytes = 4;;
+  std::size_t length_header_bytes = 0;
+  bool map_file = false;
+  std::size_t prefetch_mb = 0;
   const char* filename = DATA_FILE;
 
   int i = 1;
@@ -94,12 +106,47 @@ int main(int argc, const char** argv)
     else if (std::strcmp(arg, "-hfix") == 0) {
       skip_header_bytes = atoi(argv[i++]);
     }
+    else if (std::strcmp(arg, "-hlen") == 0) {
+      length_header_bytes = atoi(argv[i++]);
+      if (length_header_bytes == 0 || length_header_bytes > 8) {
+        std::cerr << "Invalid argument for '-hlen'\n";
+        parse_status = -1;
+      }
+    }
+    else if (std::strcmp(arg, "-m") == 0) {
+      map_file = true;
+    }
+    else if (std::strcmp(arg, "-p") == 0) {
+      map_file = true;
+      prefetch_mb = atoi(argv[i++]);
+      if (prefetch_mb == 0) {
+        std::cerr << "Invalid argument for '-p'\n";
+        parse_status = -1;
+      }
+    }
+    else if (std::strcmp(arg, "-b") == 0) {
+      batch = true;
+    }
+  }
+
+  if (batch && force_reset) {
+    std::cerr << "'-b' cannot be used with '-r'\n";
+    parse_status = -1;
+  }
+
+  if (batch && prefetch_mb) {
+    std::cerr << "'-b' cannot be used with '-p'\n";
+    parse_status = -1;
   }
 
-  parse_status = read_file(filename, message_contents);
+  mapped_capture capture;
+  if (parse_status == 0)
+    parse_status = map_file ? capture.open(filename) : read_file(filename, message_contents);
+  const char* contents = map_file ? capture.data() : message_contents.data();
+  std::size_t contents_size = map_file ? capture.size() : message_contents.size();
 
 
-  if (parse_status != 0 || message_contents.size() == 0) {
+  if (parse_status != 0 || contents_size == 0) {
     std::cout << '\n' << usage;
     return -1;
   }
@@ -111,7 +158,7 @@ int main(int argc, const char** argv)
 #ifdef WITH_ENCODE
     mfast::fast_encoder_v2 encoder( example::description() );
     std::vector<char> buffer;
-    buffer.resize(message_contents.size());
+    buffer.resize(contents_size);
 
 #endif
 
@@ -119,6 +166,13 @@ int main(int argc, const char** argv)
 
     // boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
 
+    mfast::fast_frame_format frame_format =
+      length_header_bytes ? mfast::fast_frame_format::length_prefix(length_header_bytes, false)
+                          : mfast::fast_frame_format::fixed_header(skip_header_bytes);
+
+    if (prefetch_mb)
+      capture.start_prefetch(prefetch_mb << 20);
+
     typedef std::chrono::high_resolution_clock clock;
     clock::time_point start=clock::now();
     {
@@ -128,14 +182,38 @@ int main(int argc, const char** argv)
         char* buf_beg = &buffer[0];
         char* buf_end = &buffer[buffer.size()];
 #endif
-        const char*first = &message_contents[0] + skip_header_bytes;
-        const char*last = &message_contents[0] + message_contents.size();
+        if (batch) {
+          const char* first = contents;
+          const char* last = contents + contents_size;
+#ifdef WITH_ENCODE
+          bool first_message = true;
+#endif
+          decoder.decode_all(first, last, [&](const mfast::message_cref& msg) {
+#ifdef WITH_ENCODE
+            buf_beg += encoder.encode(msg, buf_beg, buf_end-buf_beg, first_message);
+            first_message = false;
+#endif
+#ifdef WITH_MESSAGE_COPY
+            msg_value = mfast::message_type(msg, &malloc_allc);
+#endif
+            (void)msg;
+          }, true, frame_format.header_size);
+          continue;
+        }
+
+        mfast::fast_frame_reader reader(frame_format, contents,
+                                        contents + contents_size);
+        mfast::fast_frame frame;
         bool first_message = true;
-        while (first < last ) {
+        while (reader.next(frame)) {
+          const char* first = frame.payload;
 #ifdef WITH_ENCODE
           mfast::message_cref msg =
 #endif
-            decoder.decode(first, last, force_reset || first_message );
+            decoder.decode(first, frame.payload + frame.payload_size, force_reset || first_message );
+          reader.consume(first);
+          if (prefetch_mb)
+            capture.consumed(first);
 
 #ifdef WITH_ENCODE
           buf_beg += encoder.encode(msg, buf_beg, buf_end-buf_beg, force_reset || first_message);
@@ -144,7 +222,6 @@ int main(int argc, const char** argv)
           msg_value = mfast::message_type(msg, &malloc_allc);
 #endif
           first_message = false;
-          first += skip_header_bytes;
         }
       }
     }
@@ -19,12 +19,14 @@
 #include <mfast.h>
 #include <mfast/coder/fast_decoder.h>
 #include <mfast/coder/fast_encoder.h>
+#include <mfast/coder/fast_frame_reader.h>
 #include <mfast/xml_parser/dynamic_templates_description.h>
 #include <cstdio>
 #include <iostream>
 #include <cstring>
 #include <limits>
 #include <vector>
+#include "mapped_capture.h"
 
 #include <boost/exception/diagnostic_information.hpp>
 
@@ -43,7 +45,13 @@ const char usage[] =
   "  -head n     : process only the first 'n' messages\n"
   "  -c count    : repeat the test 'count' times\n"
   "  -r          : Toggle 'reset encoder on every message' (default false).\n"
-  "  -hfix n     : Skip n byte header before each message, (default n=4)\n\n";
+  "  -hfix n     : Skip n byte header before each message, (default n=4)\n"
+  "  -hlen n     : Each message is preceded by its n byte little endian length\n"
+  "  -m          : Map the file into memory instead of reading it\n"
+  "  -p n        : Map the file and prefetch n MB ahead of the decoder in a\n"
+  "                background thread\n"
+  "  -s id       : Decode the messages of template 'id' only to keep the\n"
+  "                dictionary in sync, may be repeated\n\n";
 
 
 int read_file(const char* filename, std::vector<char>& contents)
@@ -70,8 +78,12 @@ int main(int argc, const char** argv)
   std::size_t repeat_count = 1;
   bool force_reset = false;
   std::size_t skip_header_bytes = 4;;
+  std::size_t length_header_bytes = 0;
+  bool map_file = false;
+  std::size_t prefetch_mb = 0;
   const char* filename = DATA_FILE;
   const char* template_filename= TEMPLATE_FILE;
+  std::vector<uint32_t> sync_only_ids;
 
   int i = 1;
   int parse_status = 0;
@@ -104,11 +116,36 @@ int main(int argc, const char** argv)
     else if (std::strcmp(arg, "-hfix") == 0) {
       skip_header_bytes = atoi(argv[i++]);
     }
+    else if (std::strcmp(arg, "-hlen") == 0) {
+      length_header_bytes = atoi(argv[i++]);
+      if (length_header_bytes == 0 || length_header_bytes > 8) {
+        std::cerr << "Invalid argument for '-hlen'\n";
+        parse_status = -1;
+      }
+    }
+    else if (std::strcmp(arg, "-m") == 0) {
+      map_file = true;
+    }
+    else if (std::strcmp(arg, "-p") == 0) {
+      map_file = true;
+      prefetch_mb = atoi(argv[i++]);
+      if (prefetch_mb == 0) {
+        std::cerr << "Invalid argument for '-p'\n";
+        parse_status = -1;
+      }
+    }
+    else if (std::strcmp(arg, "-s") == 0) {
+      sync_only_ids.push_back(atoi(argv[i++]));
+    }
   }
 
-  parse_status = read_file(filename, message_contents) || read_file(template_filename, template_contents);
+  mapped_capture capture;
+  parse_status = (map_file ? capture.open(filename) : read_file(filename, message_contents)) ||
+                 read_file(template_filename, template_contents);
+  const char* contents = map_file ? capture.data() : message_contents.data();
+  std::size_t contents_size = map_file ? capture.size() : message_contents.size();
 
-  if (parse_status != 0 || template_contents.size() == 0 || message_contents.size() == 0) {
+  if (parse_status != 0 || template_contents.size() == 0 || contents_size == 0) {
     std::cout << '\n' << usage;
     return -1;
   }
@@ -123,15 +160,24 @@ int main(int argc, const char** argv)
     mfast::fast_decoder coder(alloc);
 
     coder.include({&description});
+    for (uint32_t id : sync_only_ids)
+      coder.sync_only(id);
 
 #ifdef WITH_ENCODE
     mfast::fast_encoder encoder(alloc);
     encoder.include({&description});
     std::vector<char> buffer;
-    buffer.resize(message_contents.size());
+    buffer.resize(contents_size);
 #endif
 
     // boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    mfast::fast_frame_format frame_format =
+      length_header_bytes ? mfast::fast_frame_format::length_prefix(length_header_bytes, false)
+                          : mfast::fast_frame_format::fixed_header(skip_header_bytes);
+
+    if (prefetch_mb)
+      capture.start_prefetch(prefetch_mb << 20);
+
     typedef std::chrono::high_resolution_clock clock;
     clock::time_point start=clock::now();
     {
@@ -141,20 +187,24 @@ int main(int argc, const char** argv)
         char* buf_beg = &buffer[0];
         char* buf_end = buf_beg + buffer.size();
 #endif
-        const char* first = &message_contents[0] + skip_header_bytes;
-        const char* last = &message_contents[0] + message_contents.size();
+        mfast::fast_frame_reader reader(frame_format, contents,
+                                        contents + contents_size);
+        mfast::fast_frame frame;
         bool first_message = true;
-        while (first < last ) {
+        while (reader.next(frame)) {
+          const char* first = frame.payload;
 #ifdef WITH_ENCODE
           mfast::message_cref msg =
 #endif
-          coder.decode(first, last, force_reset || first_message );
+          coder.decode(first, frame.payload + frame.payload_size, force_reset || first_message );
+          reader.consume(first);
+          if (prefetch_mb)
+            capture.consumed(first);
 
 #ifdef WITH_ENCODE
           buf_beg += encoder.encode(msg, buf_beg, buf_end-buf_beg, force_reset || first_message);
 #endif
           first_message = false;
-          first += skip_header_bytes;
         }
       }
     }
@@ -0,0 +1,173 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// A capture file mapped into memory, so that the decoders can read the
+/// messages in place without first copying the whole file.
+///
+/// The kernel is advised that the file is read sequentially; it can then read
+/// ahead and drop the pages already decoded, which keeps the memory use bounded
+/// for captures larger than RAM. Optionally, a background thread touches the
+/// pages ahead of the decoder so that the decoder rarely waits for the disk.
+class mapped_capture {
+public:
+  mapped_capture()
+      : data_(nullptr), size_(0), consumed_(nullptr), stop_(false)
+#if defined(_WIN32)
+        ,
+        file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+#endif
+  {
+  }
+
+  ~mapped_capture() { close(); }
+
+  mapped_capture(const mapped_capture &) = delete;
+  mapped_capture &operator=(const mapped_capture &) = delete;
+
+  /// Map @a filename into memory.
+  ///
+  /// @returns 0 on success, -1 otherwise.
+  int open(const char *filename) {
+    close();
+#if defined(_WIN32)
+    file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if (file_ != INVALID_HANDLE_VALUE && GetFileSizeEx(file_, &size) &&
+        size.QuadPart > 0) {
+      mapping_ =
+          CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping_) {
+        data_ = static_cast<const char *>(
+            MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        size_ = static_cast<std::size_t>(size.QuadPart);
+      }
+    }
+#else
+    int fd = ::open(filename, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+      void *addr = mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                        PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        data_ = static_cast<const char *>(addr);
+        size_ = static_cast<std::size_t>(st.st_size);
+        madvise(addr, size_, MADV_SEQUENTIAL);
+      }
+    }
+    // the mapping stays valid after the descriptor is closed
+    if (fd >= 0)
+      ::close(fd);
+#endif
+    if (data_ == nullptr) {
+      close();
+      std::cerr << "File map error : " << filename << "\n";
+      return -1;
+    }
+    consumed_ = data_;
+    return 0;
+  }
+
+  void close() {
+    stop_prefetch();
+#if defined(_WIN32)
+    if (data_)
+      UnmapViewOfFile(data_);
+    if (mapping_)
+      CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+      CloseHandle(file_);
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (data_)
+      munmap(const_cast<char *>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const char *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+  /// Start a thread which keeps the pages up to @a window bytes ahead of the
+  /// position reported by consumed() resident.
+  void start_prefetch(std::size_t window) {
+    stop_prefetch();
+    stop_ = false;
+    consumed_ = data_;
+    prefetcher_ = std::thread(&mapped_capture::prefetch, this, window);
+  }
+
+  void stop_prefetch() {
+    if (prefetcher_.joinable()) {
+      stop_ = true;
+      prefetcher_.join();
+    }
+  }
+
+  /// Report the decoding progress to the prefetch thread.
+  void consumed(const char *pos) {
+    consumed_.store(pos, std::memory_order_relaxed);
+  }
+
+private:
+  void prefetch(std::size_t window) {
+    const std::size_t page_size = 4096;
+    const char *next = data_;
+    const char *last_pos = data_;
+    const char *end = data_ + size_;
+    volatile char sink = 0;
+    while (!stop_) {
+      const char *pos = consumed_.load(std::memory_order_relaxed);
+      // start over when the file is decoded again
+      if (pos < last_pos)
+        next = pos;
+      last_pos = pos;
+      const char *limit = pos + (std::min<std::size_t>)(window, end - pos);
+      if (next >= limit) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+#if !defined(_WIN32)
+      std::size_t offset =
+          static_cast<std::size_t>(next - data_) & ~(page_size - 1);
+      madvise(const_cast<char *>(data_ + offset), limit - (data_ + offset),
+              MADV_WILLNEED);
+#endif
+      for (; next < limit && !stop_; next += page_size)
+        sink = *next;
+    }
+    (void)sink;
+  }
+
+  const char *data_;
+  std::size_t size_;
+  std::atomic<const char *> consumed_;
+  std::atomic<bool> stop_;
+  std::thread prefetcher_;
+#if defined(_WIN32)
+  HANDLE file_;
+  HANDLE mapping_;
+#endif
+};
@@ -0,0 +1,110 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+//
+// Micro-benchmark of the stop bit scanner used to find the end of ASCII strings
+// and other stop bit encoded entities, compared with a byte at a time loop.
+//
+#include <mfast/coder/decoder/fast_istreambuf.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+const char usage[] =
+    "  -c count    : number of entities scanned for each length (default "
+    "1000000)\n"
+    "  -max n      : longest entity length to measure (default 128)\n\n";
+
+// the loop fast_istreambuf::get_entity_length() used to run
+std::size_t scalar_entity_length(const char *first, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    if (first[i] & 0x80)
+      return i + 1;
+  }
+  return 0;
+}
+
+int main(int argc, const char **argv) {
+  std::size_t repeat_count = 1000000;
+  std::size_t max_length = 128;
+
+  int i = 1;
+  while (i < argc) {
+    const char *arg = argv[i++];
+
+    if (std::strcmp(arg, "-c") == 0 && i < argc) {
+      repeat_count = std::atoi(argv[i++]);
+    } else if (std::strcmp(arg, "-max") == 0 && i < argc) {
+      max_length = std::atoi(argv[i++]);
+    } else {
+      std::cout << '\n' << usage;
+      return -1;
+    }
+  }
+
+  if (repeat_count == 0 || max_length == 0) {
+    std::cout << '\n' << usage;
+    return -1;
+  }
+
+  typedef std::chrono::high_resolution_clock clock;
+  typedef std::chrono::duration<double, std::nano> ns;
+
+  // lay out entities back to back, as they would appear in a FAST stream
+  const std::size_t entities = 64;
+  std::vector<char> buffer;
+
+  std::cout << "length  scalar(ns)  scanner(ns)\n";
+
+  for (std::size_t len = 1; len <= max_length;
+       len = (len < 32 ? len + 1 : len * 2)) {
+    buffer.assign(entities * len + 16, 'A');
+    for (std::size_t e = 0; e < entities; ++e)
+      buffer[e * len + len - 1] |= '\x80';
+
+    std::size_t checksum = 0;
+    const std::size_t rounds = repeat_count / entities + 1;
+
+    clock::time_point start = clock::now();
+    for (std::size_t r = 0; r < rounds; ++r) {
+      const char *first = &buffer[0];
+      const char *last = first + buffer.size();
+      for (std::size_t e = 0; e < entities; ++e) {
+        std::size_t l = scalar_entity_length(first, last - first);
+        checksum += l;
+        first += l;
+      }
+    }
+    double scalar_time = ns(clock::now() - start).count() / (rounds * entities);
+
+    start = clock::now();
+    for (std::size_t r = 0; r < rounds; ++r) {
+      const char *first = &buffer[0];
+      const char *last = first + buffer.size();
+      for (std::size_t e = 0; e < entities; ++e) {
+        mfast::fast_istreambuf sb(first, last - first);
+        std::size_t l = sb.get_entity_length();
+        checksum -= l;
+        first += l;
+      }
+    }
+    double scanner_time =
+        ns(clock::now() - start).count() / (rounds * entities);
+
+    if (checksum != 0) {
+      std::cerr << "entity length mismatch at length " << len << "\n";
+      return -1;
+    }
+
+    std::cout << std::setw(6) << len << std::fixed << std::setprecision(2)
+              << std::setw(12) << scalar_time << std::setw(13) << scanner_time
+              << "\n";
+  }
+
+  return 0;
+}
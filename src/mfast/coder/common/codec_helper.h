@@ -6,20 +6,41 @@
 #pragma once
 
 #include "mfast/string_ref.h"
+#include "dictionary_block.h"
 #include "mfast/exceptions.h"
 #include <stdexcept>
+#include <vector>
 
 namespace mfast {
 namespace detail {
 class codec_helper {
 public:
+  typedef std::vector<std::vector<char>> contents_t;
+
+  codec_helper() : dictionary_(nullptr), contents_(nullptr) {}
+
+  /// Keep the previous values in @a dictionary, indexed by the dictionary
+  /// slots of the instructions, instead of in the instructions themselves.
+  void dictionary(dictionary_block *dictionary) { dictionary_ = dictionary; }
+
+  /// Let the string and byte vector previous values refer to copies of their
+  /// contents in @a contents, indexed by the dictionary slots, instead of to
+  /// the fields they are saved from; nullptr to refer to the fields again.
+  /// Only applies along with dictionary().
+  void contents(contents_t *contents) { contents_ = contents; }
+
   template <typename T> value_storage &previous_value_of(const T &mref) const {
+    if (dictionary_)
+      return (*dictionary_)[mref.instruction()->dictionary_slot()];
     return const_cast<typename T::instruction_type *>(mref.instruction())
         ->prev_value();
   }
 
   template <typename T> void save_previous_value(const T &mref) const {
-    mref.save_to(previous_value_of(mref));
+    value_storage &previous = previous_value_of(mref);
+    mref.save_to(previous);
+    if (contents_)
+      copy_content(mref.instruction(), previous);
   }
 
   template <typename T> void load_previous_value(const T &mref) const {
@@ -134,6 +155,55 @@ public:
       copy_string_raw(mref, delta_start_index, delta_str, delta_len);
     }
   }
+
+private:
+  // only strings and byte vectors have contents
+  void copy_content(const field_instruction *, value_storage &) const {}
+
+  void copy_content(const ascii_field_instruction *inst,
+                    value_storage &previous) const {
+    if (previous.is_empty())
+      return;
+    // the buffer of a slot is reused by the subsequent values
+    std::vector<char> &content = (*contents_)[inst->dictionary_slot()];
+    const char *first = static_cast<const char *>(previous.of_array.content_);
+    content.assign(first, first + previous.array_length());
+    previous.of_array.content_ = content.data();
+  }
+
+  dictionary_block *dictionary_;
+  contents_t *contents_;
 };
+
+// whether the fields of @a lhs and @a rhs have the same types and presence,
+// including those of their nested groups and sequences; i.e. whether the
+// value storages laid out for one can be filled with the other
+inline bool same_layout(const group_field_instruction *lhs,
+                        const group_field_instruction *rhs) {
+  if (lhs == rhs)
+    return true;
+  if (lhs->subinstructions().size() != rhs->subinstructions().size())
+    return false;
+  for (std::size_t i = 0; i < lhs->subinstructions().size(); ++i) {
+    const field_instruction *l = lhs->subinstruction(i);
+    const field_instruction *r = rhs->subinstruction(i);
+    if (l->field_type() != r->field_type() || l->optional() != r->optional())
+      return false;
+    if ((l->field_type() == field_type_group ||
+         l->field_type() == field_type_sequence) &&
+        !same_layout(static_cast<const group_field_instruction *>(l),
+                     static_cast<const group_field_instruction *>(r)))
+      return false;
+  }
+  return true;
+}
+
+// whether a message of @a target can be decoded with the instructions of
+// @a inst, which may be a clone of @a target built by a coder
+inline bool same_template(const template_instruction *target,
+                          const template_instruction *inst) {
+  return target == inst ||
+         (target->id() == inst->id() && same_layout(target, inst));
+}
 }
 }
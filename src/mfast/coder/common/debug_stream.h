@@ -12,6 +12,7 @@
 struct debug_stream {
   debug_stream() {}
   void set(std::ostream *) {}
+  bool enabled() const { return false; }
   template <class T> const debug_stream &operator<<(const T &) const {
     return *this;
   }
@@ -33,6 +34,7 @@ private:
 public:
   debug_stream() : os_(nullptr) {}
   void set(std::ostream *os) { os_ = os; }
+  bool enabled() const { return os_ != nullptr; }
   template <class T> const debug_stream &operator<<(const T &t) const {
     if (os_ != nullptr)
       *os_ << t;
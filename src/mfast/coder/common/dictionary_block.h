@@ -0,0 +1,108 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "mfast/value_storage.h"
+#include <vector>
+#include <stdint.h>
+
+namespace mfast {
+
+/// The previous values of the fields of a coder in one dense array, indexed
+/// by the dictionary slots which dictionary_builder assigns to the
+/// instructions.
+///
+/// Resetting the dictionary does not visit the values. Instead, each value is
+/// stamped with the generation of the dictionary in which it was last
+/// accessed, and reset() starts a new generation; a value from an earlier
+/// generation is undefined and is cleared the next time it is accessed.
+class dictionary_block {
+public:
+  dictionary_block() : generation_(1) {}
+
+  dictionary_block(const dictionary_block &) = delete;
+  dictionary_block &operator=(const dictionary_block &) = delete;
+
+  /// Append an undefined value and return its slot.
+  ///
+  /// @param resettable false if the value is never read by the coders, such
+  ///                   as that of a field without operator, and thus need
+  ///                   not be cleared by reset().
+  uint32_t add(bool resettable) {
+    entries_.emplace_back();
+    entries_.back().generation = resettable ? 0 : permanent;
+    return static_cast<uint32_t>(entries_.size() - 1);
+  }
+
+  /// Make the layout of the dictionary that of @a other, with all the values
+  /// undefined.
+  void assign_layout(const dictionary_block &other) {
+    entries_.assign(other.entries_.size(), entry());
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+      if (other.entries_[i].generation == permanent)
+        entries_[i].generation = permanent;
+    }
+  }
+
+  std::size_t size() const { return entries_.size(); }
+
+  /// The value of @a slot, which is undefined if the dictionary has been
+  /// reset since the value was last accessed.
+  value_storage &operator[](uint32_t slot) {
+    entry &e = entries_[slot];
+    if (e.generation < generation_) {
+      e.generation = generation_;
+      e.value.defined(false);
+    }
+    return e.value;
+  }
+
+  /// The value of @a slot as stored, regardless of its generation.
+  value_storage &raw(uint32_t slot) { return entries_[slot].value; }
+  const value_storage &raw(uint32_t slot) const { return entries_[slot].value; }
+  uint32_t &generation_of(uint32_t slot) { return entries_[slot].generation; }
+
+  /// Whether reset() clears the value of @a slot.
+  bool resettable(uint32_t slot) const {
+    return entries_[slot].generation != permanent;
+  }
+
+  /// Whether the value of @a slot is defined, without clearing it.
+  bool is_defined(uint32_t slot) const {
+    const entry &e = entries_[slot];
+    return e.generation >= generation_ && e.value.is_defined();
+  }
+
+  /// Make all the values undefined.
+  void reset() {
+    if (++generation_ == permanent) {
+      // the stamps of the first generations would become current again
+      for (auto &e : entries_) {
+        if (e.generation != permanent)
+          e.generation = 0;
+      }
+      generation_ = 1;
+    }
+  }
+
+  uint32_t generation() const { return generation_; }
+  void generation(uint32_t value) { generation_ = value; }
+
+private:
+  static const uint32_t permanent = 0xFFFFFFFF;
+
+  // a value is stored along with its stamp, which is checked on every access
+  struct entry {
+    entry() : generation(0) {}
+
+    value_storage value;
+    uint32_t generation;
+  };
+
+  std::vector<entry> entries_;
+  uint32_t generation_;
+};
+}
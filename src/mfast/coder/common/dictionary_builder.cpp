@@ -54,7 +54,13 @@ std::string qualified_name(const char *ns, const char *name) {
 }
 
 dictionary_builder::dictionary_builder(template_repo_base &repo_base)
-    : repo_base_(repo_base), alloc_(repo_base.instruction_alloc_) {}
+    : repo_base_(repo_base), shared_(nullptr),
+      alloc_(repo_base.instruction_alloc_) {}
+
+dictionary_builder::dictionary_builder(template_repo_base &repo_base,
+                                       const template_set *shared)
+    : repo_base_(repo_base), shared_(shared),
+      alloc_(repo_base.instruction_alloc_) {}
 
 void dictionary_builder::build_group(const field_instruction *fi,
                                      const group_field_instruction *src,
@@ -104,6 +110,16 @@ dictionary_builder::clone_instruction(const template_instruction *src_inst) {
                           << template_name_info(src_inst->name()));
   }
 
+  if (shared_) {
+    // the dictionary slots have been assigned when the shared instructions
+    // were built
+    const template_instruction *inst = shared_->find(id);
+    if (inst == nullptr)
+      BOOST_THROW_EXCEPTION(
+          coder::template_not_found_error(src_inst->name(), ""));
+    return const_cast<template_instruction *>(inst);
+  }
+
   auto dest = new (alloc_) template_instruction(*src_inst);
 
   const char *ns = src_inst->ns();
@@ -166,13 +182,14 @@ void dictionary_builder::visit(const sequence_field_instruction *src_inst,
 value_storage *dictionary_builder::get_dictionary_storage(
     const char *key, const char *ns, const op_context_t *op_context,
     field_type_enum_t field_type, value_storage *candidate_storage,
-    field_instruction *instruction) {
+    field_instruction *instruction, uint32_t &slot, bool is_vector) {
   operator_enum_t field_operator = instruction->field_operator();
 
   // except for the specified operators, the field will never depened on
   // previous values
   if (field_operator != operator_delta && field_operator != operator_copy &&
       field_operator != operator_increment && field_operator != operator_tail) {
+    slot = repo_base_.add_dictionary_entry(field_type, is_vector, nullptr);
     return candidate_storage;
   }
 
@@ -228,6 +245,7 @@ value_storage *dictionary_builder::get_dictionary_storage(
   if (itr != indexer_.end()) {
     if (itr->second.field_type_ == field_type) {
       itr->second.instruction_->previous_value_shared(true);
+      slot = itr->second.slot_;
       return itr->second.storage_;
     } else
       BOOST_THROW_EXCEPTION(key_type_mismatch_error(
@@ -239,7 +257,9 @@ value_storage *dictionary_builder::get_dictionary_storage(
   v.field_type_ = field_type;
   v.instruction_ = instruction;
   v.storage_ = candidate_storage;
-  repo_base_.add_reset_entry(candidate_storage);
+  v.slot_ = repo_base_.add_dictionary_entry(field_type, is_vector,
+                                          qualified_key.c_str());
+  slot = v.slot_;
 
   return candidate_storage;
 }
@@ -251,7 +271,8 @@ void dictionary_builder::visit(const int32_field_instruction *src_inst,
   dest = new (alloc_) int32_field_instruction(*src_inst);
   dest->prev_value_ =
       get_dictionary_storage(dest->name(), dest->ns(), dest->op_context_,
-                             field_type_int32, &dest->prev_storage_, dest);
+                             field_type_int32, &dest->prev_storage_, dest,
+                             dest->dictionary_slot_);
 }
 
 void dictionary_builder::visit(const uint32_field_instruction *src_inst,
@@ -261,7 +282,8 @@ void dictionary_builder::visit(const uint32_field_instruction *src_inst,
   dest = new (alloc_) uint32_field_instruction(*src_inst);
   dest->prev_value_ =
       get_dictionary_storage(dest->name(), dest->ns(), dest->op_context_,
-                             field_type_uint32, &dest->prev_storage_, dest);
+                             field_type_uint32, &dest->prev_storage_, dest,
+                             dest->dictionary_slot_);
 }
 
 void dictionary_builder::visit(const int64_field_instruction *src_inst,
@@ -271,7 +293,8 @@ void dictionary_builder::visit(const int64_field_instruction *src_inst,
   dest = new (alloc_) int64_field_instruction(*src_inst);
   dest->prev_value_ =
       get_dictionary_storage(dest->name(), dest->ns(), dest->op_context_,
-                             field_type_int64, &dest->prev_storage_, dest);
+                             field_type_int64, &dest->prev_storage_, dest,
+                             dest->dictionary_slot_);
 }
 
 void dictionary_builder::visit(const uint64_field_instruction *src_inst,
@@ -281,7 +304,8 @@ void dictionary_builder::visit(const uint64_field_instruction *src_inst,
   dest = new (alloc_) uint64_field_instruction(*src_inst);
   dest->prev_value_ =
       get_dictionary_storage(dest->name(), dest->ns(), dest->op_context_,
-                             field_type_uint64, &dest->prev_storage_, dest);
+                             field_type_uint64, &dest->prev_storage_, dest,
+                             dest->dictionary_slot_);
 }
 
 void dictionary_builder::visit(const ascii_field_instruction *src_inst,
@@ -291,8 +315,7 @@ void dictionary_builder::visit(const ascii_field_instruction *src_inst,
   dest = new (alloc_) ascii_field_instruction(*src_inst);
   dest->prev_value_ = get_dictionary_storage(
       dest->name(), dest->ns(), dest->op_context_, field_type_ascii_string,
-      &dest->prev_storage_, dest);
-  repo_base_.add_vector_entry(dest->prev_value_);
+      &dest->prev_storage_, dest, dest->dictionary_slot_, true);
 }
 
 void dictionary_builder::visit(const unicode_field_instruction *src_inst,
@@ -302,9 +325,8 @@ void dictionary_builder::visit(const unicode_field_instruction *src_inst,
   dest = new (alloc_) unicode_field_instruction(*src_inst);
   dest->prev_value_ = get_dictionary_storage(
       dest->name(), dest->ns(), dest->op_context_, field_type_unicode_string,
-      &dest->prev_storage_, dest);
+      &dest->prev_storage_, dest, dest->dictionary_slot_, true);
 
-  repo_base_.add_vector_entry(dest->prev_value_);
 }
 
 void dictionary_builder::visit(const decimal_field_instruction *src_inst,
@@ -316,7 +338,8 @@ void dictionary_builder::visit(const decimal_field_instruction *src_inst,
   if (src_inst->field_type() == field_type_decimal) {
     dest->prev_value_ =
         get_dictionary_storage(dest->name(), dest->ns(), dest->op_context(),
-                               field_type_decimal, &dest->prev_storage_, dest);
+                               field_type_decimal, &dest->prev_storage_, dest,
+                               dest->dictionary_slot_);
   } else {
 
     dest->mantissa_instruction_ = new (alloc_)
@@ -328,12 +351,14 @@ void dictionary_builder::visit(const decimal_field_instruction *src_inst,
         mantissa_name.c_str(), dest->ns(),
         dest->mantissa_instruction_->op_context(), field_type_int64,
         &dest->mantissa_instruction_->prev_storage_,
-        dest->mantissa_instruction_);
+        dest->mantissa_instruction_,
+        dest->mantissa_instruction_->dictionary_slot_);
     std::string exponent_name = dest->name();
     exponent_name += "....exponent";
     dest->prev_value_ = get_dictionary_storage(
         exponent_name.c_str(), dest->ns(), dest->op_context(),
-        field_type_exponent, &dest->prev_storage_, dest);
+        field_type_exponent, &dest->prev_storage_, dest,
+        dest->dictionary_slot_);
   }
 }
 
@@ -344,8 +369,7 @@ void dictionary_builder::visit(const byte_vector_field_instruction *src_inst,
   dest = new (alloc_) byte_vector_field_instruction(*src_inst);
   dest->prev_value_ = get_dictionary_storage(
       dest->name(), dest->ns(), dest->op_context(), field_type_byte_vector,
-      &dest->prev_storage_, dest);
-  repo_base_.add_vector_entry(dest->prev_value_);
+      &dest->prev_storage_, dest, dest->dictionary_slot_, true);
 }
 
 void dictionary_builder::visit(const int32_vector_field_instruction *src_inst,
@@ -383,6 +407,7 @@ void dictionary_builder::visit(const enum_field_instruction *src_inst,
   dest = new (alloc_) enum_field_instruction(*src_inst);
   dest->prev_value_ =
       get_dictionary_storage(dest->name(), dest->ns(), dest->op_context_,
-                             field_type_uint64, &dest->prev_storage_, dest);
+                             field_type_uint64, &dest->prev_storage_, dest,
+                             dest->dictionary_slot_);
 }
 }
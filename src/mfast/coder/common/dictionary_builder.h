@@ -53,11 +53,17 @@ template <std::size_t N>
 using make_index_sequence = make_integer_sequence<std::size_t, N>;
 
 class template_repo_base;
+class template_set;
 class MFAST_CODER_EXPORT dictionary_builder
     : private field_instruction_visitor {
 public:
   dictionary_builder(template_repo_base &repo_base);
 
+  /// Build the dictionary of @a repo_base for the instructions of @a shared;
+  /// the templates are taken from @a shared instead of being cloned.
+  dictionary_builder(template_repo_base &repo_base,
+                     const template_set *shared);
+
   template <typename Operation>
   void build(const Operation &op, const templates_description *def) {
     current_ns_ = def->template_ns();
@@ -132,7 +138,8 @@ private:
                                         const op_context_t *op_context,
                                         field_type_enum_t field_type,
                                         value_storage *candidate_storage,
-                                        field_instruction *instruction);
+                                        field_instruction *instruction,
+                                        uint32_t &slot, bool is_vector = false);
 
   template_instruction *find_template(uint32_t template_id);
 
@@ -140,6 +147,7 @@ private:
     field_type_enum_t field_type_;
     field_instruction *instruction_;
     value_storage *storage_;
+    uint32_t slot_;
   };
 
   typedef std::map<std::string, indexer_value_type> indexer_t;
@@ -150,6 +158,7 @@ private:
   const char *current_dictionary_;
 
   template_repo_base &repo_base_;
+  const template_set *shared_;
   arena_allocator &alloc_;
 };
 }
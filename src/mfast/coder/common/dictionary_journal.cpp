@@ -0,0 +1,106 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#include "dictionary_journal.h"
+#include "template_repo.h"
+
+namespace mfast {
+
+dictionary_journal::dictionary_journal(std::size_t max_entries,
+                                       std::size_t max_bytes)
+    : entries_(max_entries), bytes_(max_bytes), num_entries_(0),
+      num_bytes_(0), overflow_(false), reset_recorded_(false),
+      generation_before_reset_(0), dictionary_(nullptr) {}
+
+void dictionary_journal::record(const int32_mref &mref) {
+  record_field(mref.instruction());
+}
+
+void dictionary_journal::record(const uint32_mref &mref) {
+  record_field(mref.instruction());
+}
+
+void dictionary_journal::record(const int64_mref &mref) {
+  record_field(mref.instruction());
+}
+
+void dictionary_journal::record(const uint64_mref &mref) {
+  record_field(mref.instruction());
+}
+
+void dictionary_journal::record(const exponent_mref &mref) {
+  record_field(mref.instruction());
+}
+
+void dictionary_journal::record(const decimal_mref &mref) {
+  record_field(mref.instruction());
+  const mantissa_field_instruction *mantissa_inst =
+      mref.instruction()->mantissa_instruction();
+  if (mantissa_inst)
+    record_field(mantissa_inst);
+}
+
+void dictionary_journal::record(const ascii_string_mref &mref) {
+  record_vector(mref);
+}
+
+void dictionary_journal::record(const unicode_string_mref &mref) {
+  record_vector(mref);
+}
+
+void dictionary_journal::record(const byte_vector_mref &mref) {
+  record_vector(mref);
+}
+
+void dictionary_journal::record_reset(const template_repo_base &repo) {
+  generation_before_reset_ = repo.dictionary_.generation();
+  reset_recorded_ = true;
+}
+
+void dictionary_journal::restore_vector(const entry &e) {
+  value_storage &field = *e.field;
+  const uint32_t len = e.old_value.array_length();
+
+  // keep the room for the null terminator the string references expect
+  if (field.of_array.capacity_in_bytes_ <= len) {
+    if (field.of_array.capacity_in_bytes_ == 0)
+      field.of_array.content_ = nullptr;
+    field.of_array.capacity_in_bytes_ = static_cast<uint32_t>(e.alloc->reallocate(
+        field.of_array.content_, field.of_array.capacity_in_bytes_, len + 1));
+  }
+  std::memcpy(field.of_array.content_, &bytes_[e.bytes_offset], len);
+  field.array_length(len);
+
+  *e.value = e.old_value;
+  e.value->of_array.content_ = field.of_array.content_;
+  e.value->of_array.capacity_in_bytes_ = 0;
+}
+
+bool dictionary_journal::rollback(template_repo_base &repo) {
+  if (overflow_) {
+    repo.reset_dictionary();
+  } else {
+    for (std::size_t i = num_entries_; i > 0; --i) {
+      const entry &e = entries_[i - 1];
+      if (e.field && e.old_value.is_defined() &&
+          e.old_value.array_length() > 0)
+        restore_vector(e);
+      else
+        *e.value = e.old_value;
+      if (e.generation)
+        *e.generation = e.old_generation;
+    }
+
+    // the values untouched by the message become defined again
+    if (reset_recorded_)
+      repo.dictionary_.generation(generation_before_reset_);
+  }
+
+  num_entries_ = 0;
+  num_bytes_ = 0;
+  reset_recorded_ = false;
+  return !overflow_;
+}
+}
@@ -0,0 +1,185 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "../mfast_coder_export.h"
+#include "mfast/field_instructions.h"
+#include "mfast/int_ref.h"
+#include "mfast/decimal_ref.h"
+#include "mfast/string_ref.h"
+#include "mfast/vector_ref.h"
+#include "dictionary_block.h"
+#include <cstring>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4251) // non dll-interface class used as a member for
+                                // dll-interface class
+#endif                          //_MSC_VER
+
+namespace mfast {
+class template_repo_base;
+
+/// Undo log of the dictionary values modified while decoding one message.
+///
+/// The decoder records the dictionary value of each field before decoding it,
+/// so that a message which fails to decode can be rolled back and leave the
+/// dictionary as it was before the message. The log has a fixed capacity
+/// allocated at construction; no memory is allocated while recording.
+class MFAST_CODER_EXPORT dictionary_journal {
+public:
+  /// @param max_entries The maximum number of dictionary values recorded for
+  ///                    one message.
+  /// @param max_bytes The maximum number of string and byte vector bytes
+  ///                  recorded for one message.
+  dictionary_journal(std::size_t max_entries = 1024,
+                     std::size_t max_bytes = 16 * 1024);
+
+  /// Discard the records of the previous message.
+  ///
+  /// @param dictionary The dictionary of the decoder, see
+  ///                   template_repo_base::dictionary(); nullptr if the
+  ///                   previous values are kept in the instructions.
+  void clear(dictionary_block *dictionary = nullptr) {
+    dictionary_ = dictionary;
+    num_entries_ = 0;
+    num_bytes_ = 0;
+    overflow_ = false;
+    reset_recorded_ = false;
+  }
+
+  /// Record the dictionary value of a field which is about to be decoded.
+  void record(const int32_mref &mref);
+  void record(const uint32_mref &mref);
+  void record(const int64_mref &mref);
+  void record(const uint64_mref &mref);
+  void record(const exponent_mref &mref);
+  void record(const decimal_mref &mref);
+  void record(const ascii_string_mref &mref);
+  void record(const unicode_string_mref &mref);
+  void record(const byte_vector_mref &mref);
+
+  /// Record the dictionary state before it is reset.
+  void record_reset(const template_repo_base &repo);
+
+  /// Restore the recorded values in reverse order and clear the log.
+  ///
+  /// If the message modified more values than the log can hold, the earlier
+  /// state cannot be restored and the whole dictionary is reset instead.
+  ///
+  /// @returns false if the dictionary had to be reset.
+  bool rollback(template_repo_base &repo);
+
+  /// Returns true if the current message has modified more values than the
+  /// log can hold. The flag stays set after rollback() until clear().
+  bool overflow() const { return overflow_; }
+
+private:
+  struct entry {
+    value_storage *value;
+    value_storage old_value;
+    // the generation stamp of the value, see dictionary_block
+    uint32_t *generation;
+    uint32_t old_generation;
+    // the message field whose storage receives the recorded bytes, only used
+    // for strings and byte vectors
+    value_storage *field;
+    mfast::allocator *alloc;
+    std::size_t bytes_offset;
+  };
+
+  static bool uses_dictionary(const field_instruction *inst) {
+    switch (inst->field_operator()) {
+    case operator_copy:
+    case operator_increment:
+    case operator_delta:
+    case operator_tail:
+      return true;
+    default:
+      return inst->previous_value_shared();
+    }
+  }
+
+  // the values are recorded as stored, before the decoder clears those of
+  // an earlier generation
+  template <typename Instruction>
+  value_storage &previous_value_of(const Instruction *inst) const {
+    if (dictionary_)
+      return dictionary_->raw(inst->dictionary_slot());
+    return const_cast<Instruction *>(inst)->prev_value();
+  }
+
+  template <typename Instruction>
+  uint32_t *generation_of(const Instruction *inst) const {
+    if (dictionary_)
+      return &dictionary_->generation_of(inst->dictionary_slot());
+    return nullptr;
+  }
+
+  template <typename Instruction> void record_field(const Instruction *inst) {
+    if (uses_dictionary(inst))
+      record_value(previous_value_of(inst), generation_of(inst));
+  }
+
+  entry *next_entry() {
+    if (num_entries_ == entries_.size()) {
+      overflow_ = true;
+      return nullptr;
+    }
+    return &entries_[num_entries_++];
+  }
+
+  void record_value(value_storage &value, uint32_t *generation) {
+    entry *e = next_entry();
+    if (e) {
+      e->value = &value;
+      e->old_value = value;
+      e->generation = generation;
+      e->old_generation = generation ? *generation : 0;
+      e->field = nullptr;
+    }
+  }
+
+  // The previous value of a string shares its content with the message field
+  // it was decoded into, which the decoding may overwrite. The bytes are
+  // therefore copied as well and written back to the field on rollback.
+  template <typename VectorMRef> void record_vector(const VectorMRef &mref) {
+    if (!uses_dictionary(mref.instruction()))
+      return;
+    value_storage &value = previous_value_of(mref.instruction());
+    std::size_t len = value.is_defined() ? value.array_length() : 0;
+    if (len > bytes_.size() - num_bytes_) {
+      overflow_ = true;
+      return;
+    }
+    entry *e = next_entry();
+    if (e) {
+      e->value = &value;
+      e->old_value = value;
+      e->generation = generation_of(mref.instruction());
+      e->old_generation = e->generation ? *e->generation : 0;
+      e->field =
+          mref.allocator() ? field_mref_core_access::storage_of(mref) : nullptr;
+      e->alloc = mref.allocator();
+      e->bytes_offset = num_bytes_;
+      if (len)
+        std::memcpy(&bytes_[num_bytes_], value.of_array.content_, len);
+      num_bytes_ += len;
+    }
+  }
+
+  void restore_vector(const entry &e);
+
+  std::vector<entry> entries_;
+  std::vector<char> bytes_;
+  std::size_t num_entries_;
+  std::size_t num_bytes_;
+  bool overflow_;
+  bool reset_recorded_;
+  uint32_t generation_before_reset_;
+  dictionary_block *dictionary_;
+};
+}
@@ -12,10 +12,12 @@ namespace coder {
 struct tag_template_id;
 struct tag_referenced_by;
 struct tag_template_name;
+struct tag_field_path;
 
 typedef boost::error_info<tag_template_id, unsigned> template_id_info;
 typedef boost::error_info<tag_referenced_by, std::string> referenced_by_info;
 typedef boost::error_info<tag_template_name, std::string> template_name_info;
+typedef boost::error_info<tag_field_path, std::string> field_path_info;
 
 class template_not_found_error : public fast_dynamic_error {
 public:
@@ -26,10 +28,40 @@ public:
   }
 };
 
+/// Thrown when a message extends beyond the end of the input buffer.
+class buffer_underflow_error : public fast_dynamic_error {
+public:
+  buffer_underflow_error() : fast_dynamic_error("Buffer underflow") {}
+};
+
 class duplicate_template_id_error : public fast_static_error {
 public:
   duplicate_template_id_error(unsigned tid) { *this << template_id_info(tid); }
 };
+
+/// Thrown when a field path does not name a field of a template.
+class field_not_found_error : public fast_static_error {
+public:
+  field_not_found_error(unsigned tid, const char *path) {
+    *this << template_id_info(tid) << field_path_info(path);
+  }
+};
+
+/// Thrown when a message is decoded into a message of another template.
+class template_mismatch_error : public fast_dynamic_error {
+public:
+  template_mismatch_error(unsigned tid)
+      : fast_dynamic_error("Template mismatch") {
+    *this << template_id_info(tid);
+  }
+};
+
+/// Thrown when a dictionary snapshot is malformed or was saved from a
+/// dictionary of another layout.
+class dictionary_snapshot_error : public fast_static_error {
+public:
+  dictionary_snapshot_error(const char *reason) : fast_static_error(reason) {}
+};
 } /* coder */
 
 } /* mfast */
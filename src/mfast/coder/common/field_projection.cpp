@@ -0,0 +1,142 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#include "field_projection.h"
+#include "exceptions.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mfast {
+
+namespace {
+// the selected fields of an aggregate, by index
+struct selection {
+  std::vector<bool> fields;
+  bool all;
+};
+
+typedef std::unordered_map<const group_field_instruction *, selection>
+    selections_t;
+
+// Whether a field outside the projection can be consumed without being
+// stored. The fields whose operators use the dictionary are always decoded
+// since their previous values refer to the message storage.
+bool skippable(const field_instruction *inst) {
+  switch (inst->field_operator()) {
+  case operator_none:
+  case operator_constant:
+  case operator_default:
+    break;
+  default:
+    return false;
+  }
+  switch (inst->field_type()) {
+  case field_type_int32:
+  case field_type_uint32:
+  case field_type_int64:
+  case field_type_uint64:
+  case field_type_decimal:
+  case field_type_ascii_string:
+  case field_type_unicode_string:
+  case field_type_byte_vector:
+  case field_type_enum:
+    return !inst->previous_value_shared();
+  default:
+    return false;
+  }
+}
+
+int find_subinstruction_index(const group_field_instruction *inst,
+                              const std::string &name) {
+  char *end;
+  unsigned long id = std::strtoul(name.c_str(), &end, 10);
+  if (!name.empty() && *end == '\0')
+    return inst->find_subinstruction_index_by_id(static_cast<uint32_t>(id));
+  return inst->find_subinstruction_index_by_name(name.c_str());
+}
+
+void select(selections_t &selections, const template_instruction *inst,
+            const char *path) {
+  const group_field_instruction *aggregate = inst;
+  const char *first = path;
+  for (;;) {
+    const char *last = std::strchr(first, '.');
+    std::string name = last ? std::string(first, last) : std::string(first);
+    int index = find_subinstruction_index(aggregate, name);
+    if (index < 0)
+      BOOST_THROW_EXCEPTION(coder::field_not_found_error(inst->id(), path));
+
+    selection &entry = selections[aggregate];
+    if (entry.fields.empty())
+      entry.fields.resize(aggregate->subinstructions().size());
+    entry.fields[index] = true;
+
+    const field_instruction *subinst = aggregate->subinstruction(index);
+    bool is_aggregate = subinst->field_type() == field_type_group ||
+                        subinst->field_type() == field_type_sequence;
+    const group_field_instruction *nested =
+        is_aggregate ? static_cast<const group_field_instruction *>(subinst)
+                     : nullptr;
+    if (last == nullptr) {
+      if (nested)
+        selections[nested].all = true;
+      return;
+    }
+    if (nested == nullptr)
+      BOOST_THROW_EXCEPTION(coder::field_not_found_error(inst->id(), path));
+    aggregate = nested;
+    first = last + 1;
+  }
+}
+
+void collect(const selections_t &selections,
+             const group_field_instruction *inst, bool selected,
+             std::unordered_set<const field_instruction *> &skipped) {
+  // a field is selected unless the projection of its aggregate leaves it out
+  const selection *projection = nullptr;
+  selections_t::const_iterator it = selections.find(inst);
+  if (it != selections.end() && !it->second.all)
+    projection = &it->second;
+
+  for (std::size_t i = 0; i < inst->subinstructions().size(); ++i) {
+    const field_instruction *subinst = inst->subinstruction(i);
+    bool field_selected =
+        selected && (projection == nullptr || projection->fields[i]);
+
+    switch (subinst->field_type()) {
+    case field_type_sequence:
+      if (!field_selected)
+        skipped.insert(subinst);
+    // fall through
+    case field_type_group:
+      collect(selections, static_cast<const group_field_instruction *>(subinst),
+              field_selected, skipped);
+      break;
+    default:
+      if (!field_selected && skippable(subinst))
+        skipped.insert(subinst);
+      break;
+    }
+  }
+}
+}
+
+field_projection::field_projection(const template_instruction *inst,
+                                   const char *const *paths,
+                                   std::size_t count) {
+  selections_t selections;
+  selections[inst].fields.resize(inst->subinstructions().size());
+  for (std::size_t i = 0; i < count; ++i)
+    select(selections, inst, paths[i]);
+  collect(selections, inst, true, skipped_);
+}
+
+bool field_projection::skipped(const field_instruction *inst) const {
+  return skipped_.count(inst) != 0;
+}
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "../mfast_coder_export.h"
+#include "mfast/instructions/template_instruction.h"
+#include <unordered_set>
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4251) // non dll-interface class used as a member for
+                                // dll-interface class
+#endif                          //_MSC_VER
+
+namespace mfast {
+
+/// The fields of a template which are left out of a projection, see
+/// fast_decoder::projection().
+///
+/// A field outside the projection is skipped if it can be consumed from the
+/// stream without being stored: it has no operator, or a constant or default
+/// operator, and its previous value is not shared. The fields whose operators
+/// use the dictionary are always decoded. A sequence outside the projection
+/// is skipped as a whole, while the fields of its elements follow the same
+/// rule as the other fields.
+class MFAST_CODER_EXPORT field_projection {
+public:
+  /// Select the fields of @a inst named by @a paths.
+  ///
+  /// Throws coder::field_not_found_error if a path does not name a field of
+  /// @a inst. No path selects no field, which skips every field that can be.
+  ///
+  /// @param paths The selected fields, each as a list of field names or ids
+  ///              separated by '.'; a path naming a group or a sequence
+  ///              selects all of its fields.
+  field_projection(const template_instruction *inst, const char *const *paths,
+                   std::size_t count);
+
+  /// Whether the field or sequence @a inst is skipped.
+  bool skipped(const field_instruction *inst) const;
+
+private:
+  std::unordered_set<const field_instruction *> skipped_;
+};
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#include "stop_bit.h"
+
+#if defined(MFAST_HAS_SSE2) && defined(__GNUC__) &&                            \
+    (defined(__x86_64__) || defined(__i386__))
+#define MFAST_HAS_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace mfast {
+namespace detail {
+namespace {
+
+std::size_t find_stop_bit_words(const char *first, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t mask = load_uint64_le(first + i) & stop_bits_mask;
+    if (mask)
+      return i + count_trailing_zeros(mask) / 8;
+  }
+  for (; i < n; ++i) {
+    if (first[i] & 0x80)
+      return i;
+  }
+  return n;
+}
+
+#ifdef MFAST_HAS_SSE2
+std::size_t find_stop_bit_sse2(const char *first, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + i))));
+    if (mask)
+      return i + count_trailing_zeros(mask);
+  }
+  return i + find_stop_bit_words(first + i, n - i);
+}
+#endif
+
+#ifdef MFAST_HAS_AVX2_DISPATCH
+__attribute__((target("avx2"))) std::size_t
+find_stop_bit_avx2(const char *first, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + i))));
+    if (mask)
+      return i + count_trailing_zeros(mask);
+  }
+  return i + find_stop_bit_sse2(first + i, n - i);
+}
+#endif
+
+typedef std::size_t (*find_stop_bit_function_t)(const char *, std::size_t);
+
+find_stop_bit_function_t select_find_stop_bit() {
+#if defined(MFAST_HAS_AVX2_DISPATCH)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return &find_stop_bit_avx2;
+#endif
+#ifdef MFAST_HAS_SSE2
+  return &find_stop_bit_sse2;
+#else
+  return &find_stop_bit_words;
+#endif
+}
+}
+
+std::size_t find_stop_bit_wide(const char *first, std::size_t n) {
+  static const find_stop_bit_function_t impl = select_find_stop_bit();
+  return impl(first, n);
+}
+}
+}
@@ -0,0 +1,201 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include "../mfast_coder_export.h"
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MFAST_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace mfast {
+
+/// The number of readable bytes a trusted frame must be followed by.
+///
+/// It covers the widest single read of the decoder: a 16 bytes stop bit scan
+/// starting at the last byte of the frame.
+const std::size_t trusted_padding = 16;
+
+namespace detail {
+
+/// Returns the number of trailing zero bits of a non-zero @a v.
+inline unsigned count_trailing_zeros(uint64_t v) {
+#if defined(__GNUC__)
+  return static_cast<unsigned>(__builtin_ctzll(v));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, v);
+  return index;
+#else
+  unsigned n = 0;
+  while ((v & 1) == 0) {
+    v >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+/// Returns the number of leading zero bits of a non-zero @a v.
+inline unsigned count_leading_zeros(uint64_t v) {
+#if defined(__GNUC__)
+  return static_cast<unsigned>(__builtin_clzll(v));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, v);
+  return 63 - index;
+#else
+  unsigned n = 0;
+  while ((v & (UINT64_C(1) << 63)) == 0) {
+    v <<= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+/// Load 8 bytes from an arbitrary address as a little endian integer.
+inline uint64_t load_uint64_le(const char *addr) {
+  uint64_t v;
+  std::memcpy(&v, addr, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+/// Store @a v to an arbitrary address as 8 little endian bytes.
+inline void store_uint64_le(char *addr, uint64_t v) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  v = __builtin_bswap64(v);
+#endif
+  std::memcpy(addr, &v, sizeof(v));
+}
+
+inline uint64_t byte_swap(uint64_t v) {
+#if defined(__GNUC__)
+  return __builtin_bswap64(v);
+#elif defined(_MSC_VER)
+  return _byteswap_uint64(v);
+#else
+  v = ((v & UINT64_C(0x00FF00FF00FF00FF)) << 8) |
+      ((v >> 8) & UINT64_C(0x00FF00FF00FF00FF));
+  v = ((v & UINT64_C(0x0000FFFF0000FFFF)) << 16) |
+      ((v >> 16) & UINT64_C(0x0000FFFF0000FFFF));
+  return (v << 32) | (v >> 32);
+#endif
+}
+
+const uint64_t stop_bits_mask = UINT64_C(0x8080808080808080);
+
+/// Concatenate the 7-bit groups of a stop bit encoded entity.
+///
+/// @param word The bytes of the entity as loaded by load_uint64_le(), i.e. the
+///             first (most significant) byte occupies the lowest 8 bits. Bytes
+///             following the entity are ignored.
+/// @param len  The number of bytes of the entity, must be in the range [1, 8].
+/// @returns The unsigned value of the 7*len bits data.
+inline uint64_t compact_stop_bit_groups(uint64_t word, unsigned len) {
+  // move the last byte of the entity to the least significant position and
+  // drop the bytes following the entity
+  uint64_t v = byte_swap(word) >> (64 - 8 * len);
+#if defined(__BMI2__)
+  return _pext_u64(v, UINT64_C(0x7F7F7F7F7F7F7F7F));
+#else
+  v &= UINT64_C(0x7F7F7F7F7F7F7F7F);
+  v = (v & UINT64_C(0x007F007F007F007F)) |
+      ((v & UINT64_C(0x7F007F007F007F00)) >> 1);
+  v = (v & UINT64_C(0x00003FFF00003FFF)) |
+      ((v & UINT64_C(0x3FFF00003FFF0000)) >> 2);
+  return (v & UINT64_C(0x000000000FFFFFFF)) |
+         ((v & UINT64_C(0x0FFFFFFF00000000)) >> 4);
+#endif
+}
+
+/// Split the low 7*len bits of @a v into the 7-bit groups of a stop bit
+/// encoded entity; the inverse of compact_stop_bit_groups().
+///
+/// @param len The number of bytes of the entity, must be in the range [1, 8].
+/// @returns The bytes of the entity without stop bit, to be stored by
+///          store_uint64_le(), i.e. the first (most significant) group
+///          occupies the lowest 8 bits. The bytes following the entity are 0.
+inline uint64_t spread_stop_bit_groups(uint64_t v, unsigned len) {
+#if defined(__BMI2__)
+  v = _pdep_u64(v, UINT64_C(0x7F7F7F7F7F7F7F7F));
+#else
+  v = (v & UINT64_C(0x000000000FFFFFFF)) |
+      ((v & UINT64_C(0x00FFFFFFF0000000)) << 4);
+  v = (v & UINT64_C(0x00003FFF00003FFF)) |
+      ((v & UINT64_C(0x0FFFC0000FFFC000)) << 2);
+  v = (v & UINT64_C(0x007F007F007F007F)) |
+      ((v & UINT64_C(0x3F803F803F803F80)) << 1);
+#endif
+  // move the last group of the entity to the most significant position, which
+  // drops the groups beyond the entity
+  return byte_swap(v << (64 - 8 * len));
+}
+
+/// Scan for stop bits in windows wider than 16 bytes.
+///
+/// The implementation is selected on first use according to the running CPU
+/// (AVX2 when available, otherwise SSE2 or 8-byte words).
+///
+/// @returns the offset of the first byte in [first, first+n) whose stop bit is
+/// set, or @a n if there is none.
+MFAST_CODER_EXPORT std::size_t find_stop_bit_wide(const char *first,
+                                                  std::size_t n);
+
+/// Returns the offset of the first byte in [first, first+n) whose stop bit is
+/// set, or @a n if there is none.
+///
+/// Short entities, which dominate FAST streams, are resolved inline with a
+/// single 16-byte window; only longer ones go through the dispatched scanner.
+inline std::size_t find_stop_bit(const char *first, std::size_t n) {
+  // single byte entities (e.g. nulls and empty strings) are the most common
+  if (n > 0 && (first[0] & 0x80))
+    return 0;
+#ifdef MFAST_HAS_SSE2
+  if (n >= 16) {
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first))));
+    if (mask)
+      return count_trailing_zeros(mask);
+    return 16 + find_stop_bit_wide(first + 16, n - 16);
+  }
+#else
+  if (n >= 16)
+    return find_stop_bit_wide(first, n);
+#endif
+  if (n >= 8) {
+    uint64_t mask = load_uint64_le(first) & stop_bits_mask;
+    if (mask)
+      return count_trailing_zeros(mask) / 8;
+    // the second window overlaps the first one, which is known to have no
+    // stop bit
+    mask = load_uint64_le(first + n - 8) & stop_bits_mask;
+    return mask ? n - 8 + count_trailing_zeros(mask) / 8 : n;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    if (first[i] & 0x80)
+      return i;
+  }
+  return n;
+}
+}
+}
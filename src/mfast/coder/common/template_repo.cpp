@@ -0,0 +1,187 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#include "template_repo.h"
+#include "exceptions.h"
+#include <algorithm>
+
+namespace mfast {
+namespace {
+// The layout of a snapshot, in the byte order of the host:
+//
+//   uint32_t magic, uint16_t version, uint16_t sizeof(value_storage)
+//   uint64_t digest of the dictionary layout
+//   uint32_t number of dictionary slots
+//   int64_t  active template id, or -1
+//
+// followed by a record for each slot cleared by a reset, in slot order:
+//
+//   uint8_t  undefined_value, or
+//   uint8_t  scalar_value, value_storage, or
+//   uint8_t  array_value, uint32_t length+1 (0 if empty), the contents
+const uint32_t snapshot_magic = 0x5344464D; // "MFDS"
+const uint16_t snapshot_version = 1;
+
+enum : uint8_t { undefined_value, scalar_value, array_value };
+
+template <typename T> void put(std::vector<char> &blob, T value) {
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  blob.insert(blob.end(), bytes, bytes + sizeof(T));
+}
+
+class snapshot_reader {
+public:
+  snapshot_reader(const char *first, const char *last)
+      : first_(first), last_(last) {}
+
+  template <typename T> T get() {
+    T value;
+    std::memcpy(&value, read(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  const char *read(std::size_t n) {
+    if (static_cast<std::size_t>(last_ - first_) < n)
+      BOOST_THROW_EXCEPTION(
+          coder::dictionary_snapshot_error("Truncated dictionary snapshot"));
+    const char *result = first_;
+    first_ += n;
+    return result;
+  }
+
+  bool done() const { return first_ == last_; }
+
+private:
+  const char *first_;
+  const char *last_;
+};
+}
+
+void template_repo_base::save_dictionary(std::vector<char> &blob,
+                                         int64_t template_id) const {
+  put(blob, snapshot_magic);
+  put(blob, snapshot_version);
+  put(blob, static_cast<uint16_t>(sizeof(value_storage)));
+  put(blob, dictionary_digest_);
+  put(blob, static_cast<uint32_t>(dictionary_.size()));
+  put(blob, template_id);
+
+  auto next_vector = vector_slots_.begin();
+  for (uint32_t slot = 0; slot < dictionary_.size(); ++slot) {
+    bool is_vector = next_vector != vector_slots_.end() && *next_vector == slot;
+    if (is_vector)
+      ++next_vector;
+    if (!dictionary_.resettable(slot))
+      continue;
+
+    const value_storage &value = dictionary_.raw(slot);
+    if (!dictionary_.is_defined(slot)) {
+      put(blob, undefined_value);
+    } else if (is_vector) {
+      put(blob, array_value);
+      put(blob, value.of_array.len_);
+      const char *content = static_cast<const char *>(value.of_array.content_);
+      blob.insert(blob.end(), content, content + value.array_length());
+    } else {
+      put(blob, scalar_value);
+      const char *bytes = reinterpret_cast<const char *>(&value);
+      blob.insert(blob.end(), bytes, bytes + sizeof(value_storage));
+    }
+  }
+}
+
+int64_t template_repo_base::restore_dictionary(const char *data,
+                                               std::size_t size) {
+  snapshot_reader reader(data, data + size);
+  if (reader.get<uint32_t>() != snapshot_magic ||
+      reader.get<uint16_t>() != snapshot_version ||
+      reader.get<uint16_t>() != sizeof(value_storage))
+    BOOST_THROW_EXCEPTION(coder::dictionary_snapshot_error(
+        "Unsupported dictionary snapshot format"));
+  if (reader.get<uint64_t>() != dictionary_digest_ ||
+      reader.get<uint32_t>() != dictionary_.size())
+    BOOST_THROW_EXCEPTION(coder::dictionary_snapshot_error(
+        "Dictionary snapshot of other templates"));
+  int64_t template_id = reader.get<int64_t>();
+
+  // validate the whole snapshot before modifying the dictionary
+  std::vector<value_storage> values;
+  std::vector<char> contents;
+  std::vector<std::size_t> offsets;
+  auto next_vector = vector_slots_.begin();
+  for (uint32_t slot = 0; slot < dictionary_.size(); ++slot) {
+    bool is_vector = next_vector != vector_slots_.end() && *next_vector == slot;
+    if (is_vector)
+      ++next_vector;
+    if (!dictionary_.resettable(slot))
+      continue;
+
+    value_storage value;
+    std::size_t offset = 0;
+    uint8_t kind = reader.get<uint8_t>();
+    if (kind == array_value && is_vector) {
+      value.of_array.len_ = reader.get<uint32_t>();
+      value.defined(true);
+      const char *content = reader.read(value.array_length());
+      offset = contents.size();
+      contents.insert(contents.end(), content, content + value.array_length());
+      // keep the strings null terminated
+      contents.push_back('\0');
+    } else if (kind == scalar_value && !is_vector) {
+      std::memcpy(&value, reader.read(sizeof(value_storage)),
+                  sizeof(value_storage));
+    } else if (kind != undefined_value) {
+      BOOST_THROW_EXCEPTION(coder::dictionary_snapshot_error(
+          "Malformed dictionary snapshot"));
+    }
+    values.push_back(value);
+    offsets.push_back(offset);
+  }
+  if (!reader.done())
+    BOOST_THROW_EXCEPTION(
+        coder::dictionary_snapshot_error("Malformed dictionary snapshot"));
+
+  // the contents are not owned by the dictionary, like the values saved from
+  // the messages
+  restored_contents_.swap(contents);
+  std::size_t i = 0;
+  next_vector = vector_slots_.begin();
+  for (uint32_t slot = 0; slot < dictionary_.size(); ++slot) {
+    bool is_vector = next_vector != vector_slots_.end() && *next_vector == slot;
+    if (is_vector)
+      ++next_vector;
+    if (!dictionary_.resettable(slot))
+      continue;
+
+    value_storage &value = dictionary_[slot];
+    if (is_vector && dictionary_alloc_ && value.of_array.capacity_in_bytes_)
+      dictionary_alloc_->deallocate(value.of_array.content_,
+                                    value.of_array.capacity_in_bytes_);
+    value = values[i];
+    if (is_vector && value.is_defined())
+      value.of_array.content_ = &restored_contents_[offsets[i]];
+    ++i;
+  }
+  return template_id;
+}
+
+void template_repo_base::copy_contents(
+    std::vector<std::vector<char>> &contents) {
+  contents.resize(dictionary_.size());
+  for (auto slot : vector_slots_) {
+    value_storage &value = dictionary_.raw(slot);
+    // the values owned by the dictionary need no copy
+    if (!dictionary_.is_defined(slot) || value.is_empty() ||
+        value.of_array.capacity_in_bytes_)
+      continue;
+    std::vector<char> &content = contents[slot];
+    const char *first = static_cast<const char *>(value.of_array.content_);
+    if (first == content.data())
+      continue;
+    content.assign(first, first + value.array_length());
+    value.of_array.content_ = content.data();
+  }
+}
+}
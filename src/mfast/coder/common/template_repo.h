@@ -5,53 +5,111 @@
 // See the file license.txt for licensing information.
 #pragma once
 
+#include "../mfast_coder_export.h"
 #include "dictionary_builder.h"
-#include <map>
+#include "dictionary_block.h"
+#include "template_table.h"
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <vector>
 
 namespace mfast {
-class template_repo_base {
+class template_set;
+
+class MFAST_CODER_EXPORT template_repo_base {
 public:
   template_repo_base(mfast::allocator *dictionary_alloc)
-      : dictionary_alloc_(dictionary_alloc) {}
+      : dictionary_digest_(digest_basis), dictionary_alloc_(dictionary_alloc) {}
   virtual ~template_repo_base() {
-    for (auto &elem : vector_enties_) {
-      if (elem->of_array.capacity_in_bytes_)
-        dictionary_alloc_->deallocate(elem->of_array.content_,
-                                      elem->of_array.capacity_in_bytes_);
+    if (dictionary_alloc_ == nullptr)
+      return;
+    for (auto slot : vector_slots_) {
+      value_storage &elem = dictionary_.raw(slot);
+      if (elem.of_array.capacity_in_bytes_)
+        dictionary_alloc_->deallocate(elem.of_array.content_,
+                                      elem.of_array.capacity_in_bytes_);
     }
   }
 
-  void reset_dictionary() {
-    for (auto &elem : reset_entries_) {
-      elem->defined(false);
-    }
-  }
+  void reset_dictionary() { dictionary_.reset(); }
+
+  /// The previous values of the fields, indexed by the dictionary slots of
+  /// their instructions.
+  dictionary_block *dictionary() { return &dictionary_; }
+
+  /// Append the values of the dictionary to @a blob.
+  ///
+  /// The values are preceded by a digest of the dictionary layout, so that
+  /// they can only be restored into a repository built from the same
+  /// templates.
+  ///
+  /// @param template_id The id of the active template of the coder, which is
+  ///                    saved along with the values, or -1 if there is none.
+  void save_dictionary(std::vector<char> &blob, int64_t template_id) const;
+
+  /// Replace the values of the dictionary with those saved by
+  /// save_dictionary().
+  ///
+  /// The dictionary is left unchanged when an exception is thrown.
+  ///
+  /// @returns The template id saved along with the values.
+  /// @throws coder::dictionary_snapshot_error if @a data is malformed or was
+  ///         saved from a dictionary of another layout.
+  int64_t restore_dictionary(const char *data, std::size_t size);
+
+  /// Let the defined string and byteVector values refer to copies of their
+  /// contents in @a contents, indexed by the dictionary slots, instead of to
+  /// the fields they were saved from; see codec_helper::contents().
+  void copy_contents(std::vector<std::vector<char>> &contents);
 
   virtual template_instruction *get_template(uint32_t id) = 0;
 
 private:
-  void add_reset_entry(value_storage *entry) {
-    reset_entries_.push_back(entry);
+  static const uint64_t digest_basis = 14695981039346656037ULL;
+
+  uint32_t add_dictionary_entry(field_type_enum_t field_type, bool is_vector,
+                                const char *key) {
+    uint32_t slot = dictionary_.add(key != nullptr);
+    if (is_vector)
+      vector_slots_.push_back(slot);
+    digest(&field_type, sizeof(field_type));
+    if (key)
+      digest(key, std::strlen(key) + 1);
+    else
+      digest("", 1);
+    return slot;
   }
-  void add_vector_entry(value_storage *entry) {
-    if (dictionary_alloc_)
-      vector_enties_.push_back(entry);
+
+  // FNV-1a
+  void digest(const void *data, std::size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i)
+      dictionary_digest_ = (dictionary_digest_ ^ bytes[i]) * 1099511628211ULL;
   }
 
 protected:
+  // a dictionary of its own with the layout of the shared instructions
+  void share(std::shared_ptr<const template_set> templates);
+
   friend class dictionary_builder;
+  friend class dictionary_journal;
 
-  typedef std::vector<value_storage *> value_entries_t;
-  value_entries_t reset_entries_;
-  value_entries_t vector_enties_; // for string and byteVector
+  dictionary_block dictionary_;
+  std::vector<uint32_t> vector_slots_; // for string and byteVector
+  uint64_t dictionary_digest_;
+  // the contents of the string and byteVector values restored from a blob
+  std::vector<char> restored_contents_;
   arena_allocator instruction_alloc_;
   mfast::allocator *dictionary_alloc_;
+  // the owner of the instructions when they are shared
+  std::shared_ptr<const template_set> templates_;
 };
 
 template <typename EntryValueConverter>
 class template_repo : public template_repo_base {
   typedef typename EntryValueConverter::repo_mapped_type repo_mapped_type;
-  typedef std::map<uint32_t, repo_mapped_type> templates_map_t;
+  typedef template_table<repo_mapped_type> templates_map_t;
 
   struct repo_entry_inserter {
     template_repo<EntryValueConverter> *repo_;
@@ -99,13 +157,21 @@ public:
     builder.build_from_descriptions(repo_entry_inserter(this), desc...);
   }
 
-  repo_mapped_type *find(uint32_t id) {
-    auto it = templates_map_.find(id);
-    if (it != templates_map_.end())
-      return &it->second;
-    return nullptr;
+  /// Refer to all the instructions of @a templates instead of building them;
+  /// only the dictionary is owned by the repository.
+  void build(std::shared_ptr<const template_set> templates);
+
+  /// Refer to the instructions of @a templates for the templates of
+  /// @a desc instead of building them.
+  template <typename... T>
+  void build(std::shared_ptr<const template_set> templates, T... desc) {
+    share(templates);
+    dictionary_builder builder(*this, templates_.get());
+    builder.build_from_descriptions(repo_entry_inserter(this), desc...);
   }
 
+  repo_mapped_type *find(uint32_t id) { return templates_map_.find(id); }
+
   template_instruction *get_template(uint32_t id) override {
     repo_mapped_type *entry = this->find(id);
     if (entry) {
@@ -121,6 +187,17 @@ public:
     return nullptr;
   }
 
+  /// Invoke @a f with the instruction of each template.
+  template <typename Function> void for_each_template(Function f) {
+    for (auto &entry : templates_map_)
+      f(converter_.to_instruction(entry.second));
+  }
+
+  template <typename Function> void for_each_template(Function f) const {
+    for (auto &entry : templates_map_)
+      f(converter_.to_instruction(entry.second));
+  }
+
   template <typename Message>
   void add_template(template_instruction *inst, Message *msg) {
     // assert(dynamic_cast<const typename
@@ -147,4 +224,48 @@ struct trivial_template_repo_entry_converter {
 
 typedef template_repo<trivial_template_repo_entry_converter>
     simple_template_repo_t;
+
+/// Template instructions built once and shared by several coders, such as
+/// the decoders of many channels of a feed.
+///
+/// The coders built from a set refer to its instructions instead of cloning
+/// them and keep the dictionary values in blocks of their own; see
+/// fast_decoder::include() and fast_decoder_v2.
+class template_set : public simple_template_repo_t {
+public:
+  template_set(const templates_description *const *descriptions,
+               std::size_t description_count) {
+    build(descriptions, description_count);
+  }
+
+  template_set(
+      std::initializer_list<const templates_description *> descriptions) {
+    build(descriptions.begin(), descriptions.size());
+  }
+
+  template_set(const template_set &) = delete;
+  template_set &operator=(const template_set &) = delete;
+
+  const template_instruction *find(uint32_t id) const {
+    const template_instruction *const *entry = templates_map_.find(id);
+    return entry ? *entry : nullptr;
+  }
+};
+
+inline void
+template_repo_base::share(std::shared_ptr<const template_set> templates) {
+  dictionary_.assign_layout(templates->dictionary_);
+  vector_slots_ = templates->vector_slots_;
+  dictionary_digest_ = templates->dictionary_digest_;
+  templates_ = std::move(templates);
+}
+
+template <typename EntryValueConverter>
+void template_repo<EntryValueConverter>::build(
+    std::shared_ptr<const template_set> templates) {
+  share(templates);
+  templates_->for_each_template([this](const template_instruction *inst) {
+    add_template(const_cast<template_instruction *>(inst), (void *)nullptr);
+  });
+}
 }
@@ -0,0 +1,132 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace mfast {
+
+/// The entries of a template repository, looked up by template id in
+/// constant time.
+///
+/// The entries are indexed whenever one is added, which is only done while
+/// the repository is built. When the ids are dense enough, the index is a
+/// table of the entries from the smallest id to the largest; otherwise, it is
+/// an open addressing hash table with linear probing, kept at most half full.
+/// The entries themselves are never moved, so that the coders can refer to
+/// them.
+template <typename T> class template_table {
+public:
+  typedef std::pair<const uint32_t, T> value_type;
+  typedef typename std::deque<value_type>::iterator iterator;
+  typedef typename std::deque<value_type>::const_iterator const_iterator;
+
+  template_table() : base_(0), hashed_(false), shift_(32) {}
+
+  template_table(const template_table &) = delete;
+  template_table &operator=(const template_table &) = delete;
+
+  /// Add an entry for @a id constructed from @a arg, unless there is one
+  /// already.
+  ///
+  /// @returns false if there is an entry for @a id already.
+  template <typename Arg> bool emplace(uint32_t id, Arg &&arg) {
+    if (find(id))
+      return false;
+    entries_.emplace_back(id, std::forward<Arg>(arg));
+    index();
+    return true;
+  }
+
+  T *find(uint32_t id) {
+    value_type *entry = lookup(id);
+    return entry ? &entry->second : nullptr;
+  }
+
+  const T *find(uint32_t id) const {
+    value_type *entry = lookup(id);
+    return entry ? &entry->second : nullptr;
+  }
+
+  std::size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+  /// The entries in the order they were added.
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+
+  /// Whether the ids are too sparse for a direct table.
+  bool hashed() const { return hashed_; }
+
+private:
+  value_type *lookup(uint32_t id) const {
+    if (!hashed_) {
+      uint32_t i = id - base_;
+      return i < slots_.size() ? slots_[i] : nullptr;
+    }
+
+    std::size_t mask = slots_.size() - 1;
+    for (std::size_t i = hash(id);; i = (i + 1) & mask) {
+      value_type *entry = slots_[i];
+      if (entry == nullptr || entry->first == id)
+        return entry;
+    }
+  }
+
+  // Fibonacci hashing
+  std::size_t hash(uint32_t id) const {
+    return static_cast<uint32_t>(id * 2654435769U) >> shift_;
+  }
+
+  void index() {
+    uint32_t min_id = entries_.front().first, max_id = min_id;
+    for (auto &entry : entries_) {
+      min_id = std::min(min_id, entry.first);
+      max_id = std::max(max_id, entry.first);
+    }
+
+    // the range of the ids may be up to 4 times the number of templates, or
+    // 256, before the table is hashed
+    uint64_t range = static_cast<uint64_t>(max_id) - min_id + 1;
+    hashed_ = range > std::max<uint64_t>(256, 4 * entries_.size());
+    slots_.clear();
+    if (!hashed_) {
+      base_ = min_id;
+      slots_.resize(static_cast<std::size_t>(range), nullptr);
+      for (auto &entry : entries_)
+        slots_[entry.first - base_] = &entry;
+      return;
+    }
+
+    shift_ = 32;
+    std::size_t capacity = 1;
+    while (capacity < 2 * entries_.size()) {
+      capacity *= 2;
+      --shift_;
+    }
+    slots_.resize(capacity, nullptr);
+    std::size_t mask = capacity - 1;
+    for (auto &entry : entries_) {
+      std::size_t i = hash(entry.first);
+      while (slots_[i])
+        i = (i + 1) & mask;
+      slots_[i] = &entry;
+    }
+  }
+
+  std::deque<value_type> entries_;
+  std::vector<value_type *> slots_;
+  uint32_t base_;
+  bool hashed_;
+  unsigned shift_;
+};
+}
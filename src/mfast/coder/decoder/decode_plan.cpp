@@ -0,0 +1,123 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#include "decode_plan.h"
+
+namespace mfast {
+
+const decode_plan *
+decode_plan_cache::get(const group_field_instruction *inst) {
+  plans_t::iterator it = plans_.find(inst);
+  if (it != plans_.end())
+    return it->second;
+  const decode_plan *plan = compile(inst, nullptr, storage_);
+  plans_[inst] = plan;
+  return plan;
+}
+
+const decode_plan *
+decode_plan_cache::message_plan(const template_instruction *inst) {
+  if (!message_plans_.empty()) {
+    message_plans_t::iterator it = message_plans_.find(inst);
+    if (it != message_plans_.end())
+      return it->second.plan;
+  }
+  return get(inst);
+}
+
+void decode_plan_cache::project(const template_instruction *inst,
+                                const field_projection &projection) {
+  storage_t storage;
+  const decode_plan *plan = compile(inst, &projection, storage);
+  // the plans set before are released
+  message_plan_t &entry = message_plans_[inst];
+  entry.plan = plan;
+  entry.storage.swap(storage);
+}
+
+const decode_plan *
+decode_plan_cache::sync_plan(const template_instruction *inst) {
+  plans_t::iterator it = sync_plans_.find(inst);
+  if (it != sync_plans_.end())
+    return it->second;
+  // nothing is selected
+  field_projection projection(inst, nullptr, 0);
+  const decode_plan *plan = compile(inst, &projection, storage_);
+  sync_plans_[inst] = plan;
+  return plan;
+}
+
+void decode_plan_cache::sync_only(const template_instruction *inst,
+                                  bool enabled) {
+  if (enabled) {
+    message_plan_t &entry = message_plans_[inst];
+    entry.plan = sync_plan(inst);
+    entry.storage.clear();
+  } else {
+    message_plans_.erase(inst);
+  }
+}
+
+decode_plan *decode_plan_cache::compile(const group_field_instruction *inst,
+                                        const field_projection *projection,
+                                        storage_t &storage) {
+  storage.emplace_back(new decode_plan);
+  decode_plan *plan = storage.back().get();
+  decode_plan::steps_t &steps = plan->steps_;
+  steps.reserve(inst->subinstructions().size());
+
+  for (std::size_t i = 0; i < inst->subinstructions().size(); ++i) {
+    const field_instruction *subinst = inst->subinstruction(i);
+    field_type_enum_t field_type = subinst->field_type();
+    const decode_plan *nested = nullptr;
+    bool skip = projection && projection->skipped(subinst);
+
+    switch (field_type) {
+    case field_type_exponent:
+      // a decimal with individual operators for its exponent and mantissa
+      field_type = field_type_decimal;
+      break;
+    case field_type_enum:
+      // an enum is decoded as its uInt64 value
+      field_type = field_type_uint64;
+      break;
+    case field_type_group:
+    case field_type_sequence: {
+      const group_field_instruction *aggregate =
+          static_cast<const group_field_instruction *>(subinst);
+      if (projection)
+        nested = compile(aggregate, projection, storage);
+      else
+        nested = get(aggregate);
+    } break;
+    default:
+      break;
+    }
+
+    decode_step step = {
+        decode_step::opcode_of(field_type, subinst->field_operator()),
+        static_cast<uint16_t>(field_type), static_cast<uint32_t>(i), subinst,
+        nested};
+    if (skip)
+      step.opcode |= decode_step::skip_flag;
+    steps.push_back(step);
+  }
+
+  plan->length_.index = 0;
+  plan->length_.nested = nullptr;
+  plan->length_.instruction = nullptr;
+  plan->length_.opcode = 0;
+  plan->length_.field_type = field_type_uint32;
+  if (inst->field_type() == field_type_sequence) {
+    const uint32_field_instruction *length_inst =
+        static_cast<const sequence_field_instruction *>(inst)
+            ->length_instruction();
+    plan->length_.instruction = length_inst;
+    plan->length_.opcode = decode_step::opcode_of(
+        field_type_uint32, length_inst->field_operator());
+  }
+  return plan;
+}
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "mfast/instructions/group_instruction.h"
+#include "mfast/instructions/sequence_instruction.h"
+#include "mfast/instructions/template_instruction.h"
+#include "../common/field_projection.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace mfast {
+class decode_plan;
+
+/// A field of a template, group or sequence element lowered for decoding.
+struct decode_step {
+  /// The opcode of a field; it selects the handler for the combination of
+  /// field type and operator.
+  static constexpr uint16_t opcode_of(field_type_enum_t field_type,
+                                      operator_enum_t field_operator) {
+    return static_cast<uint16_t>(field_type * operators_count +
+                                 field_operator);
+  }
+
+  /// Set in the opcode of a field outside the projection of its template,
+  /// which is consumed from the stream without being stored in the message.
+  static const uint16_t skip_flag = 0x100;
+
+  uint16_t opcode;
+  /// The field type; an enum is decoded as uInt64 and a decimal with
+  /// individual operators as decimal.
+  uint16_t field_type;
+  /// The index of the field in the value_storage array of its aggregate.
+  uint32_t index;
+  /// The field instruction, which also holds the dictionary value of the
+  /// field.
+  const field_instruction *instruction;
+  /// The plan of a group or a sequence element; nullptr for other fields.
+  const decode_plan *nested;
+};
+
+/// The fields of a template, group or sequence element in decoding order,
+/// so that a message can be decoded by a loop over an array instead of a
+/// visitor walking the instruction tree.
+class decode_plan {
+public:
+  typedef std::vector<decode_step> steps_t;
+
+  const steps_t &steps() const { return steps_; }
+
+  /// The length field of a sequence.
+  const decode_step &length() const { return length_; }
+
+private:
+  friend class decode_plan_cache;
+
+  steps_t steps_;
+  decode_step length_;
+};
+
+/// Compiles and owns the decode plans of a decoder.
+class decode_plan_cache {
+public:
+  /// Returns the full plan of @a inst, which is compiled along with the plans
+  /// of its groups and sequences unless it has been compiled before.
+  const decode_plan *get(const group_field_instruction *inst);
+
+  /// Returns the plan of the messages of the template @a inst, which is the
+  /// plan set by project() or sync_only() if any, or the full plan otherwise.
+  /// The templates referred to by a dynamic templateRef use the full plan.
+  const decode_plan *message_plan(const template_instruction *inst);
+
+  /// Let message_plan() return a plan of the template @a inst in which the
+  /// fields skipped by @a projection are not stored. The plan replaces the
+  /// one set before.
+  void project(const template_instruction *inst,
+               const field_projection &projection);
+
+  /// Returns the plan of @a inst in which every field is skipped, so that
+  /// decoding it only keeps the dictionary in sync.
+  const decode_plan *sync_plan(const template_instruction *inst);
+
+  /// Let message_plan() return the plan of sync_plan() for @a inst when
+  /// @a enabled, or the full plan otherwise. The projection of @a inst is
+  /// discarded.
+  void sync_only(const template_instruction *inst, bool enabled);
+
+private:
+  typedef std::vector<std::unique_ptr<decode_plan>> storage_t;
+
+  decode_plan *compile(const group_field_instruction *inst,
+                       const field_projection *projection,
+                       storage_t &storage);
+
+  typedef std::unordered_map<const group_field_instruction *,
+                             const decode_plan *>
+      plans_t;
+  plans_t plans_;
+  plans_t sync_plans_;
+  storage_t storage_;
+
+  // the plan set for the messages of a template, which owns the plans of its
+  // groups and sequences when it is projected as they are not shared with the
+  // other templates
+  struct message_plan_t {
+    const decode_plan *plan;
+    storage_t storage;
+  };
+  typedef std::unordered_map<const template_instruction *, message_plan_t>
+      message_plans_t;
+  message_plans_t message_plans_;
+};
+}
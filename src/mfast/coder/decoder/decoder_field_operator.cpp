@@ -9,7 +9,11 @@
 #include "decoder_presence_map.h"
 #include "decoder_field_operator.h"
 #include "fast_istream_extractor.h"
+#include "fast_istream_view.h"
 #include "check_overflow.h"
+#include "decode_plan.h"
+#include "../common/dictionary_journal.h"
+#include <type_traits>
 namespace mfast {
 
 void decoder_field_operator::decode(const int32_mref & /* mref */,
@@ -83,7 +87,15 @@ public:
     // If a field is optional and has no field operator, it is encoded with a
     // nullable representation and the NULL is used to represent absence of a
     // value. It will not occupy any bits in the presence map.
-    save_previous_value(mref);
+    stream.save_previous_value(mref);
+  }
+
+  template <typename T>
+  void decode_string_impl(const T &mref, fast_istream &stream,
+                          decoder_presence_map &pmap) const {
+    if (!stream.zero_copy() || mref.instruction()->previous_value_shared() ||
+        !decode_view(stream, mref, mref.instruction()->is_nullable()))
+      decode_impl(mref, stream, pmap);
   }
 
   virtual void decode(const int32_mref &mref, fast_istream &stream,
@@ -108,17 +120,17 @@ public:
 
   virtual void decode(const ascii_string_mref &mref, fast_istream &stream,
                       decoder_presence_map &pmap) const override {
-    decode_impl(mref, stream, pmap);
+    decode_string_impl(mref, stream, pmap);
   }
 
   virtual void decode(const unicode_string_mref &mref, fast_istream &stream,
                       decoder_presence_map &pmap) const override {
-    decode_impl(mref, stream, pmap);
+    decode_string_impl(mref, stream, pmap);
   }
 
   virtual void decode(const byte_vector_mref &mref, fast_istream &stream,
                       decoder_presence_map &pmap) const override {
-    decode_impl(mref, stream, pmap);
+    decode_string_impl(mref, stream, pmap);
   }
 
   virtual void decode(const decimal_mref &mref, fast_istream &stream,
@@ -134,7 +146,7 @@ public:
   constant_operator() {}
 
   template <typename T>
-  void decode_impl(const T &mref, fast_istream & /* stream */,
+  void decode_impl(const T &mref, fast_istream &stream,
                    decoder_presence_map &pmap) const {
 
     // A field will not occupy any bit in the presence map if it is mandatory
@@ -153,7 +165,7 @@ public:
         mref.omit();
       }
     }
-    save_previous_value(mref);
+    stream.save_previous_value(mref);
   }
 
   virtual void decode(const int32_mref &mref, fast_istream &stream,
@@ -207,10 +219,10 @@ public:
       stream >> mref;
       // A NULL indicates that the value is absent and the state of the previous
       // value is set to empty
-      save_previous_value(mref);
+      stream.save_previous_value(mref);
     } else {
 
-      value_storage &previous = previous_value_of(mref);
+      value_storage &previous = stream.previous_value_of(mref);
 
       if (!previous.is_defined()) {
         // if the previous value is undefined – the value of the field is the
@@ -221,7 +233,7 @@ public:
         // considered
         // absent and the state of the previous value is changed to empty.
         mref.to_initial_value();
-        save_previous_value(mref);
+        stream.save_previous_value(mref);
 
         if (mref.instruction()->mandatory_without_initial_value()) {
           // Unless the field has optional presence, it is a dynamic error [ERR
@@ -242,7 +254,7 @@ public:
         Operation()(mref, previous);
         // if the previous value is assigned – the value of the field is the
         // previous value.
-        load_previous_value(mref);
+        stream.load_previous_value(mref);
       }
     }
   }
@@ -366,7 +378,7 @@ public:
       mref.to_initial_value();
     }
 
-    save_previous_value(mref);
+    stream.save_previous_value(mref);
   }
 
   virtual void decode(const int32_mref &mref, fast_istream &stream,
@@ -417,13 +429,13 @@ class delta_operator : public decoder_field_operator,
     int64_t d;
     if (stream.decode(d, mref.instruction()->is_nullable())) {
 
-      value_storage bv = delta_base_value_of(mref);
+      value_storage bv = stream.delta_base_value_of(mref);
       T tmp(nullptr, &bv, nullptr);
 
       check_overflow(tmp.value(), d, mref.instruction(), stream);
       mref.as(static_cast<typename T::value_type>(tmp.value() + d));
 
-      save_previous_value(mref);
+      stream.save_previous_value(mref);
     } else {
       //  If the field has optional presence, the delta value can be NULL. In
       //  that case the value of the field is considered absent.
@@ -448,7 +460,7 @@ class delta_operator : public decoder_field_operator,
       // value range of an int32.
       int32_t sub_len =
           substraction_length >= 0 ? substraction_length : ~substraction_length;
-      const value_storage &base_value = delta_base_value_of(mref);
+      const value_storage &base_value = stream.delta_base_value_of(mref);
 
       if (sub_len > static_cast<int32_t>(base_value.array_length()))
         BOOST_THROW_EXCEPTION(fast_dynamic_error("D7"));
@@ -459,7 +471,7 @@ class delta_operator : public decoder_field_operator,
 
       this->apply_string_delta(mref, base_value, substraction_length, delta_str,
                                delta_len);
-      save_previous_value(mref);
+      stream.save_previous_value(mref);
     } else {
       mref.omit();
     }
@@ -493,7 +505,7 @@ public:
     if (!mref.has_individual_operators()) {
       stream >> mref;
       if (mref.present()) {
-        value_storage bv = delta_base_value_of(mref);
+        value_storage bv = stream.delta_base_value_of(mref);
 
         check_overflow(bv.of_decimal.mantissa_, mref.mantissa(),
                        mref.instruction(), stream);
@@ -504,7 +516,7 @@ public:
         // if (mref.exponent() > 63 || mref.exponent() < -63 )
         //   BOOST_THROW_EXCEPTION(fast_reportable_error("R1"));
         //
-        save_previous_value(mref);
+        stream.save_previous_value(mref);
       } else {
         mref.omit();
       }
@@ -547,7 +559,7 @@ private:
       const typename T::value_type *str;
       if (stream.decode(str, len, mref.instruction(),
                         mref.instruction()->is_nullable())) {
-        const value_storage &base_value(tail_base_value_of(mref));
+        const value_storage &base_value(stream.tail_base_value_of(mref));
         this->apply_string_delta(mref, base_value,
                                  std::min<int>(len, base_value.array_length()),
                                  str, len);
@@ -561,7 +573,7 @@ private:
       // depends
       // on the state of the previous value in the following way:
 
-      value_storage &prev = previous_value_of(mref);
+      value_storage &prev = stream.previous_value_of(mref);
 
       if (!prev.is_defined()) {
         //  * undefined – the value of the field is the initial value that also
@@ -586,11 +598,11 @@ private:
         mref.omit();
       } else {
         // * assigned – the value of the field is the previous value.
-        load_previous_value(mref);
+        stream.load_previous_value(mref);
         return;
       }
     }
-    save_previous_value(mref);
+    stream.save_previous_value(mref);
   }
 
 public:
@@ -619,6 +631,125 @@ static const default_operator default_operator_instance;
 static const delta_operator delta_operator_instance;
 static const increment_operator increment_operator_instance;
 static const tail_operator tail_operator_instance;
+
+template <typename MRef, typename Operator>
+inline void decode_with(const Operator &op, const decode_step &step,
+                        value_storage *storage, allocator *alloc,
+                        fast_istream &stream, decoder_presence_map &pmap,
+                        dictionary_journal *journal) {
+  // for an enum, the instruction is used as the one of an uInt64 field, which
+  // is how fast_decoder_impl::visit(enum_mref&) decodes it
+  MRef mref(alloc, storage,
+            static_cast<typename MRef::instruction_cptr>(step.instruction));
+  if (journal)
+    journal->record(mref);
+  // qualified to avoid the virtual call
+  op.Operator::decode(mref, stream, pmap);
+}
+
+// Consuming the value of a field outside the projection of its template,
+// which is neither stored in the message nor copied.
+
+template <typename T>
+inline void skip_value(fast_istream &stream,
+                       const int_field_instruction<T> *inst) {
+  T value;
+  stream.decode(value, inst->is_nullable());
+}
+
+inline void skip_value(fast_istream &stream,
+                       const decimal_field_instruction *inst) {
+  int16_t exponent;
+  if (stream.decode(exponent, inst->is_nullable())) {
+    int64_t mantissa;
+    stream.decode(mantissa, false);
+  }
+}
+
+template <typename Instruction>
+inline void skip_value(fast_istream &stream, const Instruction *inst) {
+  const typename std::conditional<
+      std::is_base_of<byte_vector_field_instruction, Instruction>::value,
+      unsigned char, char>::type *buf;
+  uint32_t len;
+  stream.decode(buf, len, inst, inst->is_nullable());
+}
+}
+
+const decode_step *decode_fields(const decode_step *first,
+                                 const decode_step *last,
+                                 value_storage *fields, allocator *alloc,
+                                 fast_istream &stream,
+                                 decoder_presence_map &pmap,
+                                 dictionary_journal *journal) {
+  using namespace decoder_detail;
+
+#define MFAST_DECODE_CASE(TYPE, OPERATOR, INSTANCE)                            \
+  case decode_step::opcode_of(field_type_##TYPE, operator_##OPERATOR):         \
+    decode_with<TYPE##_mref>(INSTANCE, *first, storage, alloc, stream, pmap,   \
+                             journal);                                         \
+    break;
+
+#define MFAST_DECODE_CASES(TYPE)                                               \
+  MFAST_DECODE_CASE(TYPE, none, no_operator_instance)                          \
+  MFAST_DECODE_CASE(TYPE, constant, constant_operator_instance)                \
+  MFAST_DECODE_CASE(TYPE, delta, delta_operator_instance)                      \
+  MFAST_DECODE_CASE(TYPE, default, default_operator_instance)                  \
+  MFAST_DECODE_CASE(TYPE, copy, copy_operator_instance)                        \
+  MFAST_SKIP_CASES(TYPE)
+
+// a field is skipped only if its operator does not use the dictionary, see
+// decode_plan_cache::project()
+#define MFAST_SKIP_CASES(TYPE)                                                 \
+  case decode_step::opcode_of(field_type_##TYPE, operator_none) |              \
+      decode_step::skip_flag:                                                  \
+    skip_value(stream, static_cast<TYPE##_mref::instruction_cptr>(             \
+                           first->instruction));                               \
+    break;                                                                     \
+  case decode_step::opcode_of(field_type_##TYPE, operator_constant) |          \
+      decode_step::skip_flag:                                                  \
+    if (first->instruction->optional())                                        \
+      pmap.is_next_bit_set();                                                  \
+    break;                                                                     \
+  case decode_step::opcode_of(field_type_##TYPE, operator_default) |           \
+      decode_step::skip_flag:                                                  \
+    if (pmap.is_next_bit_set())                                                \
+      skip_value(stream, static_cast<TYPE##_mref::instruction_cptr>(           \
+                             first->instruction));                             \
+    break;
+
+  for (; first != last; ++first) {
+    value_storage *storage = fields + first->index;
+    switch (first->opcode) {
+      MFAST_DECODE_CASES(int32)
+      MFAST_DECODE_CASE(int32, increment, increment_operator_instance)
+      MFAST_DECODE_CASES(uint32)
+      MFAST_DECODE_CASE(uint32, increment, increment_operator_instance)
+      MFAST_DECODE_CASES(int64)
+      MFAST_DECODE_CASE(int64, increment, increment_operator_instance)
+      MFAST_DECODE_CASES(uint64)
+      MFAST_DECODE_CASE(uint64, increment, increment_operator_instance)
+      MFAST_DECODE_CASES(decimal)
+      MFAST_DECODE_CASES(ascii_string)
+      MFAST_DECODE_CASE(ascii_string, tail, tail_operator_instance)
+      MFAST_DECODE_CASES(unicode_string)
+      MFAST_DECODE_CASE(unicode_string, tail, tail_operator_instance)
+      MFAST_DECODE_CASES(byte_vector)
+      MFAST_DECODE_CASE(byte_vector, tail, tail_operator_instance)
+    default:
+      if (first->field_type == field_type_templateref ||
+          first->field_type >= field_type_int32_vector)
+        return first;
+      // the remaining combinations are not valid and decode nothing, as the
+      // base decoder_field_operator does
+      break;
+    }
+  }
+  return last;
+
+#undef MFAST_SKIP_CASES
+#undef MFAST_DECODE_CASES
+#undef MFAST_DECODE_CASE
 }
 
 const decoder_field_operator *const decoder_operators[] = {
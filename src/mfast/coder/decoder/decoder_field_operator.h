@@ -12,6 +12,9 @@
 #include "fast_istream.h"
 
 namespace mfast {
+struct decode_step;
+class dictionary_journal;
+
 class decoder_field_operator {
 public:
   virtual void decode(const int32_mref &mref, fast_istream &stream,
@@ -33,4 +36,20 @@ public:
 };
 
 extern const decoder_field_operator *const decoder_operators[operators_count];
+
+/// Decode the integer, decimal, string and byte vector fields of the steps
+/// in [@a first, @a last) up to the first field of another type.
+///
+/// The operator of a field is selected by the opcode of its step and invoked
+/// without a virtual call. If @a journal is not null, the dictionary value of
+/// each field is recorded before it is decoded.
+///
+/// @param fields The value_storage array of the aggregate.
+/// @returns The first step which has not been decoded.
+const decode_step *decode_fields(const decode_step *first,
+                                 const decode_step *last,
+                                 value_storage *fields, allocator *alloc,
+                                 fast_istream &stream,
+                                 decoder_presence_map &pmap,
+                                 dictionary_journal *journal);
 }
@@ -5,11 +5,33 @@
 // See the file license.txt for licensing information.
 #include "decoder_presence_map.h"
 
+namespace mfast {
+void decoder_presence_map::load_slow(fast_istreambuf &buf) {
+  const char *addr = buf.gptr();
+  const std::size_t len = buf.get_entity_length();
+  uint64_t word;
+  if (len < sizeof(word)) {
+    // do not read beyond the end of the buffer
+    char bytes[sizeof(word)] = {};
+    std::memcpy(bytes, addr, len);
+    word = detail::load_uint64_le(bytes);
+    set_bitmap(word, static_cast<unsigned>(len));
+    continue_ = nullptr;
+  } else {
+    word = detail::load_uint64_le(addr);
+    set_bitmap(word, 8);
+    continue_ = len > 8 ? addr + 8 : nullptr;
+    last_ = addr + len;
+  }
+  buf.gbump(len);
+}
+}
+
 #ifndef NDEBUG
 
 namespace mfast {
 std::ostream &operator<<(std::ostream &os, const decoder_presence_map &pmap) {
-  size_t mask = pmap.mask_ >> 1;
+  uint64_t mask = pmap.mask_ >> 1;
   if (mask == 0) {
     os << "0";
     return os;
@@ -22,9 +44,4 @@ std::ostream &operator<<(std::ostream &os, const decoder_presence_map &pmap) {
   return os;
 }
 }
-#elif _MSC_VER
-// disable MSVC LNK4221
-namespace {
-char dummy;
-};
 #endif
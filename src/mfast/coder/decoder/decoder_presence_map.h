@@ -5,7 +5,10 @@
 // See the file license.txt for licensing information.
 #pragma once
 
+#include <cstring>
 #include <stdint.h>
+#include "../mfast_coder_export.h"
+#include "../common/stop_bit.h"
 #include "fast_istreambuf.h"
 
 #ifndef __GNUC__
@@ -15,49 +18,86 @@
 namespace mfast {
 class decoder_presence_map {
 public:
-  decoder_presence_map() : cur_bitmap_(0), mask_(0), continue_(nullptr) {}
+  decoder_presence_map()
+      : cur_bitmap_(0), mask_(0), continue_(nullptr), last_(nullptr) {}
   bool is_next_bit_set() {
     mask_ >>= 1;
     if (__builtin_expect(mask_ == 0 && continue_, 0)) {
-      load(continue_);
+      load_continuation();
       mask_ >>= 1;
     }
     bool result = (cur_bitmap_ & mask_) != 0;
     return result;
   }
 
-  bool load(fast_istreambuf &buf) {
-    const char *addr = buf.gptr();
-    bool result = load(addr);
-    buf.gbump(addr - buf.gptr());
-    return result;
+  /// Load the presence map and advance @a buf past it.
+  ///
+  /// Presence maps of up to 8 bytes are loaded with a single word access;
+  /// the remaining bytes of a longer presence map are loaded a word at a time
+  /// as the bits are consumed.
+  void load(fast_istreambuf &buf) {
+    if (__builtin_expect(buf.in_avail() >= sizeof(uint64_t), 1)) {
+      const uint64_t word = detail::load_uint64_le(buf.gptr());
+      // presence maps of one or two bytes are the most common, they are
+      // cheaper to assemble directly than to compact
+      if (word & 0x80) {
+        cur_bitmap_ = word & 0x7F;
+        mask_ = 0x80;
+        continue_ = nullptr;
+        buf.gbump(1);
+        return;
+      }
+      if (word & 0x8000) {
+        cur_bitmap_ = ((word & 0x7F) << 7) | ((word >> 8) & 0x7F);
+        mask_ = 0x4000;
+        continue_ = nullptr;
+        buf.gbump(2);
+        return;
+      }
+      const uint64_t stop_bits = word & detail::stop_bits_mask;
+      if (stop_bits != 0) {
+        const unsigned len = detail::count_trailing_zeros(stop_bits) / 8 + 1;
+        set_bitmap(word, len);
+        continue_ = nullptr;
+        buf.gbump(len);
+        return;
+      }
+    }
+    load_slow(buf);
   }
 
   // only used for test case verification
-  size_t mask() const { return mask_; }
+  uint64_t mask() const { return mask_; }
 
 private:
-  bool load(const char *&addr) {
-    const int max_load_byes = sizeof(size_t) * 8 / 7;
-    mask_ = 1;
-    for (int i = 0; i < max_load_byes; ++i, ++addr) {
-      char c = *addr;
-      cur_bitmap_ <<= 7;
-      cur_bitmap_ |= c & '\x7F';
-      mask_ <<= 7;
-      if ('\x80' == (c & '\x80')) {
-        ++addr;
-        continue_ = nullptr;
-        return true;
-      }
+  void set_bitmap(uint64_t word, unsigned len) {
+    cur_bitmap_ = detail::compact_stop_bit_groups(word, len);
+    mask_ = UINT64_C(1) << (7 * len);
+  }
+
+  // Load a presence map longer than 8 bytes or one at the end of the buffer.
+  MFAST_CODER_EXPORT void load_slow(fast_istreambuf &buf);
+
+  void load_continuation() {
+    const std::size_t n = last_ - continue_;
+    if (n >= 8) {
+      set_bitmap(detail::load_uint64_le(continue_), 8);
+      continue_ += 8;
+    } else {
+      // load the last word of the presence map, which starts at least 8
+      // bytes earlier, and drop the bytes already consumed
+      set_bitmap(detail::load_uint64_le(last_ - 8) >> (8 * (8 - n)),
+                 static_cast<unsigned>(n));
+      continue_ = last_;
     }
-    continue_ = addr;
-    return false;
+    if (continue_ == last_)
+      continue_ = nullptr;
   }
 
-  size_t cur_bitmap_;
-  size_t mask_;
+  uint64_t cur_bitmap_;
+  uint64_t mask_;
   const char *continue_;
+  const char *last_;
   friend std::ostream &operator<<(std::ostream &,
                                   const mfast::decoder_presence_map &);
 };
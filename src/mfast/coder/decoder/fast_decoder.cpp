@@ -15,10 +15,13 @@
 #include "../common/debug_stream.h"
 #include "../common/template_repo.h"
 #include "../common/codec_helper.h"
+#include "../common/dictionary_journal.h"
 #include "decoder_presence_map.h"
 #include "decoder_field_operator.h"
+#include "decode_plan.h"
 #include "fast_istream.h"
 #include "mfast/vector_ref.h"
+#include <algorithm>
 
 namespace mfast {
 
@@ -47,20 +50,28 @@ struct fast_decoder_impl {
       this->current_ = state.prev_pmap_;
   }
 
-  void visit(enum_mref &mref) {
-    this->visit(reinterpret_cast<uint64_mref &>(mref));
-  }
-
-  template <typename SimpleMRef> void visit(const SimpleMRef &mref);
-
-  template <typename IntType> void visit(const int_vector_mref<IntType> &mref);
-
-  void visit(const group_mref &mref, int);
-  void visit(const sequence_mref &mref, int);
-  void visit(const nested_message_mref &mref, int);
-  void visit(const sequence_element_mref &mref, int);
+  void decode_fields(const decode_plan &plan, value_storage *fields,
+                     allocator *alloc);
+  const decode_step *decode_simple_fields(const decode_step *first,
+                                          const decode_step *last,
+                                          value_storage *fields,
+                                          allocator *alloc);
+  template <typename IntType>
+  void decode_int_vector(const int_vector_mref<IntType> &mref);
+  void decode_group(const decode_step &step, value_storage *storage,
+                    allocator *alloc);
+  void decode_sequence(const decode_step &step, value_storage *storage,
+                       allocator *alloc);
+  void decode_templateref(const decode_step &step, value_storage *storage,
+                          allocator *alloc);
 
   message_type *decode_segment(fast_istreambuf &sb);
+  message_type *decode_message(fast_istreambuf &sb, const char *last);
+  message_type *decode_transaction(fast_istreambuf &sb, const char *last);
+  std::size_t decode_all(const char *&first, const char *last,
+                         const std::function<void(const message_cref &)> &handler,
+                         bool force_reset, std::size_t header_size);
+  void included();
 
   typedef message_type info_entry;
 
@@ -83,18 +94,27 @@ struct fast_decoder_impl {
   };
 
   template_repo<info_entry_converter> repo_;
+  decode_plan_cache plans_;
   allocator *message_alloc_;
   fast_istream strm_;
   message_type *active_message_;
+  // the message to decode into instead of active_message_, if any
+  const message_mref *target_;
+  // the contents of the string and byteVector previous values decoded into
+  // a target, which are not kept in the target
+  detail::codec_helper::contents_t contents_;
   bool force_reset_;
+  bool sync_;
   debug_stream debug_;
   decoder_presence_map *current_;
   std::ostream *warning_log_;
+  dictionary_journal *journal_;
 };
 
 inline fast_decoder_impl::fast_decoder_impl(mfast::allocator *alloc)
     : repo_(info_entry_converter(alloc)), message_alloc_(alloc), strm_(nullptr),
-      warning_log_(nullptr) {}
+      target_(nullptr), force_reset_(false), sync_(false), warning_log_(nullptr),
+      journal_(nullptr) {}
 
 fast_decoder_impl::~fast_decoder_impl() {}
 
@@ -102,25 +122,33 @@ inline decoder_presence_map &fast_decoder_impl::current_pmap() {
   return *current_;
 }
 
-template <typename SimpleMRef>
-inline void fast_decoder_impl::visit(const SimpleMRef &mref) {
-  debug_ << "   decoding " << mref.name() << ": pmap -> " << current_pmap()
-         << "\n"
-         << "               stream -> " << strm_ << "\n";
+namespace {
+// the value of a decoded field in the debug log
+struct field_value {
+  field_cref ref;
+};
 
-  const decoder_field_operator *field_operator =
-      decoder_operators[mref.instruction()->field_operator()];
-  field_operator->decode(mref, strm_, current_pmap());
+struct field_value_printer {
+  std::ostream &os_;
 
-  if (mref.present())
-    debug_ << "   decoded " << mref.name() << " = " << mref << "\n";
-  else
-    debug_ << "   decoded " << mref.name() << " is absent\n";
+  template <typename SimpleCRef> void visit(const SimpleCRef &ref) {
+    os_ << ref;
+  }
+  void visit(const enum_cref &ref) { os_ << ref.value(); }
+  template <typename IntType> void visit(const int_vector_cref<IntType> &) {}
+  template <typename CompositeCRef> void visit(const CompositeCRef &, int) {}
+};
+
+inline std::ostream &operator<<(std::ostream &os, const field_value &value) {
+  field_value_printer printer = {os};
+  apply_accessor(printer, value.ref);
+  return os;
+}
 }
 
 template <typename IntType>
-void fast_decoder_impl::visit(const int_vector_mref<IntType> &mref) {
-  debug_ << "decoding int vector " << mref.name();
+void fast_decoder_impl::decode_int_vector(const int_vector_mref<IntType> &mref) {
+  debug_ << "decoding int vector " << mref.name() << "\n";
 
   uint32_t length = 0;
   if (!strm_.decode(length, mref.optional())) {
@@ -134,84 +162,177 @@ void fast_decoder_impl::visit(const int_vector_mref<IntType> &mref) {
   }
 }
 
-inline void fast_decoder_impl::visit(const group_mref &mref, int) {
-  debug_ << "decoding group " << mref.name();
-
-  // If a group field is optional, it will occupy a single bit in the presence
-  // map.
-  // The contents of the group may appear in the stream iff the bit is set.
-  if (mref.optional()) {
-    debug_ << " : current pmap = " << current_pmap() << "\n";
-    if (!current_pmap().is_next_bit_set()) {
-      debug_ << "        " << mref.name() << " is absent\n";
-      mref.omit();
-      return;
+void fast_decoder_impl::decode_fields(const decode_plan &plan,
+                                      value_storage *fields,
+                                      allocator *alloc) {
+  const decode_step *step = plan.steps().data();
+  const decode_step *last = step + plan.steps().size();
+
+  while ((step = decode_simple_fields(step, last, fields, alloc)) != last) {
+    value_storage *storage = fields + step->index;
+    switch (step->field_type) {
+    case field_type_group:
+      decode_group(*step, storage, alloc);
+      break;
+    case field_type_sequence:
+      decode_sequence(*step, storage, alloc);
+      break;
+    case field_type_templateref:
+      decode_templateref(*step, storage, alloc);
+      break;
+    case field_type_int32_vector:
+      decode_int_vector(int32_vector_mref(
+          alloc, storage,
+          static_cast<const int32_vector_field_instruction *>(
+              step->instruction)));
+      break;
+    case field_type_uint32_vector:
+      decode_int_vector(uint32_vector_mref(
+          alloc, storage,
+          static_cast<const uint32_vector_field_instruction *>(
+              step->instruction)));
+      break;
+    case field_type_int64_vector:
+      decode_int_vector(int64_vector_mref(
+          alloc, storage,
+          static_cast<const int64_vector_field_instruction *>(
+              step->instruction)));
+      break;
+    case field_type_uint64_vector:
+      decode_int_vector(uint64_vector_mref(
+          alloc, storage,
+          static_cast<const uint64_vector_field_instruction *>(
+              step->instruction)));
+      break;
+    default:
+      break;
     }
-  } else {
-    debug_ << " : mandatory\n";
+    ++step;
   }
+}
 
-  pmap_state state;
+// Decodes the simple fields from @a first and returns the first group,
+// sequence, dynamic templateRef or integer vector, or @a last.
+inline const decode_step *
+fast_decoder_impl::decode_simple_fields(const decode_step *first,
+                                        const decode_step *last,
+                                        value_storage *fields,
+                                        allocator *alloc) {
+  if (!debug_.enabled())
+    return mfast::decode_fields(first, last, fields, alloc, strm_,
+                                current_pmap(), journal_);
+
+  // with a debug log the fields are decoded one at a time, so that each of
+  // them can be logged
+  for (; first != last; ++first) {
+    if (first->field_type == field_type_templateref ||
+        first->field_type >= field_type_int32_vector)
+      return first;
+
+    const char *name = first->instruction->name();
+    debug_ << "   decoding " << name << ": pmap -> " << current_pmap() << "\n"
+           << "               stream -> " << strm_ << "\n";
+
+    mfast::decode_fields(first, first + 1, fields, alloc, strm_,
+                         current_pmap(), journal_);
+
+    field_cref ref(fields + first->index, first->instruction);
+    if (first->opcode & decode_step::skip_flag)
+      debug_ << "   skipped " << name << "\n";
+    else if (!ref.present())
+      debug_ << "   decoded " << name << " is absent\n";
+    else
+      debug_ << "   decoded " << name << " = " << field_value{ref} << "\n";
+  }
+  return last;
+}
+
+inline void fast_decoder_impl::decode_group(const decode_step &step,
+                                            value_storage *storage,
+                                            allocator *alloc) {
+  group_mref mref(
+      alloc, storage,
+      static_cast<const group_field_instruction *>(step.instruction));
+
+  debug_ << "decoding group " << mref.name() << "\n";
+
+  if (mref.optional() && !current_pmap().is_next_bit_set()) {
+    debug_ << "        " << mref.name() << " is absent\n";
+    mref.omit();
+    return;
+  }
 
+  pmap_state state;
   if (mref.instruction()->segment_pmap_size() > 0) {
     decode_pmap(state);
     debug_ << "        " << mref.name() << " has group pmap -> "
            << current_pmap() << "\n";
   }
 
-  for (auto &&field : aggregate_mref(mref)) {
-    apply_mutator(*this, field);
-  }
+  decode_fields(*step.nested,
+                aggregate_mref_core_access::storage_of(aggregate_mref(mref)),
+                alloc);
 
   restore_pmap(state);
 }
 
-inline void fast_decoder_impl::visit(const sequence_mref &mref, int) {
-  debug_ << "decoding sequence " << mref.name() << " ---\n";
+inline void fast_decoder_impl::decode_sequence(const decode_step &step,
+                                               value_storage *storage,
+                                               allocator *alloc) {
+  sequence_mref mref(
+      alloc, storage,
+      static_cast<const sequence_field_instruction *>(step.instruction));
 
-  const uint32_field_instruction *length_instruction =
-      mref.instruction()->length_instruction();
-  value_storage storage;
+  debug_ << "decoding sequence " << mref.name() << " ---\n";
 
-  debug_ << "  decoding sequence length " << mref.name() << " : stream -> "
-         << strm_ << "\n";
-  uint32_mref length_mref(nullptr, &storage, length_instruction);
-  this->visit(length_mref);
+  const decode_step &length_step = step.nested->length();
+  value_storage length_storage;
+  decode_simple_fields(&length_step, &length_step + 1, &length_storage, alloc);
 
-  if (length_mref.present()) {
-    debug_ << "  decoded sequence length " << length_mref.value() << "\n";
-    mref.resize(length_mref.value());
-  } else {
-    debug_ << "  " << mref.name() << "is absent\n";
+  uint32_cref length_cref(
+      &length_storage,
+      static_cast<const uint32_field_instruction *>(length_step.instruction));
+  if (!length_cref.present()) {
     mref.omit();
+    return;
   }
-  if (length_mref.present() && length_mref.value() > 0) {
-    int i = 0;
-    for (auto &&elem : mref) {
-      this->visit(elem, i++);
-    }
-  }
-}
 
-inline void fast_decoder_impl::visit(const sequence_element_mref &mref,
-                                     int index) {
-  debug_ << "decoding  element[" << index << "] : segment pmap size = "
-         << mref.instruction()->segment_pmap_size() << "\n";
+  uint32_t length = length_cref.value();
+  // a sequence outside the projection decodes all its elements into the
+  // first one, which keeps the dictionary values of its fields, and is left
+  // empty
+  bool skip = (step.opcode & decode_step::skip_flag) != 0;
+  mref.resize(skip ? (std::min)(length, 1U) : length);
 
-  pmap_state state;
-  if (mref.instruction()->segment_pmap_size() > 0) {
-    decode_pmap(state);
-    debug_ << "    decoded pmap -> " << current_pmap() << "\n";
-  }
+  const sequence_field_instruction *inst = mref.instruction();
+  std::size_t num_fields = skip ? 0 : inst->subinstructions().size();
+  value_storage *elements =
+      static_cast<value_storage *>(storage->of_array.content_);
 
-  for (auto &&field : mref) {
-    apply_mutator(*this, field);
+  for (uint32_t i = 0; i < length; ++i) {
+    debug_ << "decoding  element[" << i << "]\n";
+
+    pmap_state state;
+    if (inst->segment_pmap_size() > 0) {
+      decode_pmap(state);
+      debug_ << "    decoded pmap -> " << current_pmap() << "\n";
+    }
+
+    decode_fields(*step.nested, elements + i * num_fields, alloc);
+
+    restore_pmap(state);
   }
 
-  restore_pmap(state);
+  if (skip)
+    mref.resize(0);
 }
 
-inline void fast_decoder_impl::visit(const nested_message_mref &mref, int) {
+inline void fast_decoder_impl::decode_templateref(const decode_step &step,
+                                                  value_storage *storage,
+                                                  allocator *alloc) {
+  nested_message_mref mref(
+      alloc, storage,
+      static_cast<const templateref_instruction *>(step.instruction));
   pmap_state state;
   message_type *saved_active_message = active_message_;
 
@@ -221,15 +342,11 @@ inline void fast_decoder_impl::visit(const nested_message_mref &mref, int) {
 
   debug_ << "   decoded pmap -> " << current_pmap() << "\n";
 
-  decoder_presence_map &pmap = current_pmap();
-
-  if (pmap.is_next_bit_set()) {
+  if (current_pmap().is_next_bit_set()) {
     uint32_t template_id;
-
     strm_.decode(template_id, false);
     debug_ << "   decoded template id -> " << template_id << "\n";
 
-    // find the message with corresponding template id
     active_message_ = repo_.find(template_id);
     if (active_message_ == nullptr) {
       using namespace coder;
@@ -240,9 +357,9 @@ inline void fast_decoder_impl::visit(const nested_message_mref &mref, int) {
     mref.set_target_instruction(active_message_->instruction(), false);
   }
 
-  for (auto &&field : mref.target()) {
-    apply_mutator(*this, field);
-  }
+  message_mref target = mref.target();
+  decode_fields(*plans_.get(target.instruction()),
+                aggregate_mref_core_access::storage_of(target), alloc);
 
   restore_pmap(state);
   active_message_ = saved_active_message;
@@ -260,6 +377,7 @@ message_type *fast_decoder_impl::decode_segment(fast_istreambuf &sb) {
          << "                   entity -> " << strm_ << "\n";
 
   uint32_t template_id = 0;
+  message_type *saved_active_message = active_message_;
 
   if (pmap.is_next_bit_set()) {
 
@@ -276,7 +394,16 @@ message_type *fast_decoder_impl::decode_segment(fast_istreambuf &sb) {
                           << coder::template_id_info(template_id));
   }
 
+  if (target_ && !detail::same_template(target_->instruction(),
+                                         active_message_->instruction())) {
+    template_id = active_message_->instruction()->id();
+    active_message_ = saved_active_message;
+    BOOST_THROW_EXCEPTION(coder::template_mismatch_error(template_id));
+  }
+
   if (force_reset_ || active_message_->instruction()->has_reset_attribute()) {
+    if (journal_)
+      journal_->record_reset(repo_);
     repo_.reset_dictionary();
   }
 
@@ -287,12 +414,83 @@ message_type *fast_decoder_impl::decode_segment(fast_istreambuf &sb) {
   // message->ensure_valid();
   // message->ref().accept_mutator(*this);
 
-  for (auto &&field : message->ref()) {
-    apply_mutator(*this, field);
+  // the fields of a target are decoded with the instructions of the decoder,
+  // which hold the dictionary slots
+  message_mref ref = message->ref();
+  if (target_)
+    ref.refers_to(message_mref(target_->allocator(),
+                               aggregate_mref_core_access::storage_of(*target_),
+                               message->instruction()));
+
+  if (sync_) {
+    // only the dictionary values are decoded, which the sync plan stores in
+    // the message storage as the full plan does
+    decode_fields(*plans_.sync_plan(message->instruction()),
+                  aggregate_mref_core_access::storage_of(ref),
+                  ref.allocator());
+  } else {
+    decode_fields(*plans_.message_plan(message->instruction()),
+                  aggregate_mref_core_access::storage_of(ref),
+                  ref.allocator());
   }
   return message;
 }
 
+message_type *fast_decoder_impl::decode_message(fast_istreambuf &sb,
+                                                const char *last) {
+  message_type *message =
+      journal_ ? decode_transaction(sb, last) : decode_segment(sb);
+  if (sb.gptr() > last)
+    BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
+  return message;
+}
+
+message_type *fast_decoder_impl::decode_transaction(fast_istreambuf &sb,
+                                                    const char *last) {
+  message_type *saved_active_message = active_message_;
+  journal_->clear(repo_.dictionary());
+  try {
+    message_type *message = decode_segment(sb);
+    if (sb.gptr() > last)
+      BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
+    return message;
+  } catch (...) {
+    active_message_ = saved_active_message;
+    journal_->rollback(repo_);
+    // the rolled back values refer to the fields of the target again
+    if (target_)
+      repo_.copy_contents(contents_);
+    throw;
+  }
+}
+
+std::size_t fast_decoder_impl::decode_all(
+    const char *&first, const char *last,
+    const std::function<void(const message_cref &)> &handler, bool force_reset,
+    std::size_t header_size) {
+  // a single stream buffer is shared by all the messages
+  fast_istreambuf sb(first, last - first);
+  sync_ = false;
+  std::size_t count = 0;
+  while (last - sb.gptr() > static_cast<std::ptrdiff_t>(header_size)) {
+    sb.gbump(header_size);
+    force_reset_ = force_reset;
+    force_reset = false;
+    message_cref result = decode_message(sb, last)->cref();
+    first = sb.gptr();
+    ++count;
+    handler(result);
+  }
+  return count;
+}
+
+void fast_decoder_impl::included() {
+  active_message_ = repo_.unique_entry();
+  strm_.dictionary(repo_.dictionary());
+  repo_.for_each_template(
+      [this](const template_instruction *inst) { plans_.get(inst); });
+}
+
 fast_decoder::fast_decoder(allocator *alloc)
     : impl_(new fast_decoder_impl(alloc)) {}
 
@@ -301,7 +499,12 @@ fast_decoder::~fast_decoder() { delete impl_; }
 void fast_decoder::include(const templates_description *const *descriptions,
                            std::size_t description_count) {
   impl_->repo_.build(descriptions, description_count);
-  impl_->active_message_ = impl_->repo_.unique_entry();
+  impl_->included();
+}
+
+void fast_decoder::include(std::shared_ptr<const template_set> templates) {
+  impl_->repo_.build(std::move(templates));
+  impl_->included();
 }
 
 message_cref fast_decoder::decode(const char *&first, const char *last,
@@ -309,11 +512,104 @@ message_cref fast_decoder::decode(const char *&first, const char *last,
   assert(first < last);
   fast_istreambuf sb(first, last - first);
   impl_->force_reset_ = force_reset;
-  message_cref result = impl_->decode_segment(sb)->cref();
+  impl_->sync_ = false;
+  message_cref result = impl_->decode_message(sb, last)->cref();
+  first = sb.gptr();
+  return result;
+}
+
+void fast_decoder::decode_into(const message_mref &target, const char *&first,
+                               const char *last, bool force_reset) {
+  assert(first < last);
+  fast_istreambuf sb(first, last - first);
+  impl_->force_reset_ = force_reset;
+  impl_->sync_ = false;
+  impl_->target_ = &target;
+  impl_->contents_.resize(impl_->repo_.dictionary()->size());
+  impl_->strm_.contents(&impl_->contents_);
+  try {
+    impl_->decode_message(sb, last);
+  } catch (...) {
+    impl_->target_ = nullptr;
+    impl_->strm_.contents(nullptr);
+    throw;
+  }
+  impl_->target_ = nullptr;
+  impl_->strm_.contents(nullptr);
+  first = sb.gptr();
+}
+
+uint32_t fast_decoder::sync(const char *&first, const char *last,
+                            bool force_reset) {
+  assert(first < last);
+  fast_istreambuf sb(first, last - first);
+  impl_->force_reset_ = force_reset;
+  impl_->sync_ = true;
+  uint32_t template_id = impl_->decode_message(sb, last)->instruction()->id();
+  first = sb.gptr();
+  return template_id;
+}
+
+message_cref fast_decoder::decode_trusted(const char *&first, const char *last,
+                                          bool force_reset) {
+  assert(first < last);
+  // let the decoder read into the padding, so that the entities at the end of
+  // the frame are decoded a word at a time too
+  fast_istreambuf sb(first, last - first + trusted_padding);
+  impl_->force_reset_ = force_reset;
+  impl_->sync_ = false;
+  message_cref result = impl_->decode_message(sb, last)->cref();
   first = sb.gptr();
   return result;
 }
 
+std::size_t fast_decoder::decode_all_i(const char *&first, const char *last,
+                                       const message_handler &handler,
+                                       bool force_reset,
+                                       std::size_t header_size) {
+  return impl_->decode_all(first, last, handler, force_reset, header_size);
+}
+
+void fast_decoder::projection(uint32_t template_id, const char *const *paths,
+                              std::size_t path_count) {
+  message_type *message = impl_->repo_.find(template_id);
+  if (message == nullptr) {
+    BOOST_THROW_EXCEPTION(fast_dynamic_error("D9")
+                          << coder::template_id_info(template_id));
+  }
+  impl_->plans_.project(
+      message->instruction(),
+      field_projection(message->instruction(), paths, path_count));
+}
+
+void fast_decoder::sync_only(uint32_t template_id, bool enabled) {
+  message_type *message = impl_->repo_.find(template_id);
+  if (message == nullptr) {
+    BOOST_THROW_EXCEPTION(fast_dynamic_error("D9")
+                          << coder::template_id_info(template_id));
+  }
+  impl_->plans_.sync_only(message->instruction(), enabled);
+}
+
+void fast_decoder::journal(dictionary_journal *journal) {
+  impl_->journal_ = journal;
+}
+
+void fast_decoder::zero_copy(bool enabled) { impl_->strm_.zero_copy(enabled); }
+
+void fast_decoder::save_dictionary(std::vector<char> &blob) const {
+  message_type *message = impl_->active_message_;
+  impl_->repo_.save_dictionary(blob,
+                               message ? message->instruction()->id() : -1);
+}
+
+void fast_decoder::restore_dictionary(const char *data, std::size_t size) {
+  int64_t template_id = impl_->repo_.restore_dictionary(data, size);
+  impl_->active_message_ =
+      template_id < 0 ? nullptr
+                      : impl_->repo_.find(static_cast<uint32_t>(template_id));
+}
+
 void fast_decoder::debug_log(std::ostream *log) { impl_->debug_.set(log); }
 
 void fast_decoder::warning_log(std::ostream *os) {
@@ -11,14 +11,24 @@
 #include "mfast/instructions/byte_vector_instruction.h"
 #include "fast_istreambuf.h"
 #include "decoder_presence_map.h"
+#include "../common/codec_helper.h"
 
 namespace mfast {
 class fast_istream;
 std::ostream &operator<<(std::ostream &os, const fast_istream &istream);
-class fast_istream {
+class fast_istream : private detail::codec_helper {
 public:
   fast_istream(fast_istreambuf *sb);
 
+  // the previous values of the fields, see codec_helper::dictionary()
+  using detail::codec_helper::dictionary;
+  using detail::codec_helper::contents;
+  using detail::codec_helper::previous_value_of;
+  using detail::codec_helper::save_previous_value;
+  using detail::codec_helper::load_previous_value;
+  using detail::codec_helper::delta_base_value_of;
+  using detail::codec_helper::tail_base_value_of;
+
   void reset(fast_istreambuf *sb);
 
   bool eof() const { return buf_->in_avail() == 0; }
@@ -32,12 +42,7 @@ public:
   enable_if_t<std::is_integral<T>::value, bool> decode(T &result,
                                                        Nullable nullable);
 
-  void decode(decoder_presence_map &pmap) {
-    if (!pmap.load(*buf_)) {
-      while (0 == (buf_->sbumpc() & 0x80))
-        ;
-    }
-  }
+  void decode(decoder_presence_map &pmap) { pmap.load(*buf_); }
 
   /**
    * Decode an ascii string.
@@ -56,33 +61,33 @@ public:
   bool decode(const char *&ascii, uint32_t &len,
               const ascii_field_instruction * /* instruction */,
               Nullable nullable) {
-    char c = buf_->sgetc();
     ascii = buf_->gptr();
+    char c = buf_->sbumpc();
     if ((c & '\x7F') == 0) {
-      buf_->gbump(1);
-
       if (c == '\x80') {
         len = 0;
         return !nullable;
       }
-      c = buf_->sgetc();
-      buf_->gbump(1);
+      c = buf_->sbumpc();
 
       len = 1;
       if (c == '\x80') {
         len -= nullable;
         return true;
       } else if (nullable && c == '\x00') {
-        c = buf_->sgetc();
-        buf_->gbump(1);
+        c = buf_->sbumpc();
         if (c == '\x80')
           return true;
       }
       BOOST_THROW_EXCEPTION(fast_dynamic_error("D9"));
     }
 
-    len = static_cast<uint32_t>(buf_->get_entity_length());
-    buf_->gbump(len);
+    len = 1;
+    if ((c & '\x80') == 0) {
+      const std::size_t n = buf_->get_entity_length();
+      buf_->gbump(n);
+      len += static_cast<uint32_t>(n);
+    }
     return true;
   }
 
@@ -99,6 +104,8 @@ public:
               const unicode_field_instruction * /* instruction */,
               Nullable nullable) {
     if (this->decode(len, nullable)) {
+      if (len > buf_->in_avail())
+        BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
       bv = buf_->gptr();
       buf_->gbump(len);
       return true;
@@ -119,6 +126,8 @@ public:
               const byte_vector_field_instruction * /* instruction */,
               Nullable nullable) {
     if (this->decode(len, nullable)) {
+      if (len > buf_->in_avail())
+        BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
       bv = reinterpret_cast<const unsigned char *>(buf_->gptr());
       buf_->gbump(len);
       return true;
@@ -129,6 +138,11 @@ public:
   std::ostream &warning_log() { return *warning_log_; }
   void warning_log(std::ostream *log) { warning_log_ = log; }
 
+  /// Returns true if byte vector fields without operator may refer to the
+  /// input buffer instead of being copied into the message.
+  bool zero_copy() const { return zero_copy_; }
+  void zero_copy(bool enabled) { zero_copy_ = enabled; }
+
 private:
   friend std::ostream &operator<<(std::ostream &os,
                                   const fast_istream &istream);
@@ -137,6 +151,7 @@ private:
   const char *egptr() const { return buf_->egptr_; }
   fast_istreambuf *buf_;
   std::ostream *warning_log_;
+  bool zero_copy_;
 };
 
 namespace detail {
@@ -159,6 +174,7 @@ struct temp_uint64_t {
   bool carry;
 
   temp_uint64_t(int) : value(0), carry(false) {}
+  explicit temp_uint64_t(uint64_t v) : value(v), carry(false) {}
   temp_uint64_t &operator=(uint64_t other) {
     value = other;
     return *this;
@@ -208,34 +224,61 @@ inline bool to_nullable_value(uint64_t &result, temp_uint64_t tmp,
 }
 
 inline fast_istream::fast_istream(fast_istreambuf *sb)
-    : buf_(sb), warning_log_(nullptr) {}
+    : buf_(sb), warning_log_(nullptr), zero_copy_(false) {}
 inline void fast_istream::reset(fast_istreambuf *sb) { buf_ = sb; }
 template <typename T, typename Nullable>
 enable_if_t<std::is_integral<T>::value, bool>
 fast_istream::decode(T &result, Nullable nullable) {
   typename detail::int_trait<T>::temp_type tmp = 0;
-
-  char c = buf_->sbumpc();
   // bool decrement_value = true;
   int decrement_value = nullable;
-  if (std::is_unsigned<T>::value) {
-    tmp = c & 0x7F;
-  } else {
-    if (c & 0x40) {
-      // this is a negative integer
+
+  const uint64_t word =
+      buf_->in_avail() >= 8 ? detail::load_uint64_le(buf_->gptr_) : 0;
+  const uint64_t stop_bits = word & detail::stop_bits_mask;
+
+  if (__builtin_expect(stop_bits != 0, 1)) {
+    // The whole entity lies within the next 8 bytes, decode it with a single
+    // load instead of checking each byte.
+    unsigned len = 1;
+    uint64_t value = word & 0x7F;
+    if ((word & 0x80) == 0) {
+      len = detail::count_trailing_zeros(stop_bits) / 8 + 1;
+      value = detail::compact_stop_bit_groups(word, len);
+    }
+    buf_->gbump(len);
+
+    if (!std::is_unsigned<T>::value && (word & 0x40)) {
+      // this is a negative integer, sign extend the 7*len bits value
       decrement_value = 0;
-      tmp = (static_cast<T>(-1) ^ 0x7F ) | (c & 0x7F);
+      value |= ~UINT64_C(0) << (7 * len);
+    }
+    tmp = static_cast<typename detail::int_trait<T>::temp_type>(value);
+  } else {
+    // An overlong entity or one near the end of the buffer; the buffer end is
+    // checked once for the whole entity rather than for each byte.
+    const char *p = buf_->gptr_;
+    const std::size_t len = buf_->get_entity_length();
+    buf_->gbump(len);
+    char c = p[0];
+    if (std::is_unsigned<T>::value) {
+      tmp = c & 0x7F;
     } else {
-      // positive integer, mask the most significant two bits
-      tmp = c & 0x3F;
+      if (c & 0x40) {
+        // this is a negative integer
+        decrement_value = 0;
+        tmp = (static_cast<T>(-1) ^ 0x7F) | (c & 0x7F);
+      } else {
+        // positive integer, mask the most significant two bits
+        tmp = c & 0x3F;
+      }
     }
-  }
 
-  while ((c & 0x80) == 0) {
-    tmp <<= 7;
-    c = buf_->sbumpc();
-    tmp |= (c & 0x7F);
-  };
+    for (std::size_t i = 1; i < len; ++i) {
+      tmp <<= 7;
+      tmp |= (p[i] & 0x7F);
+    }
+  }
 
   if (nullable) {
     return detail::to_nullable_value(result, tmp, decrement_value);
@@ -0,0 +1,42 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "mfast/string_ref.h"
+#include "mfast/vector_ref.h"
+#include "fast_istream.h"
+
+namespace mfast {
+
+// Decoding byte vector fields as views which refer to the input buffer rather
+// than copies owned by the message. They are only used for fields whose
+// previous value is not shared, since a dictionary value must not refer to an
+// input buffer which is released after decoding.
+
+/// Strings are always copied into the message: an ascii string carries the
+/// stop bit on its last character in the buffer, and c_str() must return a
+/// null terminated string owned by the message for both kinds of strings.
+///
+/// Returns false without consuming the stream.
+template <typename T, typename Nullable>
+inline bool decode_view(fast_istream &, const string_mref_base<T> &,
+                        Nullable) {
+  return false;
+}
+
+/// Decode a byte vector referring to the input buffer.
+template <typename Nullable>
+inline bool decode_view(fast_istream &strm, const byte_vector_mref &mref,
+                        Nullable nullable) {
+  const unsigned char *buf;
+  uint32_t len;
+  if (strm.decode(buf, len, mref.instruction(), nullable))
+    mref.refers_to(buf, len);
+  else
+    mref.omit();
+  return true;
+}
+}
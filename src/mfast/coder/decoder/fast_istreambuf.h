@@ -8,11 +8,14 @@
 #include <stdexcept>
 
 #include "mfast/exceptions.h"
+#include "../common/exceptions.h"
+#include "../common/stop_bit.h"
 #include <iostream>
 
 namespace mfast {
 class fast_istream;
 class decoder_presence_map;
+struct fast_decoder_impl;
 
 namespace coder {
 struct fast_decoder_base;
@@ -26,11 +29,10 @@ public:
   // get the length of the stop bit encoded entity
   std::size_t get_entity_length() {
     const std::size_t n = in_avail();
-    for (std::size_t i = 0; i < n; ++i) {
-      if (gptr_[i] & 0x80)
-        return i + 1;
-    }
-    BOOST_THROW_EXCEPTION(fast_dynamic_error("Buffer underflow"));
+    const std::size_t i = detail::find_stop_bit(gptr_, n);
+    if (i < n)
+      return i + 1;
+    BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
   }
 
   const char *gptr() { return gptr_; }
@@ -39,12 +41,13 @@ protected:
   friend class fast_istream;
   friend class decoder_presence_map;
   friend class fast_decoder;
+  friend struct fast_decoder_impl;
   friend struct coder::fast_decoder_base;
 
   void gbump(std::ptrdiff_t n) { gptr_ += n; }
   unsigned char sbumpc() {
     if (in_avail() < 1)
-      BOOST_THROW_EXCEPTION(fast_dynamic_error("Buffer underflow"));
+      BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
     return *(gptr_++);
   }
 
@@ -0,0 +1,93 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#include "../fast_stream_decoder.h"
+#include "../common/exceptions.h"
+#include <algorithm>
+
+namespace mfast {
+
+const std::size_t fast_stream_decoder::min_append_size;
+
+fast_stream_decoder::fast_stream_decoder(fast_decoder &decoder,
+                                         std::size_t max_journal_entries,
+                                         std::size_t max_journal_bytes)
+    : decoder_(decoder), journal_(max_journal_entries, max_journal_bytes) {
+  decoder_.journal(&journal_);
+}
+
+fast_stream_decoder::~fast_stream_decoder() { decoder_.journal(nullptr); }
+
+void fast_stream_decoder::reset() { pending_.clear(); }
+
+decode_status_t fast_stream_decoder::try_decode(const char *&first,
+                                                const char *last,
+                                                message_cref &msg,
+                                                bool force_reset) {
+  try {
+    msg.refers_to(decoder_.decode(first, last, force_reset));
+    return decode_complete;
+  } catch (coder::buffer_underflow_error &) {
+    // the dictionary cannot be restored when the journal has overflowed;
+    // decoding the message again would then produce wrong values
+    if (!journal_.overflow())
+      return decode_need_more;
+    error_ = std::current_exception();
+  } catch (fast_error &) {
+    error_ = std::current_exception();
+  }
+  return decode_error;
+}
+
+decode_status_t fast_stream_decoder::decode(const char *&first,
+                                            const char *last,
+                                            message_cref &msg,
+                                            bool force_reset) {
+  if (pending_.empty()) {
+    if (first == last)
+      return decode_need_more;
+
+    // decode directly from the chunk
+    const char *pos = first;
+    decode_status_t status = try_decode(pos, last, msg, force_reset);
+    if (status == decode_complete)
+      first = pos;
+    else if (status == decode_need_more) {
+      pending_.assign(first, last);
+      first = last;
+    }
+    return status;
+  }
+
+  // The message straddles chunks. Move the bytes of the chunk into the
+  // buffer in growing steps and retry until the message is complete, so that
+  // a short message tail does not copy the whole chunk.
+  const std::size_t buffered = pending_.size();
+  const char *next = first;
+  while (next != last) {
+    std::size_t n = std::min<std::size_t>(
+        last - next, std::max(pending_.size(), min_append_size));
+    pending_.insert(pending_.end(), next, next + n);
+    next += n;
+
+    const char *pos = pending_.data();
+    decode_status_t status =
+        try_decode(pos, pending_.data() + pending_.size(), msg, force_reset);
+    if (status == decode_complete) {
+      // the message ends within the chunk as it could not be completed from
+      // the bytes buffered before
+      first += (pos - pending_.data()) - buffered;
+      pending_.clear();
+      return status;
+    }
+    if (status == decode_error) {
+      pending_.clear();
+      return status;
+    }
+  }
+  first = last;
+  return decode_need_more;
+}
+}
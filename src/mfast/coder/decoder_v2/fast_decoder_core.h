@@ -16,10 +16,13 @@
 #include "../common/debug_stream.h"
 #include "../common/template_repo.h"
 #include "../common/codec_helper.h"
+#include "../common/dictionary_journal.h"
+#include "../common/field_projection.h"
 #include "../decoder/decoder_presence_map.h"
-#include "../common/codec_helper.h"
 #include "../decoder/fast_istream.h"
+#include "../decoder/fast_istream_view.h"
 #include "fast_istream_extractor.h"
+#include <memory>
 #include <tuple>
 #include <vector>
 namespace mfast {
@@ -53,6 +56,9 @@ struct MFAST_CODER_EXPORT fast_decoder_base : detail::codec_helper {
   template <typename T, typename TypeCategory>
   void decode_field(const T &ext_ref, none_operator_tag, TypeCategory);
 
+  template <typename T>
+  void decode_field(const T &ext_ref, none_operator_tag, string_type_tag);
+
   template <typename T, typename TypeCategory>
   void decode_field(const T &ext_ref, constant_operator_tag, TypeCategory);
 
@@ -77,10 +83,28 @@ struct MFAST_CODER_EXPORT fast_decoder_base : detail::codec_helper {
   template <typename T>
   void decode_field(const T &ext_ref, tail_operator_tag, string_type_tag);
 
+  // Only the operators which update the dictionary record into the journal so
+  // that the other fields do not pay for the check.
+  template <typename MRef> void record_previous_value(const MRef &mref) {
+    if (journal_)
+      journal_->record(mref);
+  }
+
+  // Whether the field is outside the projection of the template being
+  // decoded and is consumed from the stream without being stored.
+  template <typename T> bool skipped(const T &ext_ref) const {
+    return __builtin_expect(projection_ != nullptr, 0) &&
+           projection_->skipped(ext_ref.get().instruction());
+  }
+
+  static void skip_bytes(fast_istreambuf &sb, std::size_t n) { sb.gbump(n); }
+
   fast_istream strm_;
   allocator *message_alloc_;
   bool force_reset_;
   decoder_presence_map *current_;
+  dictionary_journal *journal_;
+  const field_projection *projection_;
 };
 
 template <typename T> class decoder_pmap_saver {
@@ -107,7 +131,7 @@ public:
 template <bool MoreThanOneToken> struct token_base {
   unsigned current_token_;
 
-  void get_token() const { return current_token_; }
+  unsigned get_token() const { return current_token_; }
   void set_token(unsigned token) { current_token_ = token; }
 };
 
@@ -128,6 +152,14 @@ struct fast_decoder_core : public fast_decoder_base,
 
     repo_.build(rest...);
     active_message_info_ = repo_.unique_entry();
+    this->dictionary(repo_.dictionary());
+  }
+
+  template <typename... Desc>
+  void init(std::shared_ptr<const template_set> templates, Desc... rest) {
+    repo_.build(std::move(templates), rest...);
+    active_message_info_ = repo_.unique_entry();
+    this->dictionary(repo_.dictionary());
   }
 
   const static unsigned num_reserved_msgs = (NumTokens == 0 ? 1 : NumTokens);
@@ -137,8 +169,60 @@ struct fast_decoder_core : public fast_decoder_base,
 
   const message_mref &decode_segment(fast_istreambuf &sb);
 
+  // decode_segment() which rolls back the dictionary changes when the message
+  // fails to decode or ends beyond last
+  const message_mref &decode_transaction(fast_istreambuf &sb,
+                                         const char *last);
+
   const message_mref &decode_stream(unsigned token, const char *&first,
-                                    const char *last, bool force_reset);
+                                    const char *last, bool force_reset,
+                                    std::size_t padding = 0);
+
+  void decode_into_i(const message_mref &target, const char *&first,
+                     const char *last, bool force_reset) {
+    target_ = &target;
+    contents_.resize(repo_.dictionary()->size());
+    this->contents(&contents_);
+    try {
+      this->decode_stream(0, first, last, force_reset);
+    } catch (...) {
+      target_ = nullptr;
+      this->contents(nullptr);
+      throw;
+    }
+    target_ = nullptr;
+    this->contents(nullptr);
+  }
+
+  void projection_i(uint32_t template_id, const char *const *paths,
+                    std::size_t path_count) {
+    info_entry *info = repo_.find(template_id);
+    if (info == nullptr) {
+      BOOST_THROW_EXCEPTION(fast_dynamic_error("D9")
+                            << template_id_info(template_id));
+    }
+    info->projection_ = std::make_shared<field_projection>(
+        info->messages_[0].instruction(), paths, path_count);
+  }
+
+  void save_dictionary_i(std::vector<char> &blob) const {
+    int64_t template_id = -1;
+    if (active_message_info_)
+      template_id = active_message_info_->messages_[0].instruction()->id();
+    repo_.save_dictionary(blob, template_id);
+  }
+
+  void restore_dictionary_i(const char *data, std::size_t size) {
+    int64_t template_id = repo_.restore_dictionary(data, size);
+    active_message_info_ =
+        template_id < 0 ? nullptr
+                        : repo_.find(static_cast<uint32_t>(template_id));
+  }
+
+  template <typename Callback>
+  std::size_t decode_all_stream(unsigned token, const char *&first,
+                                const char *last, Callback &callback,
+                                bool force_reset, std::size_t header_size);
 
   typedef std::vector<mfast::message_type> message_resources_t;
 
@@ -148,6 +232,8 @@ struct fast_decoder_core : public fast_decoder_base,
   struct info_entry {
     mfast::message_mref messages_[num_reserved_msgs];
     coder::message_decode_function_t decode_fun_;
+    // the fields skipped in the messages of the template, if any
+    std::shared_ptr<const field_projection> projection_;
 
     info_entry() = default;
     info_entry(info_entry_init_t init_pair) : decode_fun_(init_pair.second) {
@@ -187,11 +273,18 @@ struct fast_decoder_core : public fast_decoder_base,
 
   template_repo<info_entry_converter> repo_;
   info_entry *active_message_info_;
+  // the message to decode into instead of the messages of the decoder, if
+  // any, and its fields with the instructions of the decoder
+  const message_mref *target_;
+  message_mref target_message_;
+  // the contents of the string and byteVector previous values decoded into
+  // a target, which are not kept in the target
+  contents_t contents_;
 };
 
 inline fast_decoder_base::fast_decoder_base(allocator *alloc)
     : strm_(nullptr), message_alloc_(alloc), force_reset_(false),
-      current_(nullptr) {}
+      current_(nullptr), journal_(nullptr), projection_(nullptr) {}
 
 template <typename T> inline void fast_decoder_base::visit(const T &ext_ref) {
   typedef typename T::type_category type_category;
@@ -256,11 +349,18 @@ inline void fast_decoder_base::decode_field(const T &ext_ref,
 
   if (length.present()) {
     std::size_t len = length.get().value();
-    ext_ref.set().resize(len);
+    // a sequence outside the projection decodes all its elements into the
+    // first one, which keeps the dictionary values of its fields, and is left
+    // empty
+    bool skip = this->skipped(ext_ref);
+    ext_ref.set().resize(skip ? (std::min)(len, std::size_t(1)) : len);
 
     for (std::size_t i = 0; i < len; ++i) {
-      this->visit(ext_ref[i]);
+      this->visit(ext_ref[skip ? 0 : i]);
     }
+
+    if (skip)
+      ext_ref.set().resize(0);
   } else {
     ext_ref.omit();
   }
@@ -276,6 +376,12 @@ template <typename T, typename TypeCategory>
 void fast_decoder_base::decode_field(const T &ext_ref, none_operator_tag,
                                      TypeCategory) {
   fast_istream &stream = this->strm_;
+  if (this->skipped(ext_ref)) {
+    skip_value(stream, ext_ref);
+    return;
+  }
+  if (ext_ref.previous_value_shared())
+    record_previous_value(ext_ref.set());
   stream >> ext_ref;
 
   // Fast Specification 1.1, page 22
@@ -290,11 +396,34 @@ void fast_decoder_base::decode_field(const T &ext_ref, none_operator_tag,
     save_previous_value(ext_ref.set());
 }
 
+template <typename T>
+void fast_decoder_base::decode_field(const T &ext_ref, none_operator_tag,
+                                     string_type_tag) {
+  fast_istream &stream = this->strm_;
+  if (this->skipped(ext_ref)) {
+    skip_value(stream, ext_ref);
+  } else if (ext_ref.previous_value_shared()) {
+    record_previous_value(ext_ref.set());
+    stream >> ext_ref;
+    save_previous_value(ext_ref.set());
+  } else if (!stream.zero_copy() ||
+             !decode_view(stream, ext_ref.set(), ext_ref.nullable())) {
+    stream >> ext_ref;
+  }
+}
+
 template <typename T, typename TypeCategory>
 void fast_decoder_base::decode_field(const T &ext_ref, constant_operator_tag,
                                      TypeCategory) {
   decoder_presence_map &pmap = *this->current_;
+  if (this->skipped(ext_ref)) {
+    if (ext_ref.optional())
+      pmap.is_next_bit_set();
+    return;
+  }
   auto mref = ext_ref.set();
+  if (ext_ref.previous_value_shared())
+    record_previous_value(mref);
 
   if (ext_ref.optional()) {
     // An optional field with the constant operator will occupy a single bit. If
@@ -325,6 +454,7 @@ void fast_decoder_base::decode_field(const T &ext_ref, copy_operator_tag,
   fast_istream &stream = this->strm_;
   decoder_presence_map &pmap = *this->current_;
   auto mref = ext_ref.set();
+  record_previous_value(mref);
 
   if (pmap.is_next_bit_set()) {
     stream >> ext_ref;
@@ -376,6 +506,7 @@ void fast_decoder_base::decode_field(const T &ext_ref, increment_operator_tag,
   fast_istream &stream = this->strm_;
   decoder_presence_map &pmap = *this->current_;
   auto mref = ext_ref.set();
+  record_previous_value(mref);
 
   if (pmap.is_next_bit_set()) {
     stream >> ext_ref;
@@ -428,7 +559,14 @@ void fast_decoder_base::decode_field(const T &ext_ref, default_operator_tag,
                                      TypeCategory) {
   fast_istream &stream = this->strm_;
   decoder_presence_map &pmap = *this->current_;
+  if (this->skipped(ext_ref)) {
+    if (pmap.is_next_bit_set())
+      skip_value(stream, ext_ref);
+    return;
+  }
   auto mref = ext_ref.set();
+  if (ext_ref.previous_value_shared())
+    record_previous_value(mref);
 
   // Mandatory integer, decimal, string and byte vector fields – one bit. If
   // set, the value
@@ -464,6 +602,7 @@ void fast_decoder_base::decode_field(const T &ext_ref, delta_operator_tag,
                                      integer_type_tag) {
   fast_istream &stream = this->strm_;
   auto mref = ext_ref.set();
+  record_previous_value(mref);
   typedef typename T::mref_type::value_type int_type;
 
   int64_t d;
@@ -488,6 +627,7 @@ void fast_decoder_base::decode_field(const T &ext_ref, delta_operator_tag,
                                      string_type_tag) {
   fast_istream &stream = this->strm_;
   auto mref = ext_ref.set();
+  record_previous_value(mref);
   // The delta value is represented as a Signed Integer subtraction length
   // followed by an ASCII
   // String.
@@ -528,6 +668,7 @@ void fast_decoder_base::decode_field(const T &ext_ref, delta_operator_tag,
                                      decimal_type_tag) {
   fast_istream &stream = this->strm_;
   decimal_mref mref = ext_ref.set();
+  record_previous_value(mref);
   stream >> ext_ref;
   if (!ext_ref.optional() || mref.present()) {
     value_storage bv = delta_base_value_of(mref);
@@ -552,6 +693,7 @@ void fast_decoder_base::decode_field(const T &ext_ref, tail_operator_tag,
   decoder_presence_map &pmap = *this->current_;
 
   auto mref = ext_ref.set();
+  record_previous_value(mref);
 
   if (pmap.is_next_bit_set()) {
     uint32_t len;
@@ -612,7 +754,7 @@ template <unsigned NumTokens>
 inline fast_decoder_core<NumTokens>::fast_decoder_core(allocator *alloc)
     : fast_decoder_base(alloc),
       repo_(info_entry_converter(alloc), NumTokens == 0 ? nullptr : alloc),
-      active_message_info_(nullptr) {}
+      active_message_info_(nullptr), target_(nullptr) {}
 
 template <unsigned NumTokens>
 void fast_decoder_core<NumTokens>::visit(const nested_message_mref &mref) {
@@ -624,21 +766,27 @@ void fast_decoder_core<NumTokens>::visit(const nested_message_mref &mref) {
 
     strm_.decode(template_id, false_type());
     // find the message with corresponding template id
-    active_message_info_ = repo_.find(template_id);
+    info_entry *target_info = repo_.find(template_id);
 
-    if (active_message_info_ == nullptr) {
+    if (target_info == nullptr) {
       BOOST_THROW_EXCEPTION(
           fast_dynamic_error("D9")
           << template_id_info(template_id)
           << referenced_by_info(this->active_message().name()));
     }
+    active_message_info_ = target_info;
   }
 
   mref.set_target_instruction(this->active_message().instruction(),
                               false_type());
+  // a projection only applies to the messages of its template, not to the
+  // templates referred to by other messages
+  const field_projection *saved_projection = this->projection_;
+  this->projection_ = nullptr;
   message_decode_function_t decode = active_message_info_->decode_fun_;
   (this->*decode)(mref.target());
 
+  this->projection_ = saved_projection;
   this->active_message_info_ = saved_active_info;
 }
 
@@ -652,6 +800,7 @@ fast_decoder_core<NumTokens>::decode_segment(fast_istreambuf &sb) {
   strm_.decode(pmap);
 
   uint32_t template_id = 0;
+  info_entry *saved_active_info = active_message_info_;
 
   if (pmap.is_next_bit_set()) {
     strm_.decode(template_id, false_type());
@@ -668,12 +817,29 @@ fast_decoder_core<NumTokens>::decode_segment(fast_istreambuf &sb) {
   // we have to keep the active_message_ in a new variable
   // because after the accept_mutator(), the active_message_
   // may change because of the decoding of dynamic template reference
-  const message_mref &message = this->active_message();
+  const message_mref *target = &this->active_message();
+  if (target_) {
+    if (!detail::same_template(target_->instruction(),
+                               target->instruction())) {
+      template_id = target->instruction()->id();
+      active_message_info_ = saved_active_info;
+      BOOST_THROW_EXCEPTION(coder::template_mismatch_error(template_id));
+    }
+    target_message_.refers_to(
+        message_mref(target_->allocator(),
+                     aggregate_mref_core_access::storage_of(*target_),
+                     target->instruction()));
+    target = &target_message_;
+  }
+  const message_mref &message = *target;
 
   if (force_reset_ || message.instruction()->has_reset_attribute()) {
+    if (journal_)
+      journal_->record_reset(repo_);
     repo_.reset_dictionary();
   }
 
+  this->projection_ = active_message_info_->projection_.get();
   message_decode_function_t decode = active_message_info_->decode_fun_;
   (this->*decode)(message);
 
@@ -682,16 +848,67 @@ fast_decoder_core<NumTokens>::decode_segment(fast_istreambuf &sb) {
 
 template <unsigned NumTokens>
 const message_mref &fast_decoder_core<NumTokens>::decode_stream(
-    unsigned token, const char *&first, const char *last, bool force_reset) {
+    unsigned token, const char *&first, const char *last, bool force_reset,
+    std::size_t padding) {
   assert(first < last);
-  fast_istreambuf sb(first, last - first);
+  // a non-zero padding lets the decoder read beyond last, so that the entities
+  // at the end of the frame are decoded a word at a time too; the message end
+  // is validated once instead
+  fast_istreambuf sb(first, last - first + padding);
   this->set_token(token);
   this->force_reset_ = force_reset;
-  const auto &result = this->decode_segment(sb);
+
+  const auto &result = journal_ ? this->decode_transaction(sb, last)
+                                 : this->decode_segment(sb);
+  if (sb.gptr() > last)
+    BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
   first = sb.gptr();
   return result;
 }
 
+template <unsigned NumTokens>
+template <typename Callback>
+std::size_t fast_decoder_core<NumTokens>::decode_all_stream(
+    unsigned token, const char *&first, const char *last, Callback &callback,
+    bool force_reset, std::size_t header_size) {
+  // a single stream buffer is shared by all the messages
+  fast_istreambuf sb(first, last - first);
+  this->set_token(token);
+  std::size_t count = 0;
+  while (last - sb.gptr() > static_cast<std::ptrdiff_t>(header_size)) {
+    skip_bytes(sb, header_size);
+    this->force_reset_ = force_reset;
+    force_reset = false;
+    const auto &result = journal_ ? this->decode_transaction(sb, last)
+                                   : this->decode_segment(sb);
+    first = sb.gptr();
+    ++count;
+    callback(result);
+  }
+  return count;
+}
+
+template <unsigned NumTokens>
+const message_mref &
+fast_decoder_core<NumTokens>::decode_transaction(fast_istreambuf &sb,
+                                                 const char *last) {
+  info_entry *saved_active_info = this->active_message_info_;
+  journal_->clear(repo_.dictionary());
+  try {
+    const auto &result = this->decode_segment(sb);
+    if (sb.gptr() > last)
+      BOOST_THROW_EXCEPTION(coder::buffer_underflow_error());
+    return result;
+  } catch (...) {
+    this->active_message_info_ = saved_active_info;
+    journal_->rollback(repo_);
+    // the rolled back values refer to the fields of the target again
+    if (target_)
+      repo_.copy_contents(contents_);
+    throw;
+  }
+}
+
 } /* coder */
 
 } /* mfast */
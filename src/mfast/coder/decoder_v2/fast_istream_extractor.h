@@ -85,6 +85,53 @@ operator>>(fast_istream &strm,
   return strm;
 }
 
+// Consume the value of a field outside the projection of its template,
+// which is neither stored in the message nor copied.
+
+template <typename T>
+inline void skip_value(fast_istream &strm, const T &ext_ref) {
+  typename T::mref_type::value_type value;
+  strm.decode(value, ext_ref.nullable());
+}
+
+template <typename Operator, typename Properties>
+inline void
+skip_value(fast_istream &strm,
+           const ext_mref<ascii_string_mref, Operator, Properties> &ext_ref) {
+  const char *buf;
+  uint32_t len;
+  strm.decode(buf, len, ext_ref.get().instruction(), ext_ref.nullable());
+}
+
+template <typename Operator, typename Properties>
+inline void
+skip_value(fast_istream &strm,
+           const ext_mref<unicode_string_mref, Operator, Properties> &ext_ref) {
+  const char *buf;
+  uint32_t len;
+  strm.decode(buf, len, ext_ref.get().instruction(), ext_ref.nullable());
+}
+
+template <typename Operator, typename Properties>
+inline void
+skip_value(fast_istream &strm,
+           const ext_mref<byte_vector_mref, Operator, Properties> &ext_ref) {
+  const unsigned char *buf;
+  uint32_t len;
+  strm.decode(buf, len, ext_ref.get().instruction(), ext_ref.nullable());
+}
+
+template <typename Operator, typename Properties>
+inline void
+skip_value(fast_istream &strm,
+           const ext_mref<decimal_mref, Operator, Properties> &ext_ref) {
+  int16_t exponent;
+  if (strm.decode(exponent, ext_ref.nullable())) {
+    int64_t mantissa;
+    strm.decode(mantissa, false);
+  }
+}
+
 } /* coder */
 
 } /* mfast */
@@ -202,8 +202,11 @@ public:
   void encode_impl(const T &cref, fast_ostream &stream,
                    encoder_presence_map &pmap) const {
 
-    value_storage previous = previous_value_of(cref);
-    stream.save_previous_value(cref);
+    // the previous value refers to the contents saved in the dictionary,
+    // which are overwritten by saving the new value; hence, it is only saved
+    // once the value is compared
+    value_storage previous = stream.previous_value_of(cref);
+    bool present = true;
 
     if (!previous.is_defined()) {
       // if the previous value is undefined – the value of the field is the
@@ -212,17 +215,12 @@ public:
       // If the field has optional presence and no initial value, the field is
       // considered
       // absent and the state of the previous value is changed to empty.
-      if (cref.is_initial_value()) {
-
-        pmap.set_next_bit(false);
-        return;
-      }
+      present = !cref.is_initial_value();
     } else if (previous.is_empty()) {
       // if the previous value is empty – the value of the field is empty.
       // If the field is optional the value is considered absent.
       if (cref.absent()) {
-        pmap.set_next_bit(false);
-        return;
+        present = false;
       } else if (!cref.optional()) {
         // It is a dynamic error [ERR D6] if the field is mandatory.
         BOOST_THROW_EXCEPTION(fast_dynamic_error("D6"));
@@ -232,12 +230,13 @@ public:
         // has optional presence.
       }
     } else if (Operation()(cref, previous)) {
-      pmap.set_next_bit(false);
-      return;
+      present = false;
     }
 
-    pmap.set_next_bit(true);
-    stream << cref;
+    stream.save_previous_value(cref);
+    pmap.set_next_bit(present);
+    if (present)
+      stream << cref;
   }
 };
 
@@ -436,7 +435,7 @@ class delta_operator : public encoder_field_operator,
       //  that case the value of the field is considered absent.
       stream.encode_null();
     } else {
-      value_storage bv = delta_base_value_of(cref);
+      value_storage bv = stream.delta_base_value_of(cref);
       T base(&bv, nullptr);
 
       int64_t delta = static_cast<int64_t>(cref.value() - base.value());
@@ -454,7 +453,7 @@ class delta_operator : public encoder_field_operator,
       return;
     }
 
-    const value_storage &prev = delta_base_value_of(cref);
+    const value_storage &prev = stream.delta_base_value_of(cref);
 
     T prev_cref(&prev, cref.instruction());
     typedef typename T::const_iterator const_iterator;
@@ -531,7 +530,7 @@ public:
     if (!cref.has_individual_operators()) {
 
       if (cref.present()) {
-        value_storage bv = delta_base_value_of(cref);
+        value_storage bv = stream.delta_base_value_of(cref);
 
         value_storage delta_storage;
         delta_storage.of_decimal.exponent_ =
@@ -580,7 +579,7 @@ private:
   void encode_impl(const T &cref, fast_ostream &stream,
                    encoder_presence_map &pmap) const {
 
-    value_storage &prev = previous_value_of(cref);
+    value_storage &prev = stream.previous_value_of(cref);
 
     // if (cref.absent()) {
     //   if (!prev.is_defined() || prev.is_empty()) {
@@ -592,7 +591,7 @@ private:
     //   }
     // }
     // else
-    if (is_same()(cref, tail_base_value_of(cref))) {
+    if (is_same()(cref, stream.tail_base_value_of(cref))) {
       pmap.set_next_bit(false);
     } else if (cref.absent()) {
       if (prev.is_defined() && prev.is_empty()) {
@@ -609,7 +608,7 @@ private:
 
       const_iterator tail_itr;
 
-      value_storage base = tail_base_value_of(cref);
+      value_storage base = stream.tail_base_value_of(cref);
       T base_cref(&base, cref.instruction());
 
       if (cref.size() == base_cref.size()) {
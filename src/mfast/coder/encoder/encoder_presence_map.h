@@ -32,21 +32,23 @@ private:
   std::size_t nbytes_;
   std::size_t value_, mask_;
   fast_ostream *stream_;
+  std::size_t start_;
   std::size_t offset_;
   std::size_t maxbytes_;
 };
 
 inline encoder_presence_map::encoder_presence_map()
-    : stream_(nullptr), offset_(0), maxbytes_(0) {
+    : stream_(nullptr), start_(0), offset_(0), maxbytes_(0) {
   reset();
 }
 
 inline void encoder_presence_map::init(fast_ostream *stream,
                                        std::size_t maxbits) {
   stream_ = stream;
-  offset_ = stream->offset();
+  start_ = offset_ = stream->offset();
   maxbytes_ = (maxbits + 6) / 7; // i.e. ceiling(maxbits/7)
-  stream_->buf_->skip(maxbytes_);
+  stream_->buf_->skip_unchecked(maxbytes_);
+  stream_->open_pmap();
 }
 
 inline void encoder_presence_map::reset() {
@@ -63,7 +65,8 @@ inline void encoder_presence_map::commit() {
 #endif
 
   value_ |= stop_bit_mask;
-  stream_->write_bytes_at(&value_, ++nbytes_, offset_, true);
+  stream_->commit_pmap(&value_, ++nbytes_, offset_, start_,
+                       offset_ + maxbytes_);
 }
 
 inline BOOST_CONSTEXPR std::size_t get_next_bit_mask(std::size_t i) {
@@ -86,7 +89,7 @@ inline void encoder_presence_map::set_next_bit(bool v) {
 
   if (mask_ == 0) {
     // we need to commit the current pmap before preceed
-    stream_->write_bytes_at(&value_, sizeof(std::size_t), offset_, false);
+    stream_->write_bytes_at(&value_, sizeof(std::size_t), offset_);
     offset_ += sizeof(std::size_t);
     maxbytes_ -= sizeof(std::size_t);
     reset();
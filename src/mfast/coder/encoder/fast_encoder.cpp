@@ -15,12 +15,17 @@
 #include "encoder_field_operator.h"
 #include "fast_ostream.h"
 #include "resizable_fast_ostreambuf.h"
+#include "size_bound.h"
+#include <cstring>
 
 namespace mfast {
 struct fast_encoder_impl;
 
 struct fast_encoder_impl : simple_template_repo_t {
   fast_ostream strm_;
+  size_bound_cache bounds_;
+  // holds the messages which may not fit in the buffers of the callers
+  std::vector<char> scratch_;
 
   int64_t active_message_id_;
   encoder_presence_map *current_;
@@ -63,6 +68,9 @@ struct fast_encoder_impl : simple_template_repo_t {
   void visit(nested_message_cref, int);
 
   void visit(message_cref cref, bool force_reset);
+
+  void encode(const message_cref &message, std::vector<char> &buffer,
+              bool force_reset, std::size_t bound);
 };
 
 inline fast_encoder_impl::fast_encoder_impl(allocator *alloc)
@@ -202,6 +210,16 @@ void fast_encoder_impl::visit(message_cref cref, bool force_reset) {
   pmap.commit();
 }
 
+void fast_encoder_impl::encode(const message_cref &message,
+                               std::vector<char> &buffer, bool force_reset,
+                               std::size_t bound) {
+  resizable_fast_ostreambuf sb(buffer);
+  sb.reserve(bound);
+  strm_.rdbuf(&sb);
+  visit(message, force_reset);
+  buffer.resize(sb.length());
+}
+
 fast_encoder::fast_encoder(allocator *alloc)
     : impl_(new fast_encoder_impl(alloc)) {}
 
@@ -210,6 +228,7 @@ fast_encoder::~fast_encoder() { delete impl_; }
 void fast_encoder::include(const templates_description *const *descriptions,
                            std::size_t description_count) {
   impl_->build(descriptions, description_count);
+  impl_->strm_.dictionary(impl_->dictionary());
   template_instruction **entry = impl_->unique_entry();
   if (entry != nullptr) {
     impl_->active_message_id_ = (*entry)->id();
@@ -220,6 +239,19 @@ std::size_t fast_encoder::encode(const message_cref &message, char *buffer,
                                  std::size_t buffer_size, bool force_reset) {
   assert(buffer_size > 0);
 
+  std::size_t bound = impl_->bounds_.bound(message);
+  if (bound > buffer_size) {
+    // the message is written unchecked, which the buffer may not have room
+    // for even if the message fits
+    std::vector<char> &scratch = impl_->scratch_;
+    scratch.clear();
+    impl_->encode(message, scratch, force_reset, bound);
+    if (scratch.size() > buffer_size)
+      throw buffer_overflow_error();
+    std::memcpy(buffer, scratch.data(), scratch.size());
+    return scratch.size();
+  }
+
   fast_ostreambuf sb(buffer, buffer_size);
   impl_->strm_.rdbuf(&sb);
   impl_->visit(message, force_reset);
@@ -228,17 +260,40 @@ std::size_t fast_encoder::encode(const message_cref &message, char *buffer,
 
 void fast_encoder::encode(const message_cref &message,
                           std::vector<char> &buffer, bool force_reset) {
-  resizable_fast_ostreambuf sb(buffer);
+  impl_->encode(message, buffer, force_reset, impl_->bounds_.bound(message));
+}
+
+void fast_encoder::encode(const message_cref &message,
+                          fast_chunked_buffer &buffer, bool force_reset) {
+  std::size_t bound = impl_->bounds_.bound(message);
+  fast_ostreambuf sb(buffer.prepare(bound), bound);
   impl_->strm_.rdbuf(&sb);
   impl_->visit(message, force_reset);
-  buffer.resize(sb.length());
+  buffer.commit(sb.length());
+}
+
+std::size_t fast_encoder::encoded_size_bound(const message_cref &message) {
+  return impl_->bounds_.bound(message);
 }
 
 const template_instruction *fast_encoder::template_with_id(uint32_t id) {
   return impl_->get_template(id);
 }
 
+void fast_encoder::resend_template_id() {
+  template_instruction **entry = impl_->unique_entry();
+  impl_->active_message_id_ = entry ? (*entry)->id() : -1;
+}
+
 void fast_encoder::allow_overlong_pmap(bool v) {
   impl_->strm_.allow_overlong_pmap(v);
 }
+
+void fast_encoder::save_dictionary(std::vector<char> &blob) const {
+  impl_->save_dictionary(blob, impl_->active_message_id_);
+}
+
+void fast_encoder::restore_dictionary(const char *data, std::size_t size) {
+  impl_->active_message_id_ = impl_->restore_dictionary(data, size);
+}
 }
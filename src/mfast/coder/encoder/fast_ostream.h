@@ -8,9 +8,16 @@
 #include "mfast/field_instructions.h"
 #include "../common/codec_helper.h"
 #include "fast_ostreambuf.h"
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace mfast {
 class encoder_presence_map;
+
+/// Writes the encodings of the fields unchecked; the room for them must be
+/// reserved in the buffer beforehand, see fast_ostreambuf::reserve().
 class fast_ostream : private detail::codec_helper {
 public:
   fast_ostream(allocator *alloc);
@@ -40,25 +47,44 @@ public:
 
   template <typename T> void save_previous_value(const T &cref) const;
 
+  using detail::codec_helper::dictionary;
+  using detail::codec_helper::previous_value_of;
+  using detail::codec_helper::delta_base_value_of;
+  using detail::codec_helper::tail_base_value_of;
+
   void allow_overlong_pmap(bool v);
 
 private:
   friend class encoder_presence_map;
 
+  void open_pmap();
   void write_bytes_at(std::size_t *bytes, std::size_t nbytes,
-                      std::size_t offset, bool pmap_end);
+                      std::size_t offset);
+  // write the last bytes of the presence map reserved in [first, last)
+  void commit_pmap(std::size_t *bytes, std::size_t nbytes, std::size_t offset,
+                   std::size_t first, std::size_t last);
 
   std::size_t offset() const { return rdbuf()->length(); }
   fast_ostreambuf *buf_;
   allocator *alloc_;
   bool allow_overlong_pmap_;
+  // the presence maps which are not committed yet
+  std::size_t open_pmaps_;
+  // the bytes left unused by the shortened presence maps, which are only
+  // removed once the outermost presence map is committed; removing them for
+  // every presence map would move the bytes of a segment once for each level
+  // of nesting
+  std::vector<std::pair<std::size_t, std::size_t>> pmap_gaps_;
 };
 
 inline fast_ostream::fast_ostream(allocator *alloc)
-    : alloc_(alloc), allow_overlong_pmap_(true) {}
+    : alloc_(alloc), allow_overlong_pmap_(true), open_pmaps_(0) {}
 inline fast_ostreambuf *fast_ostream::rdbuf() const { return buf_; }
 inline fast_ostreambuf *fast_ostream::rdbuf(fast_ostreambuf *sb) {
   buf_ = sb;
+  // discard the presence maps of a message which failed to encode
+  open_pmaps_ = 0;
+  pmap_gaps_.clear();
   return buf_;
 }
 
@@ -76,7 +102,7 @@ inline enable_if_t<std::is_unsigned<T>::value, bool> is_positive(T) {
 // use non-const reference to avoid ambiguious overloading problem
 inline bool encode_max_value(uint64_t &value, fast_ostreambuf *buf) {
   if (value == (std::numeric_limits<uint64_t>::max)()) {
-    buf->sputn("\x02\x00\x00\x00\x00\x00\x00\x00\x00\x80", 10);
+    buf->sputn_unchecked("\x02\x00\x00\x00\x00\x00\x00\x00\x00\x80", 10);
     return true;
   }
   return false;
@@ -84,86 +110,65 @@ inline bool encode_max_value(uint64_t &value, fast_ostreambuf *buf) {
 
 inline bool encode_max_value(int64_t &value, fast_ostreambuf *buf) {
   if (value == (std::numeric_limits<int64_t>::max)()) {
-    buf->sputn("\x01\x00\x00\x00\x00\x00\x00\x00\x00\x80", 10);
+    buf->sputn_unchecked("\x01\x00\x00\x00\x00\x00\x00\x00\x00\x80", 10);
     return true;
   }
   return false;
 }
 
-inline bool encode_max_value(uint32_t &value, fast_ostreambuf *buf) {
-  if (value == (std::numeric_limits<uint32_t>::max)()) {
-    buf->sputn("\x10\x00\x00\x00\x80", 5);
-    return true;
-  }
-  return false;
+// The number of bytes of the stop bit encoding of an integer, indexed by the
+// number of leading zeros of its significant bits.
+inline unsigned stop_bit_encoded_length(unsigned leading_zeros) {
+  static const unsigned char lengths[64] = {
+      10, 9, 9, 9, 9, 9, 9, 9, 8, 8, 8, 8, 8, 8, 8, 7, 7, 7, 7, 7, 7, 7,
+      6,  6, 6, 6, 6, 6, 6, 5, 5, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 3,
+      3,  3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1};
+  return lengths[leading_zeros];
 }
 
-inline bool encode_max_value(int32_t &value, fast_ostreambuf *buf) {
-  if (value == (std::numeric_limits<int32_t>::max)()) {
-    buf->sputn("\x08\x00\x00\x00\x80", 5);
-    return true;
-  }
-  return false;
+inline unsigned stop_bit_encoded_length(uint64_t value) {
+  return stop_bit_encoded_length(count_leading_zeros(value | 1));
 }
 
-inline bool encode_max_value(int16_t &, fast_ostreambuf *) { return false; }
+inline unsigned stop_bit_encoded_length(int64_t value) {
+  // the sign bit is significant too; the complement of a negative value has
+  // the same significant bits with a zero sign
+  uint64_t magnitude = static_cast<uint64_t>(value < 0 ? ~value : value);
+  return stop_bit_encoded_length(count_leading_zeros((magnitude << 1) | 1));
+}
 }
 
 template <typename IntType, typename Nullable>
-void fast_ostream::encode(IntType value, bool is_null, Nullable nullable) {
+void fast_ostream::encode(IntType t, bool is_null, Nullable nullable) {
+  // the narrower integers are encoded as 64-bit ones, which makes room for
+  // incrementing their maximum values
+  typedef typename std::conditional<std::is_signed<IntType>::value, int64_t,
+                                    uint64_t>::type wide_type;
+  wide_type value = t;
   if (nullable) {
     if (is_null) {
-      rdbuf()->sputc('\x80');
+      rdbuf()->sputc_unchecked('\x80');
       return;
     } else if (detail::encode_max_value(value, rdbuf())) {
       return;
     } else if (detail::is_positive(value)) {
       ++value;
     }
-  } else if (value == 0) {
-    rdbuf()->sputc('\x80');
-    return;
   }
 
-  bool positive = detail::is_positive(value);
-  // padding_mask is used to pad highest 7 bits to 1 when t is negative after t
-  // is shift by 7
-  // this ensure that t has no significat bits at the highest 7 bits after
-  // shifting
-  const IntType padding_mask =
-      (static_cast<IntType>(value > 0 ? 0 : 0xFE) << (sizeof(IntType) - 1) * 8);
-  const IntType no_significant_bits = (value > 0 ? 0 : -1);
-
-  const unsigned max_encoded_length = sizeof(IntType) * 8 / 7 + 1;
-  char buffer[max_encoded_length + 1] = {'\0'};
-  int i = max_encoded_length - 1;
-
-  for (; i >= 0 && value != no_significant_bits; --i) {
-    buffer[i] = value & static_cast<IntType>(0x7F);
-    value = (value >> 7) | padding_mask;
+  // the two's complement bits of a negative value are its encoding
+  uint64_t bits = static_cast<uint64_t>(value);
+  unsigned len = detail::stop_bit_encoded_length(value);
+  if (len > 8) {
+    // only the 64-bit integers have more groups than a word holds; the
+    // leading group of a negative value is sign extended
+    for (unsigned i = len; i-- > 8;)
+      rdbuf()->sputc_unchecked(static_cast<char>((value >> (7 * i)) & 0x7F));
+    len = 8;
   }
-
-  ++i;
-
-  if (std::is_signed<IntType>::value) {
-    if (positive) {
-      // check if the sign bit is on
-      if (buffer[i] & 0x40) {
-        // signed bit is on and this is positive integer, we need to pad an
-        // extra byte \x00
-        // in the front
-        buffer[--i] = '\x00';
-      }
-    } else if ((buffer[i] & 0x40) == 0) {
-      // this is negative integer and yet the sign bit is off, we need to pad an
-      // extra byte
-      // \x7F in the front
-      buffer[--i] = '\x7F';
-    }
-  }
-
-  buffer[max_encoded_length - 1] |= 0x80; // stop bit
-  rdbuf()->sputn(buffer + i, max_encoded_length - i);
+  uint64_t word = detail::spread_stop_bit_groups(bits, len) |
+                  (UINT64_C(0x80) << (8 * (len - 1)));
+  rdbuf()->sputw_unchecked(word, len);
 }
 
 template <typename Nullable>
@@ -174,32 +179,32 @@ fast_ostream::encode(const char *ascii, uint32_t len,
   assert(ascii || nullable);
 
   if (nullable && ascii == nullptr) {
-    rdbuf()->sputc('\x80');
+    rdbuf()->sputc_unchecked('\x80');
     return;
   }
 
   if (len == 0) {
     if (nullable) {
-      rdbuf()->sputc('\x00');
+      rdbuf()->sputc_unchecked('\x00');
     }
-    rdbuf()->sputc('\x80');
+    rdbuf()->sputc_unchecked('\x80');
     return;
   }
 
   if (len == 1 && ascii[0] == '\x00') {
     if (nullable) {
-      rdbuf()->sputn("\x00\x00\x80", 3);
+      rdbuf()->sputn_unchecked("\x00\x00\x80", 3);
     } else {
-      rdbuf()->sputn("\x00\x80", 2);
+      rdbuf()->sputn_unchecked("\x00\x80", 2);
     }
     return;
   }
 
-  rdbuf()->sputn(ascii, len - 1);
+  rdbuf()->sputn_unchecked(ascii, len - 1);
 #ifdef _MSC_VER
 #pragma warning(suppress : 6011)
 #endif
-  rdbuf()->sputc(ascii[len - 1] | 0x80);
+  rdbuf()->sputc_unchecked(ascii[len - 1] | 0x80);
 }
 
 template <typename Nullable>
@@ -212,7 +217,7 @@ fast_ostream::encode(const char *unicode, uint32_t len,
 
   encode(len, unicode == nullptr, nullable);
   if (unicode && len > 0) {
-    rdbuf()->sputn(unicode, len);
+    rdbuf()->sputn_unchecked(unicode, len);
   }
 }
 
@@ -226,7 +231,7 @@ fast_ostream::encode(const unsigned char *bv, uint32_t len,
 
   encode(len, bv == nullptr, nullable);
   if (bv && len > 0) {
-    rdbuf()->sputn(reinterpret_cast<const char *>(bv), len);
+    rdbuf()->sputn_unchecked(reinterpret_cast<const char *>(bv), len);
   }
 }
 
@@ -238,13 +243,35 @@ inline void fast_ostream::save_previous_value(const T &cref) const {
   s.defined(true);
 }
 
+inline void fast_ostream::open_pmap() { ++open_pmaps_; }
+
 inline void fast_ostream::write_bytes_at(std::size_t *bytes, std::size_t nbytes,
-                                         std::size_t offset, bool pmap_end) {
+                                         std::size_t offset) {
   rdbuf()->write_bytes_at(reinterpret_cast<const char *>(bytes), nbytes, offset,
-                          pmap_end && !allow_overlong_pmap_);
+                          false);
+}
+
+inline void fast_ostream::commit_pmap(std::size_t *bytes, std::size_t nbytes,
+                                      std::size_t offset, std::size_t first,
+                                      std::size_t last) {
+  write_bytes_at(bytes, nbytes, offset);
+  if (!allow_overlong_pmap_) {
+    std::size_t end = rdbuf()->shorten_pmap(first, offset + nbytes);
+    if (end < last)
+      pmap_gaps_.push_back(std::make_pair(end, last - end));
+  }
+
+  if (--open_pmaps_ == 0 && !pmap_gaps_.empty()) {
+    // the nested presence maps are committed before the enclosing ones
+    std::sort(pmap_gaps_.begin(), pmap_gaps_.end());
+    rdbuf()->erase(pmap_gaps_.data(), pmap_gaps_.size());
+    pmap_gaps_.clear();
+  }
 }
 
-inline void fast_ostream::encode_null() { rdbuf()->sputc('\x80'); }
+inline void fast_ostream::encode_null() {
+  rdbuf()->sputc_unchecked('\x80');
+}
 inline void fast_ostream::allow_overlong_pmap(bool v) {
   allow_overlong_pmap_ = v;
 }
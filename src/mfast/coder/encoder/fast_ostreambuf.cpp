@@ -37,4 +37,33 @@ void fast_ostreambuf::write_bytes_at(const char *data, std::size_t n,
     }
   }
 }
+
+std::size_t fast_ostreambuf::shorten_pmap(std::size_t first,
+                                          std::size_t last) {
+  char *begin = pbase_ + first;
+  char *p = pbase_ + last - 1;
+  if (p == begin || *p != '\x80')
+    return last;
+
+  do {
+    --p;
+  } while (p > begin && *p == 0);
+  *p |= '\x80';
+  return p + 1 - pbase_;
+}
+
+void fast_ostreambuf::erase(const std::pair<std::size_t, std::size_t> *ranges,
+                            std::size_t count) {
+  if (count == 0)
+    return;
+
+  char *dest = pbase_ + ranges[0].first;
+  for (std::size_t i = 0; i < count; ++i) {
+    const char *src = pbase_ + ranges[i].first + ranges[i].second;
+    const char *next = i + 1 < count ? pbase_ + ranges[i + 1].first : pptr_;
+    std::memmove(dest, src, next - src);
+    dest += next - src;
+  }
+  pptr_ = dest;
+}
 }
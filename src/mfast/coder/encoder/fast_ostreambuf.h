@@ -5,8 +5,12 @@
 // See the file license.txt for licensing information.
 #pragma once
 
+#include <cassert>
+#include <cstring>
 #include <stdexcept>
+#include <utility>
 #include "mfast/coder/mfast_coder_export.h"
+#include "../common/stop_bit.h"
 #include "mfast/exceptions.h"
 
 namespace mfast {
@@ -26,10 +30,33 @@ public:
   void sputn(const char *data, std::size_t n);
   void skip(std::size_t n);
 
+  /// Make room for @a n more bytes, which may then be written by the
+  /// unchecked functions below.
+  void reserve(std::size_t n);
+  void sputc_unchecked(char c);
+  void sputn_unchecked(const char *data, std::size_t n);
+  void skip_unchecked(std::size_t n);
+  /// Write the first @a n bytes of @a word as stored by store_uint64_le();
+  /// the whole word is stored at once when the buffer has room for it.
+  void sputw_unchecked(uint64_t word, std::size_t n);
+
   virtual std::size_t length() const;
   virtual void write_bytes_at(const char *data, std::size_t n,
                               std::size_t offset, bool shrink);
 
+  /// Drop the trailing zero bytes of the presence map written in
+  /// [first, last), moving its stop bit to its last non-zero byte.
+  ///
+  /// @returns The end of the shortened presence map; the bytes after it up
+  ///          to @a last are left in place, to be removed by erase().
+  std::size_t shorten_pmap(std::size_t first, std::size_t last);
+
+  /// Remove the ranges of bytes given by their offsets and sizes, in
+  /// ascending order and without overlaps, so that every byte after them is
+  /// moved only once.
+  void erase(const std::pair<std::size_t, std::size_t> *ranges,
+             std::size_t count);
+
   const char *pbase() const { return pbase_; }
 
 protected:
@@ -67,6 +94,40 @@ inline void fast_ostreambuf::skip(std::size_t n) {
   pptr_ += n;
 }
 
+inline void fast_ostreambuf::reserve(std::size_t n) {
+  while (static_cast<std::size_t>(epptr_ - pptr_) < n)
+    overflow(n);
+}
+
+inline void fast_ostreambuf::sputc_unchecked(char c) {
+  assert(pptr_ < epptr_);
+  *pptr_++ = c;
+}
+
+inline void fast_ostreambuf::sputn_unchecked(const char *data, std::size_t n) {
+  assert(static_cast<std::size_t>(epptr_ - pptr_) >= n);
+  std::memcpy(pptr_, data, n);
+  pptr_ += n;
+}
+
+inline void fast_ostreambuf::skip_unchecked(std::size_t n) {
+  assert(static_cast<std::size_t>(epptr_ - pptr_) >= n);
+  pptr_ += n;
+}
+
+inline void fast_ostreambuf::sputw_unchecked(uint64_t word, std::size_t n) {
+  assert(n <= sizeof(word) && static_cast<std::size_t>(epptr_ - pptr_) >= n);
+  if (static_cast<std::size_t>(epptr_ - pptr_) >= sizeof(word)) {
+    // the bytes after the first n are overwritten later
+    detail::store_uint64_le(pptr_, word);
+  } else {
+    char bytes[sizeof(word)];
+    detail::store_uint64_le(bytes, word);
+    std::memcpy(pptr_, bytes, n);
+  }
+  pptr_ += n;
+}
+
 inline void fast_ostreambuf::setp(char *pbase, char *pptr, char *epptr) {
   pbase_ = pbase;
   pptr_ = pptr;
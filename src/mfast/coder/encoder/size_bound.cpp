@@ -0,0 +1,163 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#include "size_bound.h"
+#include "mfast/group_ref.h"
+#include "mfast/nested_message_ref.h"
+#include "mfast/sequence_ref.h"
+#include "mfast/string_ref.h"
+#include "mfast/vector_ref.h"
+#include <algorithm>
+
+namespace mfast {
+
+namespace {
+// The longest stop bit encodings of 32-bit and 64-bit integers, including a
+// sign byte or the nullable representation of the largest value. The deltas
+// of all integers are encoded as 64-bit integers.
+const std::size_t int32_max_size = 5;
+const std::size_t int64_max_size = 10;
+// The length and the subtraction length which a string or a byte vector
+// may carry along with its contents, or the stop bit and the null bytes of an
+// ascii string.
+const std::size_t vector_overhead = 2 * int32_max_size;
+
+std::size_t pmap_max_size(std::size_t bits) { return (bits + 6) / 7; }
+
+// the bound of the fields with a maximum size; 0 for the others
+std::size_t field_max_size(const field_instruction *inst) {
+  switch (inst->field_type()) {
+  case field_type_int32:
+  case field_type_uint32:
+    return inst->field_operator() == operator_delta ? int64_max_size
+                                                    : int32_max_size;
+  case field_type_int64:
+  case field_type_uint64:
+  case field_type_enum:
+    return int64_max_size;
+  case field_type_decimal:
+  case field_type_exponent:
+    // the exponent and the mantissa, or their deltas
+    return 2 * int64_max_size;
+  case field_type_ascii_string:
+  case field_type_unicode_string:
+  case field_type_byte_vector:
+    return vector_overhead;
+  case field_type_int32_vector:
+  case field_type_uint32_vector:
+  case field_type_int64_vector:
+  case field_type_uint64_vector:
+    return int32_max_size;
+  case field_type_sequence:
+    return int64_max_size;
+  default:
+    return 0;
+  }
+}
+}
+
+const size_bound *size_bound_cache::get(const group_field_instruction *inst) {
+  bounds_t::iterator it = bounds_.find(inst);
+  if (it != bounds_.end())
+    return it->second;
+  const size_bound *fields_bound = compile(inst);
+  bounds_[inst] = fields_bound;
+  return fields_bound;
+}
+
+std::size_t size_bound_cache::bound(const message_cref &message) {
+  const size_bound *fields_bound = get(message.instruction());
+  if (fields_bound->is_fixed())
+    return fields_bound->fixed();
+  return bound(*fields_bound, message);
+}
+
+std::size_t size_bound_cache::bound(const size_bound &fields_bound,
+                                    const aggregate_cref &fields) {
+  std::size_t size = fields_bound.fixed();
+  for (const size_bound::variable_field &variable : fields_bound.variable_) {
+    field_cref field = fields[variable.index];
+    if (field.absent())
+      continue;
+
+    switch (variable.field_type) {
+    case field_type_ascii_string:
+      size += ascii_string_cref(field).size();
+      break;
+    case field_type_unicode_string:
+      size += unicode_string_cref(field).size();
+      break;
+    case field_type_byte_vector:
+      size += byte_vector_cref(field).size();
+      break;
+    case field_type_int32_vector:
+    case field_type_uint32_vector:
+      size += int32_vector_cref(field).size() * int32_max_size;
+      break;
+    case field_type_int64_vector:
+    case field_type_uint64_vector:
+      size += int64_vector_cref(field).size() * int64_max_size;
+      break;
+    case field_type_group:
+      size += bound(*variable.nested, group_cref(field));
+      break;
+    case field_type_sequence:
+      for (auto &&element : sequence_cref(field))
+        size += bound(*variable.nested, element);
+      break;
+    case field_type_templateref:
+      size += bound(nested_message_cref(field).target());
+      break;
+    default:
+      break;
+    }
+  }
+  return size;
+}
+
+const size_bound *
+size_bound_cache::compile(const group_field_instruction *inst) {
+  storage_.emplace_back(new size_bound);
+  size_bound *fields_bound = storage_.back().get();
+
+  if (inst->field_type() == field_type_template) {
+    // a message has a presence map for its template id bit
+    fields_bound->fixed_ =
+        int32_max_size +
+        pmap_max_size(std::max<std::size_t>(inst->segment_pmap_size(), 1));
+  } else {
+    fields_bound->fixed_ = pmap_max_size(inst->segment_pmap_size());
+  }
+
+  for (std::size_t i = 0; i < inst->subinstructions().size(); ++i) {
+    const field_instruction *subinst = inst->subinstruction(i);
+    field_type_enum_t field_type = subinst->field_type();
+    fields_bound->fixed_ += field_max_size(subinst);
+
+    const size_bound *nested = nullptr;
+    switch (field_type) {
+    case field_type_int32:
+    case field_type_uint32:
+    case field_type_int64:
+    case field_type_uint64:
+    case field_type_enum:
+    case field_type_decimal:
+    case field_type_exponent:
+      continue;
+    case field_type_group:
+    case field_type_sequence:
+      nested = get(static_cast<const group_field_instruction *>(subinst));
+      break;
+    default:
+      break;
+    }
+
+    size_bound::variable_field variable = {static_cast<uint32_t>(i),
+                                           field_type, nested};
+    fields_bound->variable_.push_back(variable);
+  }
+  return fields_bound;
+}
+}
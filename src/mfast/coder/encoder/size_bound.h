@@ -0,0 +1,70 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "mfast/coder/mfast_coder_export.h"
+#include "mfast/instructions/group_instruction.h"
+#include "mfast/message_ref.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace mfast {
+/// The worst-case size of the encoding of a template, group or sequence
+/// element.
+///
+/// The encodings of integers, decimals and enums have a maximum size, which
+/// is summed up along with the presence map when the bound is compiled. Only
+/// the fields whose encodings grow with their values, i.e. strings, byte
+/// vectors, integer vectors, groups, sequences and nested templates, are
+/// visited for each message.
+class size_bound {
+public:
+  /// The bound of the fields with a maximum size and of the presence map.
+  std::size_t fixed() const { return fixed_; }
+
+  /// Whether every message has the bound fixed().
+  bool is_fixed() const { return variable_.empty(); }
+
+private:
+  friend class size_bound_cache;
+
+  struct variable_field {
+    uint32_t index;
+    field_type_enum_t field_type;
+    /// The bound of a group or a sequence element; nullptr for other fields.
+    const size_bound *nested;
+  };
+
+  std::size_t fixed_;
+  std::vector<variable_field> variable_;
+};
+
+/// Compiles and owns the size bounds of an encoder, which reserves the bound
+/// of each message in its buffer so that the message is written unchecked.
+class MFAST_CODER_EXPORT size_bound_cache {
+public:
+  /// Returns the bound of @a inst, which is compiled along with the bounds of
+  /// its groups and sequences unless it has been compiled before.
+  const size_bound *get(const group_field_instruction *inst);
+
+  /// Returns an upper bound of the size of @a message encoded as a segment
+  /// with its template id.
+  std::size_t bound(const message_cref &message);
+
+private:
+  std::size_t bound(const size_bound &fields_bound,
+                    const aggregate_cref &fields);
+  const size_bound *compile(const group_field_instruction *inst);
+
+  typedef std::unordered_map<const group_field_instruction *,
+                             const size_bound *>
+      bounds_t;
+  bounds_t bounds_;
+  std::vector<std::unique_ptr<size_bound>> storage_;
+};
+}
@@ -9,8 +9,10 @@
 #include "../encoder/fast_ostream.h"
 #include "../encoder/resizable_fast_ostreambuf.h"
 #include "../encoder/encoder_presence_map.h"
+#include "../encoder/size_bound.h"
 #include "mfast/ext_ref.h"
 #include "fast_ostream_inserter.h"
+#include <cstring>
 #include <tuple>
 
 namespace mfast {
@@ -53,6 +55,8 @@ struct MFAST_CODER_EXPORT fast_encoder_core : mfast::detail::codec_helper {
                                        "templates_description*");
     repo_.build(rest...);
     active_message_info_ = repo_.unique_entry();
+    this->dictionary(repo_.dictionary());
+    strm_.dictionary(repo_.dictionary());
   }
 
   /// message encode functions
@@ -66,6 +70,23 @@ struct MFAST_CODER_EXPORT fast_encoder_core : mfast::detail::codec_helper {
   void encode_i(const message_cref &message, std::vector<char> &buffer,
                 bool force_reset);
 
+  void encode_i(const message_cref &message, std::vector<char> &buffer,
+                bool force_reset, std::size_t bound);
+
+  void save_dictionary_i(std::vector<char> &blob) const {
+    int64_t template_id = -1;
+    if (active_message_info_)
+      template_id = std::get<0>(*active_message_info_)->id();
+    repo_.save_dictionary(blob, template_id);
+  }
+
+  void restore_dictionary_i(const char *data, std::size_t size) {
+    int64_t template_id = repo_.restore_dictionary(data, size);
+    active_message_info_ =
+        template_id < 0 ? nullptr
+                        : repo_.find(static_cast<uint32_t>(template_id));
+  }
+
   /// vistation functions for mFAST data structures
   template <typename T> void visit(const T &ext_ref);
   void visit(const nested_message_cref &cref);
@@ -133,6 +154,9 @@ struct MFAST_CODER_EXPORT fast_encoder_core : mfast::detail::codec_helper {
 
   template_repo<info_entry_converter> repo_;
   fast_ostream strm_;
+  size_bound_cache bounds_;
+  // holds the messages which may not fit in the buffers of the callers
+  std::vector<char> scratch_;
   info_entry *active_message_info_;
   encoder_presence_map *current_;
 };
@@ -177,6 +201,17 @@ inline std::size_t fast_encoder_core::encode_i(const message_cref &message,
                                                bool force_reset) {
   assert(buffer_size > 0);
 
+  std::size_t bound = bounds_.bound(message);
+  if (bound > buffer_size) {
+    // see fast_encoder::encode()
+    scratch_.clear();
+    this->encode_i(message, scratch_, force_reset, bound);
+    if (scratch_.size() > buffer_size)
+      throw buffer_overflow_error();
+    std::memcpy(buffer, scratch_.data(), scratch_.size());
+    return scratch_.size();
+  }
+
   fast_ostreambuf sb(buffer, buffer_size);
   this->strm_.rdbuf(&sb);
   this->encode_segment(message, force_reset);
@@ -186,7 +221,14 @@ inline std::size_t fast_encoder_core::encode_i(const message_cref &message,
 inline void fast_encoder_core::encode_i(const message_cref &message,
                                         std::vector<char> &buffer,
                                         bool force_reset) {
+  this->encode_i(message, buffer, force_reset, bounds_.bound(message));
+}
+
+inline void fast_encoder_core::encode_i(const message_cref &message,
+                                        std::vector<char> &buffer,
+                                        bool force_reset, std::size_t bound) {
   resizable_fast_ostreambuf sb(buffer);
+  sb.reserve(bound);
   this->strm_.rdbuf(&sb);
   this->encode_segment(message, force_reset);
   buffer.resize(sb.length());
@@ -312,8 +354,9 @@ void fast_encoder_core::encode_field(const T &ext_ref, copy_operator_tag,
   encoder_presence_map &pmap = *current_;
   typename T::cref_type cref = ext_ref.get();
 
+  // saving cref would overwrite the string the previous value points to
   value_storage previous = previous_value_of(cref);
-  strm_.save_previous_value(cref);
+  bool present = true;
 
   if (!previous.is_defined()) {
     // if the previous value is undefined – the value of the field is the
@@ -322,16 +365,12 @@ void fast_encoder_core::encode_field(const T &ext_ref, copy_operator_tag,
     // If the field has optional presence and no initial value, the field is
     // considered
     // absent and the state of the previous value is changed to empty.
-    if (cref.is_initial_value()) {
-      pmap.set_next_bit(false);
-      return;
-    }
+    present = !cref.is_initial_value();
   } else if (previous.is_empty()) {
     // if the previous value is empty – the value of the field is empty.
     // If the field is optional the value is considered absent.
     if (!ext_ref.present()) {
-      pmap.set_next_bit(false);
-      return;
+      present = false;
     } else if (!ext_ref.optional()) {
       // It is a dynamic error [ERR D6] if the field is mandatory.
       BOOST_THROW_EXCEPTION(fast_dynamic_error("D6"));
@@ -341,12 +380,13 @@ void fast_encoder_core::encode_field(const T &ext_ref, copy_operator_tag,
       // has optional presence.
     }
   } else if (equivalent(cref, previous)) {
-    pmap.set_next_bit(false);
-    return;
+    present = false;
   }
 
-  pmap.set_next_bit(true);
-  strm_ << ext_ref;
+  strm_.save_previous_value(cref);
+  pmap.set_next_bit(present);
+  if (present)
+    strm_ << ext_ref;
 }
 
 template <typename T, typename TypeCategory>
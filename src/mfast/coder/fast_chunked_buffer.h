@@ -0,0 +1,133 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+namespace mfast {
+/// The layout of struct iovec, which Windows does not have.
+struct fast_iovec {
+  void *iov_base;
+  std::size_t iov_len;
+};
+}
+#else
+#include <sys/uio.h>
+namespace mfast {
+typedef ::iovec fast_iovec;
+}
+#endif
+
+namespace mfast {
+
+/// An output buffer of the encoders made of a chain of chunks, whose
+/// contents are exposed as fast_iovec entries, e.g. to be passed to writev()
+/// or sendmmsg() without being copied.
+///
+/// Each message is written to a single chunk, in which the encoder reserves
+/// the worst-case size of the message; see fast_encoder::encoded_size_bound().
+/// A message which does not fit in the rest of the current chunk starts a new
+/// one, so the chunk boundaries are always message boundaries, and a message
+/// whose bound exceeds the chunk size gets a chunk of its own. The chunks are
+/// neither initialized nor ever reallocated, hence the messages are never
+/// copied; clear() keeps the chunks of the chunk size for reuse.
+class fast_chunked_buffer {
+public:
+  /// @param chunk_size The size of the chunks, which should be a multiple of
+  ///                   the bound of the common messages.
+  explicit fast_chunked_buffer(std::size_t chunk_size = 64 * 1024)
+      : chunk_size_(chunk_size), entry_per_message_(false), used_(0),
+        size_(0) {}
+
+  fast_chunked_buffer(const fast_chunked_buffer &) = delete;
+  fast_chunked_buffer &operator=(const fast_chunked_buffer &) = delete;
+
+  /// Let every message have an entry of its own, e.g. to send each one as a
+  /// datagram with sendmmsg(); otherwise, the messages of a chunk share an
+  /// entry.
+  void entry_per_message(bool enabled) { entry_per_message_ = enabled; }
+
+  /// The contents in the order they were encoded.
+  const fast_iovec *iovecs() const { return iovecs_.data(); }
+  std::size_t iovec_count() const { return iovecs_.size(); }
+
+  /// The number of bytes of the contents.
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  /// Discard the contents, keeping the chunks of the chunk size for reuse.
+  void clear() {
+    for (auto &c : chunks_) {
+      if (c.capacity == chunk_size_)
+        free_.push_back(std::move(c));
+    }
+    chunks_.clear();
+    iovecs_.clear();
+    used_ = 0;
+    size_ = 0;
+  }
+
+  /// Returns the room for @a n bytes after the contents, which are appended
+  /// by commit(); invoked by the encoders.
+  char *prepare(std::size_t n) {
+    if (!chunks_.empty() && chunks_.back().capacity - used_ >= n)
+      return chunks_.back().data.get() + used_;
+
+    chunk c;
+    if (n <= chunk_size_ && !free_.empty()) {
+      c = std::move(free_.back());
+      free_.pop_back();
+    } else {
+      c.capacity = std::max(n, chunk_size_);
+      c.data.reset(new char[c.capacity]);
+    }
+    chunks_.push_back(std::move(c));
+    used_ = 0;
+    return chunks_.back().data.get();
+  }
+
+  /// Append the first @a n bytes of the room returned by prepare().
+  void commit(std::size_t n) {
+    assert(!chunks_.empty() && used_ + n <= chunks_.back().capacity);
+    if (n == 0)
+      return;
+
+    char *data = chunks_.back().data.get() + used_;
+    if (used_ > 0 && !entry_per_message_) {
+      iovecs_.back().iov_len += n;
+    } else {
+      fast_iovec entry;
+      entry.iov_base = data;
+      entry.iov_len = n;
+      iovecs_.push_back(entry);
+    }
+    used_ += n;
+    size_ += n;
+  }
+
+private:
+  struct chunk {
+    std::unique_ptr<char[]> data;
+    std::size_t capacity;
+  };
+
+  std::size_t chunk_size_;
+  bool entry_per_message_;
+  // the last one is being filled
+  std::vector<chunk> chunks_;
+  std::vector<chunk> free_;
+  // the number of bytes used in the last chunk
+  std::size_t used_;
+  std::size_t size_;
+  std::vector<fast_iovec> iovecs_;
+};
+}
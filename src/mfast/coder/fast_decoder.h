@@ -8,10 +8,17 @@
 #include "mfast_coder_export.h"
 #include "mfast/message_ref.h"
 #include "mfast/malloc_allocator.h"
+#include "common/exceptions.h"
+#include "common/stop_bit.h"
+#include <functional>
 #include <initializer_list>
+#include <memory>
+#include <vector>
 
 namespace mfast {
 struct fast_decoder_impl;
+class dictionary_journal;
+class template_set;
 
 ///
 class MFAST_CODER_EXPORT fast_decoder {
@@ -50,6 +57,54 @@ public:
     include(descriptions.begin(), descriptions.size());
   }
 
+  /// Use the template instructions of @a templates instead of building
+  /// instructions of its own.
+  ///
+  /// The instructions are immutable once built, so a set can be shared by
+  /// any number of decoders, e.g. one per channel of a feed, each of which
+  /// keeps the dictionary values in a block of its own. The set is kept alive
+  /// as long as the decoder. Like the other overloads, this member function
+  /// should only be invoked once.
+  void include(std::shared_ptr<const template_set> templates);
+
+  /// Restrict the fields stored in the messages of a template.
+  ///
+  /// The fields outside the projection are still consumed from the stream and
+  /// the fields whose operators use the dictionary are still decoded, so that
+  /// the subsequent messages are decoded correctly. The other fields are
+  /// neither stored nor copied and the sequences outside the projection are
+  /// left empty; the values of such fields in the decoded messages are
+  /// unspecified.
+  ///
+  /// The projection replaces the one set before for the template. It only
+  /// applies to the messages of the template; the template is decoded in full
+  /// where a dynamic templateRef of another message refers to it.
+  ///
+  /// @param template_id The id of a template loaded by include().
+  /// @param paths The fields to be stored, each as a list of field names or
+  ///              ids separated by '.', such as "MDEntries.MDEntryPx". A path
+  ///              naming a group or a sequence selects all of its fields.
+  /// @param path_count Number of elements in @a paths array.
+  void projection(uint32_t template_id, const char *const *paths,
+                  std::size_t path_count);
+
+  void projection(uint32_t template_id,
+                  std::initializer_list<const char *> paths) {
+    projection(template_id, paths.begin(), paths.size());
+  }
+
+  /// Decode the messages of a template only to keep the dictionary in sync,
+  /// as sync() does, such as for heartbeats which are discarded anyway.
+  ///
+  /// The fields of the messages returned for the template are unspecified;
+  /// only the template id of such messages is meaningful. Disabling it
+  /// discards the projection of the template as well. Like projection(), it
+  /// does not apply where a dynamic templateRef refers to the template.
+  ///
+  /// @param template_id The id of a template loaded by include().
+  /// @param enabled Whether the messages of the template are only synced.
+  void sync_only(uint32_t template_id, bool enabled = true);
+
   /// Decode a  message.
   ///
   /// @param[in,out] first The initial position of the buffer to be decoded.
@@ -65,10 +120,134 @@ public:
   message_cref decode(const char *&first, const char *last,
                       bool force_reset = false);
 
+  /// Decode a message into @a target instead of a message owned by the
+  /// decoder, such as to alternate between the messages of a pool.
+  ///
+  /// The contents of the fields are allocated by the allocator of @a target.
+  /// The dictionary keeps copies of the string and byte vector previous
+  /// values, so the target may be modified or destroyed once decoded.
+  ///
+  /// @param[in] target A message of the template of the encoded message,
+  ///            such as one constructed from the instruction of a
+  ///            templates_description loaded by include().
+  /// @param[in,out] first The initial position of the buffer to be decoded.
+  ///                After decoding the parameter is set to position of the
+  ///                first unconsumed data byte.
+  /// @param[in] last The last position of the buffer to be decoded.
+  /// @param[in] force_reset Force the decoder to reset and discard all
+  ///            exisiting history values before decoding.
+  /// @throws coder::template_mismatch_error if the message is of another
+  ///         template, in which case nothing is decoded.
+  void decode_into(const message_mref &target, const char *&first,
+                   const char *last, bool force_reset = false);
+
+  /// Decode a message only to keep the dictionary in sync.
+  ///
+  /// Only the fields whose operators use the dictionary are decoded; the
+  /// other fields are consumed from the stream without being stored.
+  ///
+  /// @param[in,out] first The initial position of the buffer to be decoded.
+  ///                After decoding the parameter is set to position of the
+  ///                first unconsumed data byte.
+  /// @param[in] last The last position of the buffer to be decoded.
+  /// @param[in] force_reset Force the decoder to reset and discard all
+  ///            exisiting history values before decoding.
+  /// @returns The template id of the message.
+  uint32_t sync(const char *&first, const char *last, bool force_reset = false);
+
+  /// Decode a message from a trusted frame.
+  ///
+  /// Unlike decode(), the fields are decoded as if the input buffer extended
+  /// over the padding which follows it, so that the word at a time paths
+  /// cover the fields at the end of the frame too. The decoder validates only
+  /// once that the message did not extend beyond @a last. Use this function
+  /// when the frame length is already known, e.g. from a block header.
+  ///
+  /// @param[in,out] first The initial position of the buffer to be decoded.
+  ///                After decoding the parameter is set to position of the
+  ///                first unconsumed data byte.
+  /// @param[in] last The last position of the buffer to be decoded. The bytes
+  ///            in [last, last+mfast::trusted_padding) must be readable and
+  ///            set to zero.
+  /// @param[in] force_reset Force the decoder to reset and discard all
+  ///            exisiting history values before decoding.
+  message_cref decode_trusted(const char *&first, const char *last,
+                              bool force_reset = false);
+
+  /// Decode all messages in a buffer, such as a datagram or a capture file.
+  ///
+  /// The messages are decoded from a single input stream and handed to
+  /// @a callback one at a time, which saves the per message setup of decode().
+  /// The decoding loop is compiled into the library, so the callback is
+  /// invoked through a std::function and cannot be inlined into it;
+  /// fast_decoder_v2::decode_all() inlines the callback.
+  ///
+  /// @param[in,out] first The initial position of the buffer to be decoded.
+  ///                After decoding the parameter is set to position of the
+  ///                first byte not consumed by a decoded message, which is
+  ///                also where decoding stopped when an exception is thrown.
+  /// @param[in] last The last position of the buffer to be decoded.
+  /// @param[in] callback A functor invoked as callback(message_cref) for each
+  ///            message. The message is only valid during the call.
+  /// @param[in] force_reset Force the decoder to reset and discard all
+  ///            exisiting history values before decoding the first message.
+  /// @param[in] header_size The number of bytes preceding each message, such
+  ///            as a block header, which are skipped.
+  /// @returns The number of decoded messages.
+  template <typename Callback>
+  std::size_t decode_all(const char *&first, const char *last,
+                         Callback &&callback, bool force_reset = false,
+                         std::size_t header_size = 0) {
+    return decode_all_i(first, last, std::ref(callback), force_reset,
+                        header_size);
+  }
+
+  /// Record the dictionary changes of each message in @a journal, so that a
+  /// message which fails to decode leaves the dictionary unchanged.
+  ///
+  /// The journal is not owned by the decoder; pass nullptr to stop recording.
+  void journal(dictionary_journal *journal);
+
+  /// Let the byte vector fields without operator, whose previous value is not
+  /// shared, refer to the input buffer instead of copying them into the
+  /// message.
+  ///
+  /// The fields remain valid as long as the input buffer, which is never
+  /// modified. String fields are still copied, since c_str() returns a null
+  /// terminated string owned by the message.
+  void zero_copy(bool enabled);
+
+  /// Append the state of the dictionary to @a blob, such as to checkpoint a
+  /// decoder for a standby which takes over the stream.
+  ///
+  /// The state includes the previous values of all the fields, strings and
+  /// byte vectors included, and the id of the active template. The blob is
+  /// tied to the dictionary layout of the templates and to the byte order of
+  /// the host.
+  void save_dictionary(std::vector<char> &blob) const;
+
+  /// Replace the state of the dictionary with one saved by save_dictionary()
+  /// of a coder built from the same templates, so that decoding can resume
+  /// at the message following the saved state instead of the next reset.
+  ///
+  /// @throws coder::dictionary_snapshot_error if the blob is malformed or was
+  ///         saved with other templates, in which case the dictionary is left
+  ///         unchanged.
+  void restore_dictionary(const char *data, std::size_t size);
+
+  void restore_dictionary(const std::vector<char> &blob) {
+    restore_dictionary(blob.data(), blob.size());
+  }
+
   void debug_log(std::ostream *os);
   void warning_log(std::ostream *os);
 
 private:
+  typedef std::function<void(const message_cref &)> message_handler;
+  std::size_t decode_all_i(const char *&first, const char *last,
+                           const message_handler &handler, bool force_reset,
+                           std::size_t header_size);
+
   fast_decoder_impl *impl_;
 };
 }
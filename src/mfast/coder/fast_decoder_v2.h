@@ -6,6 +6,8 @@
 #pragma once
 
 #include "decoder_v2/fast_decoder_core.h"
+#include <initializer_list>
+#include <memory>
 #include <type_traits>
 #include <tuple>
 
@@ -94,6 +96,25 @@ public:
     this->init(desc1, rest...);
   }
 
+  /// Construct a decoder which refers to the instructions of @a templates
+  /// for the templates of @a desc instead of building instructions of its
+  /// own; see fast_decoder::include(std::shared_ptr<const template_set>).
+  template <typename... Descriptions>
+  fast_decoder_v2(mfast::allocator *alloc,
+                  std::shared_ptr<const template_set> templates,
+                  const Descriptions *... desc)
+      : coder::fast_decoder_core<NumTokens>(alloc) {
+    this->init(std::move(templates), desc...);
+  }
+
+  template <typename... Descriptions>
+  fast_decoder_v2(std::shared_ptr<const template_set> templates,
+                  const Descriptions *... desc)
+      : coder::fast_decoder_core<NumTokens>(
+            mfast::malloc_allocator::instance()) {
+    this->init(std::move(templates), desc...);
+  }
+
   fast_decoder_v2(const fast_decoder_v2 &) = delete;
 
   /// Decode a  message.
@@ -115,6 +136,92 @@ public:
     assert(token < NumTokens);
     return this->decode_stream(token, first, last, force_reset);
   }
+
+  /// Decode a message into @a target instead of a message of the decoder;
+  /// see fast_decoder::decode_into().
+  ///
+  /// @param[in] target A message of the template of the encoded message,
+  ///            such as an instance of the generated message class.
+  void decode_into(const message_mref &target, const char *&first,
+                   const char *last, bool force_reset = false) {
+    this->decode_into_i(target, first, last, force_reset);
+  }
+
+  /// Decode a message from a trusted frame.
+  ///
+  /// See fast_decoder::decode_trusted().
+  ///
+  /// @param[in] token The exclusive token value associated with the returned
+  /// message.
+  /// @param[in,out] first The initial position of the buffer to be decoded.
+  ///                After decoding the parameter is set to position of the
+  ///                first unconsumed data byte.
+  /// @param[in] last The last position of the buffer to be decoded. The bytes
+  ///            in [last, last+mfast::trusted_padding) must be readable and
+  ///            set to zero.
+  /// @param[in] force_reset Force the decoder to reset and discard all
+  ///            exisiting history values before decoding.
+  message_mref decode_trusted(std::size_t token, const char *&first,
+                              const char *last, bool force_reset = false) {
+    assert(token < NumTokens);
+    return this->decode_stream(token, first, last, force_reset,
+                               mfast::trusted_padding);
+  }
+
+  /// Decode all messages in a buffer; see fast_decoder::decode_all().
+  ///
+  /// @param[in] token The exclusive token value associated with the decoded
+  /// messages.
+  /// @param[in] callback A functor invoked as callback(message_mref) for each
+  ///            message. The message is only valid during the call.
+  template <typename Callback>
+  std::size_t decode_all(std::size_t token, const char *&first,
+                         const char *last, Callback &&callback,
+                         bool force_reset = false,
+                         std::size_t header_size = 0) {
+    assert(token < NumTokens);
+    return this->decode_all_stream(token, first, last, callback, force_reset,
+                                   header_size);
+  }
+
+  /// Record the dictionary changes of each message in @a journal, so that a
+  /// message which fails to decode leaves the dictionary unchanged.
+  ///
+  /// The journal is not owned by the decoder; pass nullptr to stop recording.
+  void journal(dictionary_journal *journal) { this->journal_ = journal; }
+
+  /// Let the byte vector fields without operator, whose previous value is not
+  /// shared, refer to the input buffer instead of copying them into the
+  /// message; see fast_decoder::zero_copy().
+  void zero_copy(bool enabled) { this->strm_.zero_copy(enabled); }
+
+  /// Restrict the fields stored in the messages of a template; see
+  /// fast_decoder::projection().
+  void projection(uint32_t template_id, const char *const *paths,
+                  std::size_t path_count) {
+    this->projection_i(template_id, paths, path_count);
+  }
+
+  void projection(uint32_t template_id,
+                  std::initializer_list<const char *> paths) {
+    this->projection_i(template_id, paths.begin(), paths.size());
+  }
+
+  /// Append the state of the dictionary to @a blob; see
+  /// fast_decoder::save_dictionary().
+  void save_dictionary(std::vector<char> &blob) const {
+    this->save_dictionary_i(blob);
+  }
+
+  /// Replace the state of the dictionary with one saved by save_dictionary();
+  /// see fast_decoder::restore_dictionary().
+  void restore_dictionary(const char *data, std::size_t size) {
+    this->restore_dictionary_i(data, size);
+  }
+
+  void restore_dictionary(const std::vector<char> &blob) {
+    this->restore_dictionary_i(blob.data(), blob.size());
+  }
 };
 
 template <> class fast_decoder_v2<0> : coder::fast_decoder_core<0> {
@@ -137,6 +244,24 @@ public:
     this->init(desc1, rest...);
   }
 
+  /// Construct a decoder which refers to the instructions of @a templates
+  /// for the templates of @a desc instead of building instructions of its
+  /// own; see fast_decoder::include(std::shared_ptr<const template_set>).
+  template <typename... Descriptions>
+  fast_decoder_v2(mfast::allocator *alloc,
+                  std::shared_ptr<const template_set> templates,
+                  const Descriptions *... desc)
+      : coder::fast_decoder_core<0>(alloc) {
+    this->init(std::move(templates), desc...);
+  }
+
+  template <typename... Descriptions>
+  fast_decoder_v2(std::shared_ptr<const template_set> templates,
+                  const Descriptions *... desc)
+      : coder::fast_decoder_core<0>(mfast::malloc_allocator::instance()) {
+    this->init(std::move(templates), desc...);
+  }
+
   fast_decoder_v2(const fast_decoder_v2 &) = delete;
   /// Decode a  message.
   ///
@@ -154,6 +279,88 @@ public:
                       bool force_reset = false) {
     return this->decode_stream(0, first, last, force_reset);
   }
+
+  /// Decode a message into @a target instead of a message of the decoder;
+  /// see fast_decoder::decode_into().
+  ///
+  /// @param[in] target A message of the template of the encoded message,
+  ///            such as an instance of the generated message class.
+  void decode_into(const message_mref &target, const char *&first,
+                   const char *last, bool force_reset = false) {
+    this->decode_into_i(target, first, last, force_reset);
+  }
+
+  /// Decode a message from a trusted frame.
+  ///
+  /// See fast_decoder::decode_trusted().
+  ///
+  /// @param[in,out] first The initial position of the buffer to be decoded.
+  ///                After decoding the parameter is set to position of the
+  ///                first unconsumed data byte.
+  /// @param[in] last The last position of the buffer to be decoded. The bytes
+  ///            in [last, last+mfast::trusted_padding) must be readable and
+  ///            set to zero.
+  /// @param[in] force_reset Force the decoder to reset and discard all
+  ///            exisiting history values before decoding.
+  message_cref decode_trusted(const char *&first, const char *last,
+                              bool force_reset = false) {
+    return this->decode_stream(0, first, last, force_reset,
+                               mfast::trusted_padding);
+  }
+
+  /// Record the dictionary changes of each message in @a journal, so that a
+  /// message which fails to decode leaves the dictionary unchanged.
+  ///
+  /// The journal is not owned by the decoder; pass nullptr to stop recording.
+  void journal(dictionary_journal *journal) { this->journal_ = journal; }
+
+  /// Let the byte vector fields without operator, whose previous value is not
+  /// shared, refer to the input buffer instead of copying them into the
+  /// message; see fast_decoder::zero_copy().
+  void zero_copy(bool enabled) { this->strm_.zero_copy(enabled); }
+
+  /// Restrict the fields stored in the messages of a template; see
+  /// fast_decoder::projection().
+  void projection(uint32_t template_id, const char *const *paths,
+                  std::size_t path_count) {
+    this->projection_i(template_id, paths, path_count);
+  }
+
+  void projection(uint32_t template_id,
+                  std::initializer_list<const char *> paths) {
+    this->projection_i(template_id, paths.begin(), paths.size());
+  }
+
+  /// Append the state of the dictionary to @a blob; see
+  /// fast_decoder::save_dictionary().
+  void save_dictionary(std::vector<char> &blob) const {
+    this->save_dictionary_i(blob);
+  }
+
+  /// Replace the state of the dictionary with one saved by save_dictionary();
+  /// see fast_decoder::restore_dictionary().
+  void restore_dictionary(const char *data, std::size_t size) {
+    this->restore_dictionary_i(data, size);
+  }
+
+  void restore_dictionary(const std::vector<char> &blob) {
+    this->restore_dictionary_i(blob.data(), blob.size());
+  }
+
+  /// Decode all messages in a buffer; see fast_decoder::decode_all().
+  template <typename Callback>
+  std::size_t decode_all(const char *&first, const char *last,
+                         Callback &&callback, bool force_reset = false,
+                         std::size_t header_size = 0) {
+    // the messages share their storage with the dictionary and must not be
+    // modified
+    auto read_only = [&callback](const message_mref &msg) {
+      message_cref result = msg;
+      callback(result);
+    };
+    return this->decode_all_stream(0, first, last, read_only, force_reset,
+                                   header_size);
+  }
 };
 
 } /* mfast */
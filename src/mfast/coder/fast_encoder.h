@@ -6,6 +6,7 @@
 #pragma once
 
 #include "mfast_coder_export.h"
+#include "fast_chunked_buffer.h"
 #include "mfast/message_ref.h"
 #include "mfast/malloc_allocator.h"
 
@@ -80,12 +81,49 @@ public:
   void encode(const message_cref &message, std::vector<char> &buffer,
               bool force_reset = false);
 
+  /// Encode a message into FAST byte stream and append the encoded stream to
+  /// the chunks of \a buffer.
+  ///
+  /// @param[in] message The message to be encoded.
+  /// @param[in] buffer The buffer for the encoded FAST stream to be appended
+  /// to.
+  /// @param[in] force_reset Force the encoder to reset and discard all
+  /// exisiting history values.
+  void encode(const message_cref &message, fast_chunked_buffer &buffer,
+              bool force_reset = false);
+
+  /// Returns an upper bound of the size of @a message encoded by encode().
+  ///
+  /// The encoder reserves the bound in its buffer before the message is
+  /// written, so that the writes of the fields need not be checked. A buffer
+  /// smaller than the bound is still filled as long as the message fits, at
+  /// the cost of an extra copy.
+  std::size_t encoded_size_bound(const message_cref &message);
+
+  /// Let the next message carry its template id even if the previous message
+  /// has the same template, unless the encoder has a single template; e.g. so
+  /// that a packet can be decoded on its own.
+  void resend_template_id();
+
   /// Instruct the encoder whether the overlong presence map is allowed.
   ///
   /// Overlong presence map is allowed by default for better performance.
   /// It can be disabled for better standard conformance reason.
   void allow_overlong_pmap(bool v);
 
+  /// Append the state of the dictionary to @a blob; see
+  /// fast_decoder::save_dictionary().
+  void save_dictionary(std::vector<char> &blob) const;
+
+  /// Replace the state of the dictionary with one saved by save_dictionary()
+  /// of an encoder built from the same templates, e.g. to let a standby take
+  /// over the encoding of a stream; see fast_decoder::restore_dictionary().
+  void restore_dictionary(const char *data, std::size_t size);
+
+  void restore_dictionary(const std::vector<char> &blob) {
+    restore_dictionary(blob.data(), blob.size());
+  }
+
 private:
   fast_encoder_impl *impl_;
 };
@@ -8,6 +8,7 @@
 #include <vector>
 #include <tuple>
 #include "encoder_v2/fast_encoder_core.h"
+#include "fast_chunked_buffer.h"
 
 namespace mfast {
 ///
@@ -62,10 +63,55 @@ public:
     this->encode_i(message, buffer, force_reset);
   }
 
+  /// Encode a message into FAST byte stream and append the encoded stream to
+  /// the chunks of \a buffer.
+  ///
+  /// @param[in] message The message to be encoded.
+  /// @param[in] buffer The buffer for the encoded FAST stream to be appended
+  /// to.
+  /// @param[in] force_reset Force the encoder to reset and discard all
+  /// exisiting history values.
+  void encode(const message_cref &message, fast_chunked_buffer &buffer,
+              bool force_reset = false) {
+    std::size_t bound = this->bounds_.bound(message);
+    fast_ostreambuf sb(buffer.prepare(bound), bound);
+    this->strm_.rdbuf(&sb);
+    this->encode_segment(message, force_reset);
+    buffer.commit(sb.length());
+  }
+
+  /// Returns an upper bound of the size of @a message encoded by encode();
+  /// see fast_encoder::encoded_size_bound().
+  std::size_t encoded_size_bound(const message_cref &message) {
+    return this->bounds_.bound(message);
+  }
+
+  /// Let the next message carry its template id; see
+  /// fast_encoder::resend_template_id().
+  void resend_template_id() {
+    this->active_message_info_ = this->repo_.unique_entry();
+  }
+
   /// Instruct the encoder whether the overlong presence map is allowed.
   ///
   /// Overlong presence map is allowed by default for better performance.
   /// It can be disabled for better standard conformance reason.
   void allow_overlong_pmap(bool v) { this->allow_overlong_pmap_i(v); }
+
+  /// Append the state of the dictionary to @a blob; see
+  /// fast_decoder::save_dictionary().
+  void save_dictionary(std::vector<char> &blob) const {
+    this->save_dictionary_i(blob);
+  }
+
+  /// Replace the state of the dictionary with one saved by save_dictionary();
+  /// see fast_encoder::restore_dictionary().
+  void restore_dictionary(const char *data, std::size_t size) {
+    this->restore_dictionary_i(data, size);
+  }
+
+  void restore_dictionary(const std::vector<char> &blob) {
+    this->restore_dictionary_i(blob.data(), blob.size());
+  }
 };
 }
@@ -0,0 +1,261 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "mfast/exceptions.h"
+#include "mfast/message_ref.h"
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <stdint.h>
+
+namespace mfast {
+
+/// Describes how the messages of a feed or capture file are framed.
+///
+/// A frame consists of a fixed size header, which may contain a sequence
+/// number and a fixed size length field, optionally followed by a stop bit
+/// encoded block length, and the payload.
+struct fast_frame_format {
+  enum length_encoding_t {
+    /// The frame carries no length; the payload ends where the FAST message
+    /// does.
+    no_length,
+    /// The header contains a fixed size big endian payload length.
+    big_endian_length,
+    /// The header contains a fixed size little endian payload length.
+    little_endian_length,
+    /// The header is followed by a stop bit encoded uInt32 payload length,
+    /// i.e. the block length of the FAST session control protocol.
+    stop_bit_length
+  };
+
+  std::size_t header_size;
+  length_encoding_t length_encoding;
+  std::size_t length_offset;
+  std::size_t length_size;
+  std::size_t sequence_offset;
+  /// The size of the big endian sequence number in the header, or 0 if there
+  /// is none.
+  std::size_t sequence_size;
+
+  fast_frame_format(std::size_t header_size = 0,
+                    length_encoding_t length_encoding = no_length)
+      : header_size(header_size), length_encoding(length_encoding),
+        length_offset(0), length_size(header_size), sequence_offset(0),
+        sequence_size(0) {}
+
+  /// Frames with a header of @a size bytes which is skipped.
+  static fast_frame_format fixed_header(std::size_t size) {
+    return fast_frame_format(size);
+  }
+
+  /// Frames with a big endian sequence number of @a size bytes as header.
+  static fast_frame_format sequence_header(std::size_t size = 4) {
+    fast_frame_format result(size);
+    result.sequence_size = size;
+    return result;
+  }
+
+  /// Frames with a payload length of @a size bytes as header.
+  static fast_frame_format length_prefix(std::size_t size = 4,
+                                         bool big_endian = true) {
+    return fast_frame_format(size, big_endian ? big_endian_length
+                                              : little_endian_length);
+  }
+
+  /// Frames with a stop bit encoded block length.
+  static fast_frame_format block_length() {
+    return fast_frame_format(0, stop_bit_length);
+  }
+};
+
+/// A frame located by fast_frame_reader. The spans refer to the input buffer.
+struct fast_frame {
+  const char *header = nullptr;
+  std::size_t header_size = 0;
+  const char *payload = nullptr;
+  /// For fast_frame_format::no_length, the payload extends to the end of the
+  /// input buffer.
+  std::size_t payload_size = 0;
+  uint64_t sequence = 0;
+  /// The sequence number does not follow the one of the previous frame; the
+  /// dictionary state of the sender is unknown.
+  bool gap = false;
+};
+
+/// Splits a buffer, such as a datagram or a capture file, into frames without
+/// copying.
+///
+/// The frames can either be iterated with next(), or fed directly to a decoder
+/// with decode().
+class fast_frame_reader {
+public:
+  fast_frame_reader(const fast_frame_format &format, const char *first,
+                    const char *last)
+      : format_(format), pos_(first), last_(last), next_sequence_(0),
+        has_sequence_(false) {
+    assert(format.length_encoding == fast_frame_format::no_length ||
+           format.length_encoding == fast_frame_format::stop_bit_length ||
+           format.length_offset + format.length_size <= format.header_size);
+    assert(format.sequence_offset + format.sequence_size <=
+           format.header_size);
+  }
+
+  /// Locate the next frame.
+  ///
+  /// For frames without length, the position of the next frame is unknown
+  /// until consume() is called with the end of the message.
+  ///
+  /// @returns false if the remaining bytes do not contain a complete frame;
+  ///          position() is left at the start of the incomplete frame.
+  bool next(fast_frame &frame) {
+    const char *p = pos_;
+    if (static_cast<std::size_t>(last_ - p) < format_.header_size)
+      return false;
+
+    frame.header = p;
+    frame.header_size = format_.header_size;
+    p += format_.header_size;
+
+    std::size_t length = last_ - p;
+    switch (format_.length_encoding) {
+    case fast_frame_format::no_length:
+      if (length == 0)
+        return false;
+      break;
+    case fast_frame_format::big_endian_length:
+      length = static_cast<std::size_t>(read_big_endian(
+          frame.header + format_.length_offset, format_.length_size));
+      break;
+    case fast_frame_format::little_endian_length:
+      length = static_cast<std::size_t>(read_little_endian(
+          frame.header + format_.length_offset, format_.length_size));
+      break;
+    case fast_frame_format::stop_bit_length:
+      if (!read_stop_bit(p, length))
+        return false;
+      frame.header_size = p - frame.header;
+      break;
+    }
+    if (length > static_cast<std::size_t>(last_ - p))
+      return false;
+
+    frame.payload = p;
+    frame.payload_size = length;
+
+    frame.gap = false;
+    frame.sequence = 0;
+    if (format_.sequence_size) {
+      frame.sequence = read_big_endian(frame.header + format_.sequence_offset,
+                                       format_.sequence_size);
+      frame.gap = has_sequence_ && frame.sequence != next_sequence_;
+      next_sequence_ = frame.sequence + 1;
+      has_sequence_ = true;
+    }
+
+    if (format_.length_encoding != fast_frame_format::no_length)
+      pos_ = p + length;
+    return true;
+  }
+
+  /// Set the end of a frame without length after its message is decoded.
+  /// Frames with a length are consumed by next() and the call has no effect.
+  void consume(const char *message_end) {
+    if (format_.length_encoding == fast_frame_format::no_length) {
+      assert(pos_ <= message_end && message_end <= last_);
+      pos_ = message_end;
+    }
+  }
+
+  /// Decode the messages of all complete frames.
+  ///
+  /// A frame with a length may carry several messages. The dictionary is
+  /// reset before the first message of a frame which follows a sequence gap.
+  ///
+  /// If the decoder throws, frames with a length are already consumed, so that
+  /// decoding can resume with the next frame.
+  ///
+  /// @param decoder A decoder with a decode(first, last, force_reset) member
+  ///                function, i.e. fast_decoder or fast_decoder_v2<0>.
+  /// @param callback A functor invoked as callback(message_cref, const
+  ///                 fast_frame&) for each message.
+  /// @param force_reset Reset the dictionary before the first message.
+  /// @returns The number of decoded messages.
+  template <typename Decoder, typename Callback>
+  std::size_t decode(Decoder &decoder, Callback &&callback,
+                     bool force_reset = false) {
+    std::size_t count = 0;
+    fast_frame frame;
+    while (next(frame)) {
+      bool reset = force_reset || frame.gap;
+      force_reset = false;
+      const char *first = frame.payload;
+      const char *last = frame.payload + frame.payload_size;
+      if (format_.length_encoding == fast_frame_format::no_length) {
+        message_cref msg = decoder.decode(first, last, reset);
+        consume(first);
+        ++count;
+        callback(msg, frame);
+        continue;
+      }
+      while (first < last) {
+        message_cref msg = decoder.decode(first, last, reset);
+        reset = false;
+        ++count;
+        callback(msg, frame);
+      }
+    }
+    return count;
+  }
+
+  /// Returns the start of the next frame.
+  const char *position() const { return pos_; }
+
+  /// Returns true if a sequence number was seen and the next one is expected.
+  bool has_sequence() const { return has_sequence_; }
+
+  /// Returns the sequence number expected in the next frame.
+  uint64_t next_sequence() const { return next_sequence_; }
+
+private:
+  static uint64_t read_big_endian(const char *p, std::size_t size) {
+    uint64_t v = 0;
+    for (std::size_t i = 0; i < size; ++i)
+      v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+  }
+
+  static uint64_t read_little_endian(const char *p, std::size_t size) {
+    uint64_t v = 0;
+    for (std::size_t i = size; i > 0; --i)
+      v = (v << 8) | static_cast<unsigned char>(p[i - 1]);
+    return v;
+  }
+
+  // read a stop bit encoded uInt32 and advance p past it
+  bool read_stop_bit(const char *&p, std::size_t &length) const {
+    uint64_t v = 0;
+    for (const char *q = p; q < last_; ++q) {
+      v = (v << 7) | (*q & 0x7F);
+      if (v > (std::numeric_limits<uint32_t>::max)())
+        BOOST_THROW_EXCEPTION(fast_dynamic_error("D2"));
+      if (*q & 0x80) {
+        p = q + 1;
+        length = static_cast<std::size_t>(v);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  fast_frame_format format_;
+  const char *pos_;
+  const char *last_;
+  uint64_t next_sequence_;
+  bool has_sequence_;
+};
+}
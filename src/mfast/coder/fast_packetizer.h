@@ -0,0 +1,194 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "fast_frame_reader.h"
+#include "encoder/fast_ostreambuf.h"
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace mfast {
+
+/// Packs the messages of an encoder into packets of a maximum size, e.g. the
+/// UDP datagrams which fit the MTU of a network.
+///
+/// A packet is a frame of a fast_frame_format, i.e. a header which may carry a
+/// sequence number and the payload length, followed by as many whole messages
+/// as fit, so that the packets can be read by fast_frame_reader. A message is
+/// never split; unless it fits in the rest of the current packet, the packet
+/// is handed to the handler and the message starts the next one. The messages
+/// of a format without length can only be located by decoding them, hence
+/// each packet of such a format carries a single message.
+///
+/// When reset_every_packet() is set, the first message of every packet resets
+/// the dictionary and carries its template id, so that each packet can be
+/// decoded on its own, e.g. after a packet loss.
+///
+/// @tparam Encoder fast_encoder or fast_encoder_v2.
+template <typename Encoder> class fast_packetizer {
+public:
+  typedef std::function<void(const char *, std::size_t)> packet_handler;
+
+  /// @param encoder The encoder of the messages, which must be used by the
+  ///                packetizer only.
+  /// @param format The header of the packets.
+  /// @param max_packet_size The maximum size of a packet, header included.
+  /// @param handler Invoked as handler(data, size) with each complete
+  ///                packet, which is only valid during the call.
+  fast_packetizer(Encoder &encoder, const fast_frame_format &format,
+                  std::size_t max_packet_size, packet_handler handler)
+      : encoder_(encoder), format_(format), handler_(std::move(handler)),
+        max_header_size_(format.header_size), payload_size_(0),
+        next_sequence_(0), reset_every_packet_(false), reset_pending_(false) {
+    if (format.length_encoding == fast_frame_format::stop_bit_length)
+      max_header_size_ += stop_bit_size(max_packet_size);
+    assert(max_header_size_ < max_packet_size);
+    // the length field holds the largest payload
+    assert((format.length_encoding != fast_frame_format::big_endian_length &&
+            format.length_encoding !=
+                fast_frame_format::little_endian_length) ||
+           format.length_size >= sizeof(std::size_t) ||
+           max_packet_size >> (8 * format.length_size) == 0);
+    packet_.resize(max_packet_size);
+  }
+
+  fast_packetizer(const fast_packetizer &) = delete;
+  fast_packetizer &operator=(const fast_packetizer &) = delete;
+
+  /// Reset the dictionary at the first message of every packet.
+  void reset_every_packet(bool enabled) { reset_every_packet_ = enabled; }
+
+  /// Set the sequence number of the next packet, which is 0 by default.
+  void next_sequence(uint64_t sequence) { next_sequence_ = sequence; }
+  uint64_t next_sequence() const { return next_sequence_; }
+
+  /// Append @a message to the current packet, or to the next one if it does
+  /// not fit.
+  ///
+  /// @throws buffer_overflow_error if the message does not fit in a packet of
+  ///         its own. The message is then dropped, and the next packet resets
+  ///         the dictionary, to which the message was encoded.
+  void encode(const message_cref &message) {
+    if (format_.length_encoding == fast_frame_format::no_length &&
+        payload_size_ > 0)
+      flush();
+
+    bool reset = start_message();
+    char *payload = packet_.data() + max_header_size_;
+    std::size_t room = payload_capacity() - payload_size_;
+    if (encoder_.encoded_size_bound(message) <= room) {
+      payload_size_ +=
+          encoder_.encode(message, payload + payload_size_, room, reset);
+      reset_pending_ = false;
+      return;
+    }
+
+    // the message may not fit; it is encoded aside to be moved as a whole
+    scratch_.clear();
+    encoder_.encode(message, scratch_, reset);
+    reset_pending_ = false;
+    if (scratch_.size() > room && payload_size_ > 0) {
+      flush();
+      if (start_message()) {
+        // the reset discards the dictionary values of the first encoding
+        scratch_.clear();
+        encoder_.encode(message, scratch_, true);
+      }
+      room = payload_capacity();
+    }
+    if (scratch_.size() > room) {
+      reset_pending_ = true;
+      throw buffer_overflow_error();
+    }
+    std::memcpy(payload + payload_size_, scratch_.data(), scratch_.size());
+    payload_size_ += scratch_.size();
+  }
+
+  /// Hand the current packet to the handler, unless it is empty.
+  void flush() {
+    if (payload_size_ == 0)
+      return;
+
+    // the header ends where the payload starts
+    std::size_t header_size = format_.header_size;
+    if (format_.length_encoding == fast_frame_format::stop_bit_length)
+      header_size += stop_bit_size(payload_size_);
+    char *header = packet_.data() + max_header_size_ - header_size;
+    std::memset(header, 0, format_.header_size);
+
+    if (format_.sequence_size)
+      write_big_endian(header + format_.sequence_offset, format_.sequence_size,
+                       next_sequence_);
+    switch (format_.length_encoding) {
+    case fast_frame_format::big_endian_length:
+      write_big_endian(header + format_.length_offset, format_.length_size,
+                       payload_size_);
+      break;
+    case fast_frame_format::little_endian_length:
+      for (std::size_t i = 0; i < format_.length_size; ++i)
+        header[format_.length_offset + i] =
+            static_cast<char>(static_cast<uint64_t>(payload_size_) >> (8 * i));
+      break;
+    case fast_frame_format::stop_bit_length: {
+      char *p = header + format_.header_size;
+      std::size_t n = header_size - format_.header_size;
+      for (std::size_t i = 0; i < n; ++i)
+        p[i] = static_cast<char>((payload_size_ >> (7 * (n - 1 - i))) & 0x7F);
+      p[n - 1] |= 0x80;
+    } break;
+    default:
+      break;
+    }
+
+    std::size_t packet_size = header_size + payload_size_;
+    ++next_sequence_;
+    payload_size_ = 0;
+    handler_(header, packet_size);
+  }
+
+private:
+  std::size_t payload_capacity() const {
+    return packet_.size() - max_header_size_;
+  }
+
+  // prepare the encoder for a message; returns whether it resets the
+  // dictionary
+  bool start_message() {
+    if (payload_size_ > 0 || !(reset_every_packet_ || reset_pending_))
+      return false;
+    encoder_.resend_template_id();
+    return true;
+  }
+
+  static std::size_t stop_bit_size(std::size_t value) {
+    std::size_t n = 1;
+    while (value >>= 7)
+      ++n;
+    return n;
+  }
+
+  static void write_big_endian(char *p, std::size_t size, uint64_t value) {
+    for (std::size_t i = size; i > 0; --i, value >>= 8)
+      p[i - 1] = static_cast<char>(value);
+  }
+
+  Encoder &encoder_;
+  fast_frame_format format_;
+  packet_handler handler_;
+  // the header is written right before the payload, which is preceded by
+  // room for the longest stop bit encoded length
+  std::size_t max_header_size_;
+  std::vector<char> packet_;
+  std::size_t payload_size_;
+  std::vector<char> scratch_;
+  uint64_t next_sequence_;
+  bool reset_every_packet_;
+  bool reset_pending_;
+};
+}
@@ -0,0 +1,273 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "fast_decoder.h"
+#include "fast_frame_reader.h"
+#include "common/template_repo.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mfast {
+
+/// Decodes a capture of framed messages on several threads.
+///
+/// The dictionary chains each message to the previous one, except where the
+/// stream resets it. The capture is therefore split into segments at the
+/// frames whose first message carries its template id and resets the
+/// dictionary, i.e. when:
+///
+/// - the template has the reset attribute, such as the reset message of the
+///   FAST session control protocol;
+/// - the frame follows a sequence gap, for which fast_frame_reader::decode()
+///   resets the dictionary as well; or
+/// - reset_every_frame() is set, for feeds which reset on every packet.
+///
+/// Each segment is decoded by a decoder of its own on a pool of threads. A
+/// reset in the middle of a frame does not split the capture. Neither does
+/// any reset of a capture framed with fast_frame_format::no_length, whose
+/// frames can only be located by decoding them; such a capture is decoded by
+/// a single thread.
+class fast_parallel_replay {
+public:
+  /// @param templates The templates of the capture; see
+  ///                  fast_decoder::include().
+  /// @param format The framing of the capture.
+  /// @param num_threads The number of decoding threads; 0 for one per core.
+  fast_parallel_replay(std::shared_ptr<const template_set> templates,
+                       const fast_frame_format &format,
+                       std::size_t num_threads = 0)
+      : templates_(std::move(templates)), format_(format),
+        num_threads_(num_threads
+                         ? num_threads
+                         : std::max(1U, std::thread::hardware_concurrency())),
+        reset_every_frame_(false), min_segment_size_(64 * 1024),
+        position_(nullptr) {
+    templates_->for_each_template([this](const template_instruction *inst) {
+      if (inst->has_reset_attribute())
+        reset_templates_.insert(inst->id());
+    });
+  }
+
+  /// Reset the dictionary before the first message of every frame.
+  void reset_every_frame(bool enabled) { reset_every_frame_ = enabled; }
+
+  /// Split the capture only where a segment has at least @a size bytes, so
+  /// that a thread is not handed every frame of a feed which resets often.
+  void min_segment_size(std::size_t size) { min_segment_size_ = size; }
+
+  /// Decode the messages of all complete frames in [first, last).
+  ///
+  /// @param transform A functor invoked as transform(message_cref, const
+  ///                  fast_frame&) for each message, concurrently on the
+  ///                  decoding threads for the messages of different
+  ///                  segments. The message is only valid during the call; the
+  ///                  returned value is handed to @a consumer.
+  /// @param consumer A functor invoked with the value returned by
+  ///                 @a transform on the calling thread, one message at a
+  ///                 time in the order of the capture.
+  /// @returns The number of decoded messages.
+  /// @throws The exception of the first message which fails to decode, once
+  ///         the messages before it are consumed.
+  template <typename Transform, typename Consumer>
+  std::size_t decode(const char *first, const char *last,
+                     Transform &&transform, Consumer &&consumer) {
+    typedef typename std::decay<decltype(
+        transform(std::declval<const message_cref &>(),
+                  std::declval<const fast_frame &>()))>::type result_type;
+
+    struct segment {
+      const char *first;
+      const char *last;
+      std::vector<result_type> results;
+      std::exception_ptr error;
+      bool done;
+    };
+
+    split(first, last);
+    std::vector<segment> segments(starts_.size());
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+      segments[i].first = starts_[i];
+      segments[i].last = i + 1 < starts_.size() ? starts_[i + 1] : position_;
+      segments[i].done = false;
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::size_t next = 0, consumed = 0;
+    bool stop = false;
+    // bound the results waiting for the consumer
+    const std::size_t window = 2 * num_threads_;
+
+    auto work = [&]() {
+      fast_decoder decoder;
+      decoder.include(templates_);
+      for (;;) {
+        std::size_t i;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cond.wait(lock, [&] {
+            return stop || next == segments.size() || next < consumed + window;
+          });
+          if (stop || next == segments.size())
+            return;
+          i = next++;
+        }
+        segment &s = segments[i];
+        try {
+          decode_segment(decoder, s.first, s.last,
+                         [&](const message_cref &msg, const fast_frame &frame) {
+                           s.results.push_back(transform(msg, frame));
+                         });
+        } catch (...) {
+          s.error = std::current_exception();
+        }
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          s.done = true;
+        }
+        cond.notify_all();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    std::size_t num_threads = std::min(num_threads_, segments.size());
+    for (std::size_t i = 0; i < num_threads; ++i)
+      threads.emplace_back(work);
+
+    auto join = [&](bool stopping) {
+      if (stopping) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      cond.notify_all();
+      for (auto &thread : threads)
+        thread.join();
+    };
+
+    std::size_t count = 0;
+    try {
+      for (auto &s : segments) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cond.wait(lock, [&] { return s.done; });
+        }
+        for (auto &result : s.results)
+          consumer(std::move(result));
+        count += s.results.size();
+        if (s.error)
+          std::rethrow_exception(s.error);
+        std::vector<result_type>().swap(s.results);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          ++consumed;
+        }
+        cond.notify_all();
+      }
+    } catch (...) {
+      join(true);
+      throw;
+    }
+    join(false);
+    return count;
+  }
+
+  /// Returns the number of segments of the last decoded capture.
+  std::size_t segment_count() const { return starts_.size(); }
+
+  /// Returns the start of the first incomplete frame of the last decoded
+  /// capture, or its end.
+  const char *position() const { return position_; }
+
+private:
+  // locate the frames which start a segment
+  void split(const char *first, const char *last) {
+    starts_.assign(1, first);
+    position_ = last;
+    if (format_.length_encoding == fast_frame_format::no_length)
+      return;
+
+    fast_frame_reader reader(format_, first, last);
+    fast_frame frame;
+    while (reader.next(frame)) {
+      if (static_cast<std::size_t>(frame.header - starts_.back()) >=
+              min_segment_size_ &&
+          frame.header != first && starts_reset(frame))
+        starts_.push_back(frame.header);
+    }
+    position_ = reader.position();
+  }
+
+  bool starts_reset(const fast_frame &frame) const {
+    uint32_t template_id;
+    if (!first_template_id(frame.payload, frame.payload + frame.payload_size,
+                           template_id))
+      return false;
+    return reset_every_frame_ || frame.gap ||
+           reset_templates_.count(template_id) != 0;
+  }
+
+  // the template id of the message at first, if its presence map has the
+  // template id bit set
+  static bool first_template_id(const char *first, const char *last,
+                                uint32_t &template_id) {
+    if (first == last || (*first & 0x40) == 0)
+      return false;
+    while (first < last && (*first & 0x80) == 0)
+      ++first;
+    if (first++ == last)
+      return false;
+
+    uint64_t v = 0;
+    for (int n = 0; first < last && n < 5; ++first, ++n) {
+      v = (v << 7) | (*first & 0x7F);
+      if (*first & 0x80) {
+        template_id = static_cast<uint32_t>(v);
+        return v <= 0xFFFFFFFF;
+      }
+    }
+    return false;
+  }
+
+  template <typename Callback>
+  void decode_segment(fast_decoder &decoder, const char *first,
+                      const char *last, Callback &&callback) const {
+    fast_frame_reader reader(format_, first, last);
+    fast_frame frame;
+    bool force_reset = true;
+    while (reader.next(frame)) {
+      bool reset = force_reset || reset_every_frame_ || frame.gap;
+      force_reset = false;
+      const char *msg_first = frame.payload;
+      const char *msg_last = frame.payload + frame.payload_size;
+      do {
+        message_cref msg = decoder.decode(msg_first, msg_last, reset);
+        reset = false;
+        reader.consume(msg_first);
+        callback(msg, frame);
+      } while (format_.length_encoding != fast_frame_format::no_length &&
+               msg_first < msg_last);
+    }
+  }
+
+  std::shared_ptr<const template_set> templates_;
+  fast_frame_format format_;
+  std::size_t num_threads_;
+  bool reset_every_frame_;
+  std::size_t min_segment_size_;
+  std::set<uint32_t> reset_templates_;
+  std::vector<const char *> starts_;
+  const char *position_;
+};
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "mfast_coder_export.h"
+#include "fast_decoder.h"
+#include "common/dictionary_journal.h"
+#include <exception>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4251) // non dll-interface class used as a member for
+                                // dll-interface class
+#endif                          //_MSC_VER
+
+namespace mfast {
+
+enum decode_status_t { decode_complete, decode_need_more, decode_error };
+
+/// Decodes messages from a byte stream which arrives in arbitrary chunks,
+/// such as FAST over TCP.
+///
+/// A message is decoded in place when it lies entirely within the chunk
+/// passed to decode(). Only the bytes of a message straddling two or more
+/// chunks are copied into an internal buffer until the message is complete.
+///
+/// Every message is decoded as a transaction: when the input runs short or the
+/// message is malformed, the dictionary changes made by the partially decoded
+/// message are rolled back.
+///
+/// The underlying decoder must not be used directly while a
+/// fast_stream_decoder refers to it.
+class MFAST_CODER_EXPORT fast_stream_decoder {
+public:
+  /// @param decoder The decoder, with its templates already included.
+  /// @param max_journal_entries The maximum number of dictionary values a
+  ///                            single message may modify and still be rolled
+  ///                            back.
+  /// @param max_journal_bytes The maximum number of string bytes a single
+  ///                          message may modify and still be rolled back.
+  fast_stream_decoder(fast_decoder &decoder,
+                      std::size_t max_journal_entries = 1024,
+                      std::size_t max_journal_bytes = 16 * 1024);
+  ~fast_stream_decoder();
+
+  /// Decode the next message.
+  ///
+  /// @param[in,out] first The initial position of the received bytes which
+  ///                are not consumed yet. After decoding the parameter is set
+  ///                to position of the first unconsumed byte.
+  /// @param[in] last The last position of the received bytes.
+  /// @param[out] msg The decoded message when decode_complete is returned. It
+  ///             is valid until the next call to decode().
+  /// @param[in] force_reset Force the decoder to reset and discard all
+  ///            exisiting history values before decoding the message.
+  /// @returns decode_complete if a message was decoded;
+  ///          decode_need_more if the message is incomplete, in which case
+  ///          all bytes in [first, last) were buffered and @a first is set to
+  ///          @a last; decode_error if the message cannot be decoded, in
+  ///          which case any buffered bytes are discarded, @a first is left
+  ///          unchanged and last_error() holds the exception.
+  decode_status_t decode(const char *&first, const char *last,
+                         message_cref &msg, bool force_reset = false);
+
+  /// Discard the buffered bytes of an incomplete message.
+  void reset();
+
+  /// Returns the number of buffered bytes of an incomplete message.
+  std::size_t buffered_size() const { return pending_.size(); }
+
+  /// Returns the exception of the last decode_error.
+  std::exception_ptr last_error() const { return error_; }
+
+private:
+  // the buffer is grown at least by this many bytes at a time while a message
+  // straddles chunks
+  static const std::size_t min_append_size = 256;
+
+  decode_status_t try_decode(const char *&first, const char *last,
+                             message_cref &msg, bool force_reset);
+
+  fast_decoder &decoder_;
+  dictionary_journal journal_;
+  std::vector<char> pending_;
+  std::exception_ptr error_;
+};
+}
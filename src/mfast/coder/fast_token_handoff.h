@@ -0,0 +1,170 @@
+// Copyright (c) 2016, Huang-Ming Huang,  Object Computing, Inc.
+// All rights reserved.
+//
+// This file is part of mFAST.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "fast_decoder_v2.h"
+#include <atomic>
+#include <cstddef>
+
+namespace mfast {
+namespace coder {
+/// A bounded queue of a producer thread and a consumer thread, which never
+/// blocks either of them.
+template <typename T, std::size_t Capacity> class spsc_ring {
+public:
+  spsc_ring() : head_(0), tail_(0) {}
+
+  spsc_ring(const spsc_ring &) = delete;
+  spsc_ring &operator=(const spsc_ring &) = delete;
+
+  /// Append @a value; only invoked by the producer.
+  ///
+  /// @returns false if the queue is full.
+  bool push(const T &value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity)
+      return false;
+    slots_[tail % Capacity] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Returns the first value, or nullptr if the queue is empty; only invoked
+  /// by the consumer.
+  T *front() {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return nullptr;
+    return &slots_[head % Capacity];
+  }
+
+  /// Remove the value returned by front().
+  void pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+private:
+  T slots_[Capacity];
+  // on cache lines of their own, since each is written by another thread
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+};
+}
+
+/// Hands the messages of a fast_decoder_v2 from the decoding thread to a
+/// consumer thread, without copying them.
+///
+/// The decoder keeps a message of each template for every token, which stays
+/// valid until the token is used for decoding again. The handoff decodes each
+/// message with a token which is not in flight and publishes the message
+/// along with its token. Once the consumer is done with the message, it
+/// releases the token, which makes it available for decoding again. When all
+/// the tokens are in flight, decode() returns false instead of waiting for the
+/// consumer.
+///
+/// The decoding thread may only invoke decode() and decode_trusted(), and the
+/// consumer thread consume() and release(); neither of them ever blocks.
+/// Since the decoder allocates the contents of the messages, the consumer
+/// should not modify them unless the allocator of the decoder is thread safe.
+template <unsigned NumTokens> class fast_token_handoff {
+  static_assert(NumTokens > 0, "The messages of a decoder without tokens "
+                               "are reused by every decode");
+
+public:
+  /// @param decoder The decoder of the messages, which must be used by the
+  ///                handoff only.
+  fast_token_handoff(fast_decoder_v2<NumTokens> &decoder)
+      : decoder_(decoder), held_(no_token) {
+    for (std::size_t token = 0; token < NumTokens; ++token)
+      free_.push(token);
+  }
+
+  fast_token_handoff(const fast_token_handoff &) = delete;
+  fast_token_handoff &operator=(const fast_token_handoff &) = delete;
+
+  /// Decode a message with the next free token and publish it to the
+  /// consumer; see fast_decoder_v2::decode().
+  ///
+  /// @returns false if all the tokens are in flight, in which case nothing is
+  ///          decoded and @a first is left unchanged.
+  bool decode(const char *&first, const char *last, bool force_reset = false) {
+    return decode_with([&](std::size_t token) {
+      return decoder_.decode(token, first, last, force_reset);
+    });
+  }
+
+  /// Decode a message from a trusted frame with the next free token and
+  /// publish it to the consumer; see fast_decoder_v2::decode_trusted().
+  ///
+  /// @returns false if all the tokens are in flight.
+  bool decode_trusted(const char *&first, const char *last,
+                      bool force_reset = false) {
+    return decode_with([&](std::size_t token) {
+      return decoder_.decode_trusted(token, first, last, force_reset);
+    });
+  }
+
+  /// Take the next published message, in the order of decoding.
+  ///
+  /// @param[out] token The token of the message, to be passed to release().
+  /// @param[out] message Refers to the message until the token is released.
+  /// @returns false if there is no published message.
+  bool consume(std::size_t &token, message_cref &message) {
+    published_message *entry = published_.front();
+    if (entry == nullptr)
+      return false;
+    token = entry->token;
+    message.refers_to(entry->message);
+    published_.pop();
+    return true;
+  }
+
+  /// Make the token of a consumed message available for decoding again.
+  void release(std::size_t token) { free_.push(token); }
+
+private:
+  static const std::size_t no_token = static_cast<std::size_t>(-1);
+
+  struct published_message {
+    std::size_t token;
+    message_cref message;
+
+    published_message &operator=(const published_message &other) {
+      token = other.token;
+      message.refers_to(other.message);
+      return *this;
+    }
+  };
+
+  template <typename Decode> bool decode_with(Decode decode) {
+    std::size_t token = held_;
+    if (token == no_token) {
+      std::size_t *next = free_.front();
+      if (next == nullptr)
+        return false;
+      token = *next;
+      free_.pop();
+    }
+
+    // keep the token for the next message if this one fails to decode
+    held_ = token;
+    published_message entry;
+    entry.token = token;
+    entry.message.refers_to(decode(token));
+    held_ = no_token;
+    // never full, since there are only NumTokens tokens
+    published_.push(entry);
+    return true;
+  }
+
+  fast_decoder_v2<NumTokens> &decoder_;
+  // the token taken for a message which failed to decode
+  std::size_t held_;
+  coder::spsc_ring<published_message, NumTokens> published_;
+  coder::spsc_ring<std::size_t, NumTokens> free_;
+};
+}
@@ -14,7 +14,7 @@ integer_field_instruction_base::integer_field_instruction_base(
     const value_storage &initial_storage, instruction_tag tag)
     : field_instruction(operator_id, field_type, optional, id, name, ns, tag),
       op_context_(context), initial_value_(initial_storage),
-      prev_value_(&prev_storage_),
+      prev_value_(&prev_storage_), dictionary_slot_(0),
       initial_or_default_value_(initial_storage.is_empty() ? &default_value_
                                                            : &initial_value_) {
   has_initial_value_ = !initial_storage.is_empty();
@@ -24,6 +24,7 @@ integer_field_instruction_base::integer_field_instruction_base(
     const integer_field_instruction_base &other)
     : field_instruction(other), op_context_(other.op_context_),
       initial_value_(other.initial_value_), prev_value_(&prev_storage_),
+      dictionary_slot_(0),
       initial_or_default_value_(initial_value_.is_empty() ? &default_value_
                                                           : &initial_value_) {}
 
@@ -18,7 +18,7 @@ ascii_field_instruction::ascii_field_instruction(
     : vector_field_instruction_base(operator_id, field_type, optional, id, name,
                                     ns, sizeof(char), tag),
       op_context_(context), initial_value_(initial_value.storage_),
-      prev_value_(&prev_storage_),
+      prev_value_(&prev_storage_), dictionary_slot_(0),
       initial_or_default_value_(initial_value_.is_empty() ? &default_value_
                                                           : &initial_value_) {
   has_initial_value_ = !initial_value.storage_.is_empty();
@@ -28,6 +28,7 @@ ascii_field_instruction::ascii_field_instruction(
     const ascii_field_instruction &other)
     : vector_field_instruction_base(other), op_context_(other.op_context_),
       initial_value_(other.initial_value_), prev_value_(&prev_storage_),
+      dictionary_slot_(0),
       initial_or_default_value_(initial_value_.is_empty() ? &default_value_
                                                           : &initial_value_) {}
 
@@ -35,6 +35,10 @@ public:
 
   value_storage &prev_value() { return *prev_value_; }
   const value_storage &prev_value() const { return *prev_value_; }
+  /// The index of the previous value in the dictionary of a coder, which is
+  /// used instead of prev_value() when the instruction is shared by several
+  /// coders.
+  uint32_t dictionary_slot() const { return dictionary_slot_; }
   const op_context_t *op_context() const { return op_context_; }
   void op_context(const op_context_t *v) { op_context_ = v; }
   const value_storage &initial_value() const { return initial_value_; }
@@ -56,6 +60,7 @@ protected:
   value_storage initial_value_;
   value_storage *prev_value_;
   value_storage prev_storage_;
+  uint32_t dictionary_slot_;
   const value_storage *initial_or_default_value_;
   static const value_storage default_value_;
 };
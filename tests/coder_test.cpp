@@ -24,8 +24,18 @@
 #include <mfast/xml_parser/dynamic_templates_description.h>
 #include <mfast/coder/fast_encoder.h>
 #include <mfast/coder/fast_decoder.h>
+#include <mfast/coder/fast_stream_decoder.h>
+#include <mfast/coder/fast_frame_reader.h>
+#include <mfast/coder/fast_parallel_replay.h>
+#include <mfast/coder/fast_packetizer.h>
+#include <mfast/coder/encoder/fast_ostreambuf.h>
+#include <mfast/coder/common/template_repo.h>
+#include <algorithm>
 #include <cstring>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
+#include <vector>
 
 #include "byte_stream.h"
 #include "debug_allocator.h"
@@ -72,6 +82,154 @@ class fast_coding_test_case
       return (msg == result);
     }
 
+    bool
+    trusted_decoding(const byte_stream& bytes, const message_cref& result, std::size_t frame_size)
+    {
+      // the frame is followed by the zero padding required by decode_trusted()
+      std::vector<char> buffer(bytes.data(), bytes.data()+bytes.size());
+      buffer.resize(bytes.size() + mfast::trusted_padding);
+
+      const char* first = buffer.data();
+      message_cref msg = decoder_.decode_trusted(first, first+frame_size);
+
+      return (msg == result) && (first == buffer.data()+frame_size);
+    }
+
+    bool
+    stream_decoding(const byte_stream& bytes, const message_cref* results, std::size_t count, std::size_t chunk_size)
+    {
+      fast_stream_decoder stream(decoder_);
+      const char* end = bytes.data()+bytes.size();
+      std::size_t decoded = 0;
+
+      for (const char* chunk = bytes.data(); chunk < end; chunk += chunk_size) {
+        const char* first = chunk;
+        const char* last = std::min(chunk+chunk_size, end);
+        message_cref msg;
+        decode_status_t status;
+        // reset the dictionary before the first message of each run
+        while ((status = stream.decode(first, last, msg, decoded == 0)) == decode_complete) {
+          if (decoded == count || !(msg == results[decoded]))
+            return false;
+          ++decoded;
+        }
+        if (status == decode_error || first != last)
+          return false;
+      }
+      return decoded == count && stream.buffered_size() == 0;
+    }
+
+    bool
+    batch_decoding(const byte_stream& bytes, const message_cref* results, std::size_t count, std::size_t header_size)
+    {
+      const char* first = bytes.data();
+      const char* last = first+bytes.size();
+      std::size_t decoded = 0;
+      bool matched = true;
+      std::size_t n = decoder_.decode_all(first, last, [&](const message_cref& msg) {
+        matched = matched && decoded < count && msg == results[decoded];
+        ++decoded;
+      }, true, header_size);
+
+      return matched && n == count && decoded == count && first == last;
+    }
+
+    bool
+    frame_decoding(const fast_frame_format& format, const byte_stream& bytes, const message_cref* results, std::size_t count)
+    {
+      fast_frame_reader reader(format, bytes.data(), bytes.data()+bytes.size());
+      std::size_t decoded = 0;
+      bool matched = true;
+      std::size_t n = reader.decode(decoder_, [&](const message_cref& msg, const fast_frame&) {
+        matched = matched && decoded < count && msg == results[decoded];
+        ++decoded;
+      }, true);
+
+      return matched && n == count && reader.position() == bytes.data()+bytes.size();
+    }
+
+    decode_status_t
+    stream_decoding_status(const byte_stream& bytes)
+    {
+      fast_stream_decoder stream(decoder_);
+      const char* first = bytes.data();
+      message_cref msg;
+      decode_status_t status = stream.decode(first, first+bytes.size(), msg);
+      if (status == decode_error && first != bytes.data())
+        return decode_complete;
+      return status;
+    }
+
+    void
+    journal(dictionary_journal* journal)
+    {
+      decoder_.journal(journal);
+    }
+
+    void
+    zero_copy(bool enabled)
+    {
+      decoder_.zero_copy(enabled);
+    }
+
+    void
+    debug_log(std::ostream* os)
+    {
+      decoder_.debug_log(os);
+    }
+
+    message_cref
+    decode(const char*& first, const char* last)
+    {
+      return decoder_.decode(first, last);
+    }
+
+    bool
+    round_trip(const message_cref& msg_ref, bool reset=false)
+    {
+      std::vector<char> buffer;
+      encoder_.encode(msg_ref, buffer, reset);
+
+      const char* first = buffer.data();
+      message_cref msg = decoder_.decode(first, first+buffer.size(), reset);
+      return (msg == msg_ref) && (first == buffer.data()+buffer.size());
+    }
+
+    void
+    projection(uint32_t template_id, std::initializer_list<const char*> paths)
+    {
+      decoder_.projection(template_id, paths);
+    }
+
+    message_cref
+    projected_decoding(const message_cref& msg_ref, bool reset=false)
+    {
+      std::vector<char> buffer;
+      encoder_.encode(msg_ref, buffer, reset);
+
+      const char* first = buffer.data();
+      message_cref msg = decoder_.decode(first, first+buffer.size(), reset);
+      REQUIRE(first == buffer.data()+buffer.size());
+      return msg;
+    }
+
+    void
+    sync_only(uint32_t template_id, bool enabled)
+    {
+      decoder_.sync_only(template_id, enabled);
+    }
+
+    bool
+    sync_round_trip(const message_cref& msg_ref, bool reset=false)
+    {
+      std::vector<char> buffer;
+      encoder_.encode(msg_ref, buffer, reset);
+
+      const char* first = buffer.data();
+      uint32_t template_id = decoder_.sync(first, first+buffer.size(), reset);
+      return (template_id == msg_ref.id()) && (first == buffer.data()+buffer.size());
+    }
+
     const template_instruction* template_with_id(uint32_t id)
     {
       return encoder_.template_with_id(id);
@@ -367,4 +525,1368 @@ TEST_CASE("test fast coder for a template with zero segment size", "[segment_pma
   REQUIRE(test_case.decoding("\x80\x81\x82", msg_ref));
 }
 
+TEST_CASE("test fast coder without code generation for trusted frames","[trusted_decoding_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field2\" id=\"12\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field3\" id=\"13\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg(&alloc, test_case.template_with_id(1));
+  message_mref msg_ref = msg.mref();
 
+  msg_ref[0].as(1);
+  msg_ref[1].as(2);
+  msg_ref[2].as(3);
+
+  REQUIRE(test_case.trusted_decoding("\xB8\x81\x82\x83", msg_ref, 4));
+  // the message extends beyond the end of the frame
+  REQUIRE_THROWS_AS(test_case.trusted_decoding("\xB8\x81\x82\x83", msg_ref, 3), mfast::fast_error);
+  // the truncated message runs into the padding
+  REQUIRE_THROWS_AS(test_case.trusted_decoding("\xB8\x81\x82", msg_ref, 3), mfast::fast_error);
+}
+
+TEST_CASE("test fast coder without code generation for decoding a whole buffer","[decode_all_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><delta/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg1(&alloc, test_case.template_with_id(1));
+  message_type msg2(&alloc, test_case.template_with_id(1));
+  message_type msg3(&alloc, test_case.template_with_id(1));
+
+  msg1.mref()[0].as(5);
+  msg1.mref()[1].as("ABC");
+
+  msg2.mref()[0].as(6);
+  msg2.mref()[1].as("ABC");
+
+  msg3.mref()[0].as(7);
+  msg3.mref()[1].as("XY");
+
+  const message_cref results[] = { msg1.cref(), msg2.cref(), msg3.cref() };
+
+  REQUIRE(test_case.batch_decoding("\xE0\x81\x85\x41\x42\xC3"
+                                   "\x80\x81"
+                                   "\xA0\x81\x58\xD9", results, 3, 0));
+  // each message is preceded by a two bytes header
+  REQUIRE(test_case.batch_decoding("\x00\x06\xE0\x81\x85\x41\x42\xC3"
+                                   "\x00\x02\x80\x81"
+                                   "\x00\x04\xA0\x81\x58\xD9", results, 3, 2));
+  // the dictionary is reset before the first message of a batch
+  REQUIRE(test_case.batch_decoding("\xE0\x81\x85\x41\x42\xC3", results, 1, 0));
+  // the last message is truncated
+  REQUIRE_THROWS_AS(test_case.batch_decoding("\xE0\x81\x85\x41\x42\xC3"
+                                             "\xA0\x81\x58", results, 1, 0), mfast::fast_error);
+}
+
+TEST_CASE("test splitting a buffer into frames","[frame_reader_test]")
+{
+  fast_frame frame;
+  {
+    const byte_stream bytes("\x00\x00\x00\x02\x41\x42"
+                            "\x00\x00\x00\x01\x43"
+                            "\x00\x00\x00\x03\x44");
+    fast_frame_reader reader(fast_frame_format::length_prefix(4), bytes.data(), bytes.data()+bytes.size());
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.header == bytes.data());
+    REQUIRE(byte_stream(frame.payload, frame.payload_size) == byte_stream("\x41\x42"));
+    REQUIRE(reader.next(frame));
+    REQUIRE(byte_stream(frame.payload, frame.payload_size) == byte_stream("\x43"));
+    // the last frame is incomplete
+    REQUIRE(!reader.next(frame));
+    REQUIRE(reader.position() == bytes.data()+11);
+  }
+  {
+    const byte_stream bytes("\x02\x00\x41\x42");
+    fast_frame_reader reader(fast_frame_format::length_prefix(2, false), bytes.data(), bytes.data()+bytes.size());
+    REQUIRE(reader.next(frame));
+    REQUIRE(byte_stream(frame.payload, frame.payload_size) == byte_stream("\x41\x42"));
+    REQUIRE(!reader.next(frame));
+  }
+  {
+    const byte_stream bytes("\x82\x41\x42"
+                            "\x80"
+                            "\x85\x43");
+    fast_frame_reader reader(fast_frame_format::block_length(), bytes.data(), bytes.data()+bytes.size());
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.header_size == 1);
+    REQUIRE(byte_stream(frame.payload, frame.payload_size) == byte_stream("\x41\x42"));
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.payload_size == 0);
+    REQUIRE(!reader.next(frame));
+    REQUIRE(reader.position() == bytes.data()+4);
+  }
+  {
+    // the block length does not fit in uInt32
+    const byte_stream bytes("\x10\x00\x00\x00\x00\x80");
+    fast_frame_reader reader(fast_frame_format::block_length(), bytes.data(), bytes.data()+bytes.size());
+    REQUIRE_THROWS_AS(reader.next(frame), mfast::fast_error);
+  }
+  {
+    const byte_stream bytes("\x00\x07\xC1"
+                            "\x00\x08\xC2"
+                            "\x00\x0A\xC3");
+    fast_frame_reader reader(fast_frame_format::sequence_header(2), bytes.data(), bytes.data()+bytes.size());
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.sequence == 7);
+    REQUIRE(!frame.gap);
+    REQUIRE(frame.payload_size == 7);
+    reader.consume(frame.payload+1);
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.sequence == 8);
+    REQUIRE(!frame.gap);
+    reader.consume(frame.payload+1);
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.sequence == 10);
+    REQUIRE(frame.gap);
+    reader.consume(frame.payload+1);
+    REQUIRE(!reader.next(frame));
+    REQUIRE(reader.next_sequence() == 11);
+  }
+}
+
+TEST_CASE("test fast coder without code generation for framed messages","[frame_reader_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><delta/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg1(&alloc, test_case.template_with_id(1));
+  message_type msg2(&alloc, test_case.template_with_id(1));
+  message_type msg3(&alloc, test_case.template_with_id(1));
+  message_type msg4(&alloc, test_case.template_with_id(1));
+
+  msg1.mref()[0].as(5);
+  msg1.mref()[1].as("ABC");
+
+  msg2.mref()[0].as(6);
+  msg2.mref()[1].as("ABC");
+
+  msg3.mref()[0].as(7);
+  msg3.mref()[1].as("XY");
+
+  // the delta is applied to a reset dictionary
+  msg4.mref()[0].as(1);
+  msg4.mref()[1].as("XY");
+
+  const message_cref results[] = { msg1.cref(), msg2.cref(), msg3.cref() };
+
+  // the first frame carries two messages
+  REQUIRE(test_case.frame_decoding(fast_frame_format::length_prefix(2),
+                                   "\x00\x08\xE0\x81\x85\x41\x42\xC3\x80\x81"
+                                   "\x00\x04\xA0\x81\x58\xD9", results, 3));
+  REQUIRE(test_case.frame_decoding(fast_frame_format::block_length(),
+                                   "\x86\xE0\x81\x85\x41\x42\xC3"
+                                   "\x82\x80\x81"
+                                   "\x84\xA0\x81\x58\xD9", results, 3));
+  REQUIRE(test_case.frame_decoding(fast_frame_format::sequence_header(2),
+                                   "\x00\x01\xE0\x81\x85\x41\x42\xC3"
+                                   "\x00\x02\x80\x81"
+                                   "\x00\x03\xA0\x81\x58\xD9", results, 3));
+
+  // the dictionary is reset after the gap in the sequence numbers
+  const message_cref gap_results[] = { msg1.cref(), msg2.cref(), msg4.cref() };
+  REQUIRE(test_case.frame_decoding(fast_frame_format::sequence_header(2),
+                                   "\x00\x01\xE0\x81\x85\x41\x42\xC3"
+                                   "\x00\x02\x80\x81"
+                                   "\x00\x04\xA0\x81\x58\xD9", gap_results, 3));
+}
+
+TEST_CASE("test fast coder without code generation for streams split into chunks","[stream_decoding_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><delta/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<uInt32 name=\"field3\" id=\"13\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg1(&alloc, test_case.template_with_id(1));
+  message_type msg2(&alloc, test_case.template_with_id(1));
+  message_type msg3(&alloc, test_case.template_with_id(1));
+  message_type msg4(&alloc, test_case.template_with_id(1));
+
+  msg1.mref()[0].as(5);
+  msg1.mref()[1].as("ABC");
+  msg1.mref()[2].as(1);
+
+  msg2.mref()[0].as(6);
+  msg2.mref()[1].as("ABC");
+  msg2.mref()[2].as(1);
+
+  msg3.mref()[0].as(7);
+  msg3.mref()[1].as("XY");
+  msg3.mref()[2].as(1);
+
+  msg4.mref()[0].as(8);
+  msg4.mref()[1].as("XY");
+  msg4.mref()[2].as(1);
+
+  const message_cref results[] = { msg1.cref(), msg2.cref(), msg3.cref(), msg4.cref() };
+  // the delta field comes first, so decoding it twice after a split message
+  // would accumulate its value in the dictionary
+  const byte_stream bytes("\xF0\x81\x85\x41\x42\xC3\x81"
+                          "\x80\x81"
+                          "\xA0\x81\x58\xD9"
+                          "\x80\x81");
+
+  for (std::size_t chunk_size = 1; chunk_size <= bytes.size(); ++chunk_size) {
+    INFO( "chunk size = " << chunk_size );
+    REQUIRE(test_case.stream_decoding(bytes, results, 4, chunk_size));
+  }
+
+  REQUIRE(test_case.stream_decoding_status("\xF0\x81\x85") == decode_need_more);
+  // unknown template id
+  REQUIRE(test_case.stream_decoding_status("\xC0\x82\x81") == decode_error);
+}
+
+TEST_CASE("test fast coder without code generation for rolling back failed messages","[dictionary_journal_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<string name=\"field3\" id=\"13\"><delta/></string>\n"
+    "<uInt32 name=\"field4\" id=\"14\" presence=\"optional\"><copy key=\"shared\"/></uInt32>\n"
+    "<uInt32 name=\"field5\" id=\"15\"><copy key=\"shared\"/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  dictionary_journal journal;
+  test_case.journal(&journal);
+
+  debug_allocator alloc;
+  message_type msg(&alloc, test_case.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+
+  msg_ref[0].as(1);
+  msg_ref[1].as("AB");
+  msg_ref[2].as("XY");
+  msg_ref[3].as(2);
+  msg_ref[4].as(3);
+
+  REQUIRE(test_case.decoding("\xFC\x81\x81\x41\xC2\x80\x58\xD9\x83\x83", msg_ref));
+
+  // every field takes its previous value
+  msg_ref[3].as(3);
+  const byte_stream unchanged("\x80\x80\x80");
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // D7: the subtraction length of field3 exceeds its base value, after field2
+  // was decoded into the buffer its previous value refers to
+  REQUIRE_THROWS_AS(test_case.decoding("\xB0\x85\x43\xC4\x83", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // D6: field4 sets the shared previous value to empty for the mandatory field5
+  REQUIRE_THROWS_AS(test_case.decoding("\xB8\x85\x43\xC4\x80\xDA\x80", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // buffer underflow
+  REQUIRE_THROWS_AS(test_case.decoding("\xB8\x85\x43\xC4\x80", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // D9: unknown template id
+  REQUIRE_THROWS_AS(test_case.decoding("\xC0\x82\x85", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // a journal too small for the message resets the dictionary instead
+  dictionary_journal small_journal(2);
+  test_case.journal(&small_journal);
+  REQUIRE_THROWS_AS(test_case.decoding("\xB8\x85\x43\xC4\x80\xDA\x80", msg_ref), mfast::fast_error);
+  REQUIRE(small_journal.overflow());
+  REQUIRE_THROWS_AS(test_case.decoding(unchanged, msg_ref), mfast::fast_error);
+}
+
+TEST_CASE("test fast coder without code generation for zero copy decoding","[zero_copy_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"></string>\n"
+    "<string name=\"field3\" id=\"13\" charset=\"unicode\"></string>\n"
+    "<byteVector name=\"field4\" id=\"14\"></byteVector>\n"
+    "<string name=\"field5\" id=\"15\"><copy/></string>\n"
+    "<string name=\"field6\" id=\"16\" presence=\"optional\"></string>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg(&alloc, test_case.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+
+  const unsigned char bytes[] = { 0x01, 0xFF };
+  msg_ref[0].as(5);
+  msg_ref[1].as("ABC");
+  msg_ref[2].as("XY");
+  byte_vector_mref(msg_ref[3]).assign(bytes, bytes+2);
+  msg_ref[4].as("DE");
+  msg_ref[5].as("Z");
+
+  const byte_stream encoded("\xF0\x81\x85\x41\x42\xC3\x82\x58\x59\x82\x01\xFF\x44\xC5\xDA");
+  test_case.zero_copy(true);
+
+  // the input is never modified; it may be read only and decoded again
+  static const char input[] = "\xF0\x81\x85\x41\x42\xC3\x82\x58\x59\x82\x01\xFF\x44\xC5\xDA";
+  const char* last = input + sizeof(input) - 1;
+  for (int i = 0; i < 2; ++i) {
+    const char* first = input;
+    message_cref result = test_case.decode(first, last);
+    REQUIRE(result == msg_ref);
+    REQUIRE(first == last);
+
+    // the byte vectors without operator refer to the input buffer
+    REQUIRE(byte_vector_cref(result[3]).data() == reinterpret_cast<const unsigned char*>(input+10));
+    // the strings are copied into the message
+    REQUIRE(ascii_string_cref(result[1]).data() != input+3);
+    REQUIRE(unicode_string_cref(result[2]).data() != input+7);
+    REQUIRE(ascii_string_cref(result[5]).data() != input+14);
+    REQUIRE(ascii_string_cref(result[4]).data() != input+12);
+
+    ascii_string_cref field2(result[1]);
+    ascii_string_cref field6(result[5]);
+    REQUIRE(field2.data()[2] == 'C');
+    REQUIRE(field2.value() == "ABC");
+    REQUIRE(field6.value() == "Z");
+    REQUIRE(field2.value() != field6.value());
+    REQUIRE(std::strcmp(field2.c_str(), field6.c_str()) < 0);
+    REQUIRE(std::strcmp(unicode_string_cref(result[2]).c_str(), "XY") == 0);
+  }
+  REQUIRE(std::equal(input, last, encoded.data()));
+
+  // the empty strings are null terminated
+  static const char empty[] = "\xF0\x81\x85\x80\x80\x80\x44\xC5\x00\x80";
+  const char* first = empty;
+  message_cref result = test_case.decode(first, empty + sizeof(empty) - 1);
+  REQUIRE(first == empty + sizeof(empty) - 1);
+  REQUIRE(std::strlen(ascii_string_cref(result[1]).c_str()) == 0U);
+  REQUIRE(std::strlen(unicode_string_cref(result[2]).c_str()) == 0U);
+  REQUIRE(byte_vector_cref(result[3]).size() == 0U);
+  REQUIRE(std::strlen(ascii_string_cref(result[5]).c_str()) == 0U);
+
+  test_case.zero_copy(false);
+  std::vector<char> buffer(encoded.data(), encoded.data()+encoded.size());
+  first = buffer.data();
+  message_cref copied = test_case.decode(first, first+buffer.size());
+  REQUIRE(copied == msg_ref);
+  REQUIRE(byte_vector_cref(copied[3]).data() != reinterpret_cast<const unsigned char*>(buffer.data()+10));
+  REQUIRE(std::equal(buffer.begin(), buffer.end(), encoded.data()));
+}
+
+TEST_CASE("test fast coder without code generation for zero copy decoding of many byte vectors","[zero_copy_test]")
+{
+  const char* xml_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<sequence name=\"sequence1\">\n"
+    "<byteVector name=\"field1\" id=\"11\"></byteVector>\n"
+    "</sequence>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description description(xml_content);
+  const templates_description* descriptions[] = { &description };
+
+  debug_allocator alloc;
+  fast_encoder encoder(&alloc);
+  encoder.include(descriptions);
+  fast_decoder decoder(&alloc);
+  decoder.include(descriptions);
+  decoder.zero_copy(true);
+
+  message_type msg(&alloc, encoder.template_with_id(1));
+  sequence_mref seq(msg.mref()[0]);
+  seq.resize(100);
+  for (std::size_t i = 0; i < seq.size(); ++i) {
+    std::string value = std::to_string(i);
+    byte_vector_mref(seq[i][0]).assign(value.begin(), value.end());
+  }
+  std::vector<char> stream;
+  encoder.encode(msg.cref(), stream, true);
+
+  // every byte vector of a message refers to the input
+  const char* first = stream.data();
+  message_cref result = decoder.decode(first, first+stream.size(), true);
+  REQUIRE(result == msg.cref());
+  sequence_cref result_seq(result[0]);
+  REQUIRE(result_seq.size() == 100U);
+  for (std::size_t i = 0; i < result_seq.size(); ++i) {
+    byte_vector_cref field(result_seq[i][0]);
+    const char* data = reinterpret_cast<const char*>(field.data());
+    REQUIRE(data > stream.data());
+    REQUIRE(data < stream.data()+stream.size());
+    REQUIRE(std::string(data, field.size()) == std::to_string(i));
+  }
+}
+
+TEST_CASE("test fast coder without code generation for nested fields with dictionary operators","[decode_plan_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<decimal name=\"field2\" id=\"12\">"
+    "<exponent><copy value=\"-2\"/></exponent><mantissa><delta/></mantissa>"
+    "</decimal>\n"
+    "<group name=\"group1\">"
+    "<string name=\"field3\" id=\"13\"><default value=\"A\"/></string>\n"
+    "<uInt64 name=\"field4\" id=\"14\"><increment/></uInt64>\n"
+    "</group>"
+    "<sequence name=\"sequence1\">"
+    "<int32 name=\"field5\" id=\"15\"><delta/></int32>\n"
+    "<decimal name=\"field6\" id=\"16\" presence=\"optional\"><copy/></decimal>\n"
+    "</sequence>"
+    "<group name=\"group2\" presence=\"optional\">"
+    "<uInt32 name=\"field7\" id=\"17\"/>\n"
+    "</group>"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg(&alloc, test_case.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+
+  msg_ref[0].as(1);
+  decimal_mref(msg_ref[1]).as(12345, -2);
+  group_mref grp(msg_ref[2]);
+  grp[0].as("B");
+  grp[1].as(7);
+  sequence_mref seq(msg_ref[3]);
+  seq.resize(2);
+  seq[0][0].as(-5);
+  decimal_mref(seq[0][1]).as(15, 1);
+  seq[1][0].as(100);
+  decimal_mref(seq[1][1]).as(15, 1);
+  msg_ref[4].omit();
+
+  REQUIRE(test_case.round_trip(msg_ref, true));
+
+  // the second message is decoded from the dictionary values of the first
+  decimal_mref(msg_ref[1]).as(12340, -2);
+  grp[0].as("A");
+  grp[1].as(8);
+  seq.resize(1);
+  seq[0][0].as(-4);
+  decimal_mref(seq[0][1]).as(15, 1);
+  group_mref(msg_ref[4])[0].as(3);
+
+  REQUIRE(test_case.round_trip(msg_ref));
+
+  // a debug log does not change how the fields are decoded
+  std::ostringstream log;
+  test_case.debug_log(&log);
+  grp[1].as(9);
+  seq[0][0].as(-3);
+
+  REQUIRE(test_case.round_trip(msg_ref));
+#ifndef NDEBUG
+  REQUIRE(log.str().find("decoded field4 = 9") != std::string::npos);
+#endif
+  test_case.debug_log(nullptr);
+}
+
+TEST_CASE("test fast coder without code generation for projected fields","[projection_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"/>\n"
+    "<int64 name=\"field3\" id=\"13\" presence=\"optional\"><default/></int64>\n"
+    "<decimal name=\"field4\" id=\"14\"/>\n"
+    "<sequence name=\"sequence1\">"
+    "<int32 name=\"field5\" id=\"15\"><delta/></int32>\n"
+    "<byteVector name=\"field6\" id=\"16\"/>\n"
+    "</sequence>"
+    "<group name=\"group1\">"
+    "<string name=\"field7\" id=\"17\"/>\n"
+    "<uInt32 name=\"field8\" id=\"18\" presence=\"optional\"><constant value=\"5\"/></uInt32>\n"
+    "<uInt32 name=\"field9\" id=\"19\"><copy/></uInt32>\n"
+    "</group>"
+    "</template>\n"
+    "</templates>\n");
+
+  REQUIRE_THROWS_AS(test_case.projection(1, {"group1.field0"}), fast_static_error);
+  REQUIRE_THROWS_AS(test_case.projection(1, {"field4.field5"}), fast_static_error);
+  REQUIRE_THROWS_AS(test_case.projection(2, {"field4"}), fast_dynamic_error);
+  test_case.projection(1, {"field4", "group1.19"});
+
+  debug_allocator alloc;
+  message_type msg(&alloc, test_case.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+
+  msg_ref[0].as(1);
+  msg_ref[1].as("ABC");
+  msg_ref[2].as(-7);
+  decimal_mref(msg_ref[3]).as(12345, -2);
+  sequence_mref seq(msg_ref[4]);
+  seq.resize(2);
+  seq[0][0].as(10);
+  const unsigned char bytes[] = { 0x01, 0x02, 0x03 };
+  byte_vector_mref(seq[0][1]).assign(bytes, bytes+3);
+  seq[1][0].as(20);
+  byte_vector_mref(seq[1][1]).assign(bytes, bytes+1);
+  group_mref grp(msg_ref[5]);
+  grp[0].as("DEF");
+  grp[1].as(5);
+  grp[2].as(9);
+
+  message_cref first = test_case.projected_decoding(msg_ref, true);
+  REQUIRE(first[3] == msg_ref[3]);
+  REQUIRE(group_cref(first[5])[2] == grp[2]);
+  REQUIRE(sequence_cref(first[4]).size() == 0);
+
+  // the second message is decoded from the dictionary values of the skipped
+  // fields
+  msg_ref[1].as("GH");
+  msg_ref[2].as(4);
+  decimal_mref(msg_ref[3]).as(-3, 1);
+  seq.resize(1);
+  seq[0][0].as(25);
+  grp[0].as("IJKL");
+
+  message_cref second = test_case.projected_decoding(msg_ref);
+  REQUIRE(second[0] == msg_ref[0]);
+  REQUIRE(second[3] == msg_ref[3]);
+  REQUIRE(group_cref(second[5])[2] == grp[2]);
+
+  // a path naming a group selects all of its fields
+  test_case.projection(1, {"group1"});
+  grp[2].as(10);
+  message_cref third = test_case.projected_decoding(msg_ref);
+  REQUIRE(third[0] == msg_ref[0]);
+  REQUIRE(third[5] == msg_ref[5]);
+}
+
+TEST_CASE("test fast coder without code generation for sync only templates","[sync_only_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"/>\n"
+    "<int64 name=\"field3\" id=\"13\"><delta/></int64>\n"
+    "<sequence name=\"sequence1\">"
+    "<string name=\"field4\" id=\"14\"><copy/></string>\n"
+    "<int32 name=\"field5\" id=\"15\"><default value=\"1\"/></int32>\n"
+    "</sequence>"
+    "</template>\n"
+    "<template name=\"Heartbeat\" id=\"2\">\n"
+    "<uInt32 name=\"field6\" id=\"16\"><increment/></uInt32>\n"
+    "<string name=\"field7\" id=\"17\"/>\n"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg(&alloc, test_case.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+  message_type heartbeat(&alloc, test_case.template_with_id(2));
+  message_mref heartbeat_ref = heartbeat.mref();
+
+  msg_ref[0].as(1);
+  msg_ref[1].as("ABC");
+  msg_ref[2].as(100);
+  sequence_mref seq(msg_ref[3]);
+  seq.resize(2);
+  seq[0][0].as("DEF");
+  seq[0][1].as(2);
+  seq[1][0].as("GHI");
+  seq[1][1].as(1);
+
+  REQUIRE(test_case.sync_round_trip(msg_ref, true));
+
+  // the second message is decoded from the dictionary values of the first
+  msg_ref[1].as("JK");
+  msg_ref[2].as(90);
+  seq.resize(1);
+  seq[0][1].as(3);
+  REQUIRE(test_case.round_trip(msg_ref));
+
+  test_case.sync_only(2, true);
+  heartbeat_ref[0].as(7);
+  heartbeat_ref[1].as("LMN");
+  message_cref synced = test_case.projected_decoding(heartbeat_ref);
+  REQUIRE(synced.id() == 2U);
+
+  msg_ref[2].as(95);
+  REQUIRE(test_case.round_trip(msg_ref));
+
+  heartbeat_ref[0].as(8);
+  REQUIRE(test_case.projected_decoding(heartbeat_ref).id() == 2U);
+
+  test_case.sync_only(2, false);
+  heartbeat_ref[0].as(9);
+  REQUIRE(test_case.round_trip(heartbeat_ref));
+}
+
+TEST_CASE("test fast coder without code generation for projected templates referred to by dynamic templateref","[projection_templateref_test]")
+{
+  fast_coding_test_case test_case (
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Nested\" id=\"01\">\n"
+    "<uInt32 name=\"field2\" id=\"12\"/>\n"
+    "<string name=\"field3\" id=\"13\"/>\n"
+    "</template>"
+    "<template name=\"Test\" id=\"02\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<group name=\"nested\">"
+    "  <templateRef/>"
+    "</group>"
+    "</template>\n"
+    "</templates>\n");
+
+  debug_allocator alloc;
+  message_type msg(&alloc, test_case.template_with_id(2));
+  message_mref msg_ref = msg.mref();
+
+  msg_ref[0].as(1);
+  nested_message_mref nested(static_cast<group_mref>(msg_ref[1])[0]);
+  message_mref target = nested.rebind(test_case.template_with_id(1));
+  target[0].as(2);
+  target[1].as("ABC");
+
+  // the projection of a template does not apply where it is referred to by
+  // another message, even when set again
+  test_case.projection(1, {"field3"});
+  test_case.projection(1, {});
+  REQUIRE(test_case.round_trip(msg_ref, true));
+
+  test_case.sync_only(1, true);
+  target[1].as("DEF");
+  REQUIRE(test_case.round_trip(msg_ref));
+}
+
+TEST_CASE("test fast coder without code generation for decoders sharing instructions","[template_set_test]")
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<int64 name=\"field3\" id=\"13\"><delta/></int64>\n"
+    "</template>\n"
+    "</templates>\n");
+  const templates_description* descriptions[] = { &description };
+  std::shared_ptr<const template_set> templates =
+    std::make_shared<template_set>(descriptions, 1);
+  const template_instruction* inst = templates->find(1);
+  REQUIRE(inst != nullptr);
+
+  debug_allocator alloc;
+  fast_encoder encoder_a(&alloc), encoder_b(&alloc);
+  encoder_a.include(descriptions);
+  encoder_b.include(descriptions);
+  fast_decoder decoder_a(&alloc), decoder_b(&alloc);
+  decoder_a.include(templates);
+  decoder_b.include(templates);
+
+  message_type msg_a(&alloc, inst);
+  message_type msg_b(&alloc, inst);
+  message_mref ref_a = msg_a.mref();
+  message_mref ref_b = msg_b.mref();
+
+  char buffer[128];
+  auto round_trip = [&](fast_encoder& encoder, fast_decoder& decoder, const message_cref& msg, bool reset) {
+    std::size_t size = encoder.encode(msg, buffer, sizeof(buffer), reset);
+    const char* first = buffer;
+    message_cref result = decoder.decode(first, buffer+size, reset);
+    return result == msg && result.instruction() == inst && first == buffer+size;
+  };
+
+  ref_a[0].as(1);
+  ref_a[1].as("ABC");
+  ref_a[2].as(100);
+  ref_b[0].as(7);
+  ref_b[1].as("XYZ");
+  ref_b[2].as(-3);
+
+  REQUIRE(round_trip(encoder_a, decoder_a, ref_a, true));
+  REQUIRE(round_trip(encoder_b, decoder_b, ref_b, true));
+
+  // the values copied from the dictionary differ between the decoders
+  ref_a[2].as(105);
+  ref_b[2].as(0);
+  REQUIRE(round_trip(encoder_a, decoder_a, ref_a, false));
+  REQUIRE(round_trip(encoder_b, decoder_b, ref_b, false));
+
+  ref_a[1].as("DE");
+  REQUIRE(round_trip(encoder_a, decoder_a, ref_a, false));
+  REQUIRE(round_trip(encoder_b, decoder_b, ref_b, false));
+}
+
+TEST_CASE("test fast coder without code generation for restoring saved dictionaries","[dictionary_snapshot_test]")
+{
+  const char* xml_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<int64 name=\"field3\" id=\"13\"><delta/></int64>\n"
+    "<byteVector name=\"field4\" id=\"14\" presence=\"optional\"><tail/></byteVector>\n"
+    "</template>\n"
+    "<template name=\"Other\" id=\"2\">\n"
+    "<uInt32 name=\"field1\" id=\"21\"><increment/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description description(xml_content);
+  const templates_description* descriptions[] = { &description };
+
+  debug_allocator alloc;
+  fast_encoder primary_encoder(&alloc), standby_encoder(&alloc);
+  primary_encoder.include(descriptions);
+  standby_encoder.include(descriptions);
+  fast_decoder primary_decoder(&alloc), standby_decoder(&alloc);
+  primary_decoder.include(descriptions);
+  standby_decoder.include(descriptions);
+
+  message_type msg(&alloc, primary_encoder.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+  msg_ref[0].as(1);
+  msg_ref[1].as("ABC");
+  msg_ref[2].as(100);
+  const unsigned char bytes[] = "XYZW";
+  byte_vector_mref(msg_ref[3]).assign(bytes, bytes+3);
+
+  std::vector<char> buffer;
+  primary_encoder.encode(msg_ref, buffer, true);
+  const char* first = buffer.data();
+  REQUIRE(primary_decoder.decode(first, buffer.data()+buffer.size(), true) == msg_ref);
+
+  std::vector<char> encoder_state, decoder_state;
+  primary_encoder.save_dictionary(encoder_state);
+  primary_decoder.save_dictionary(decoder_state);
+  standby_encoder.restore_dictionary(encoder_state);
+  standby_decoder.restore_dictionary(decoder_state);
+
+  // the standby coders take over without a reset; the saved contents remain
+  // valid after the primary changes them
+  msg_ref[2].as(105);
+  std::vector<char> primary_buffer, standby_buffer;
+  primary_encoder.encode(msg_ref, primary_buffer);
+  standby_encoder.encode(msg_ref, standby_buffer);
+  REQUIRE(primary_buffer == standby_buffer);
+  // only the delta of field3 is encoded, without the template id
+  REQUIRE(primary_buffer.size() == 2);
+
+  first = primary_buffer.data();
+  REQUIRE(standby_decoder.decode(first, primary_buffer.data()+primary_buffer.size()) == msg_ref);
+
+  msg_ref[1].as("DE");
+  byte_vector_mref(msg_ref[3]).assign(bytes+1, bytes+4);
+  buffer.clear();
+  standby_encoder.encode(msg_ref, buffer);
+  first = buffer.data();
+  REQUIRE(standby_decoder.decode(first, buffer.data()+buffer.size()) == msg_ref);
+
+  // a truncated snapshot leaves the dictionary unchanged
+  std::vector<char> truncated(decoder_state.begin(), decoder_state.end()-1);
+  REQUIRE_THROWS_AS(standby_decoder.restore_dictionary(truncated), coder::dictionary_snapshot_error);
+  msg_ref[2].as(110);
+  buffer.clear();
+  standby_encoder.encode(msg_ref, buffer);
+  REQUIRE(buffer.size() == 2);
+  first = buffer.data();
+  REQUIRE(standby_decoder.decode(first, buffer.data()+buffer.size()) == msg_ref);
+
+  // a snapshot of other templates is rejected
+  dynamic_templates_description other_description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<int32 name=\"field3\" id=\"13\"><delta/></int32>\n"
+    "<byteVector name=\"field4\" id=\"14\" presence=\"optional\"><tail/></byteVector>\n"
+    "</template>\n"
+    "</templates>\n");
+  fast_decoder other_decoder(&alloc);
+  other_decoder.include({ &other_description });
+  REQUIRE_THROWS_AS(other_decoder.restore_dictionary(decoder_state), coder::dictionary_snapshot_error);
+}
+
+TEST_CASE("test fast coder without code generation for replaying a capture in parallel","[parallel_replay_test]")
+{
+  dynamic_templates_description description(
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<int64 name=\"field2\" id=\"12\"><delta/></int64>\n"
+    "</template>\n"
+    "<template name=\"Reset\" id=\"2\" reset=\"yes\">\n"
+    "</template>\n"
+    "</templates>\n");
+  const templates_description* descriptions[] = { &description };
+  std::shared_ptr<const template_set> templates =
+    std::make_shared<template_set>(descriptions, 1);
+
+  // frames with a 4 byte little endian length, a reset message every 5 frames
+  debug_allocator alloc;
+  fast_encoder encoder(&alloc);
+  encoder.include(descriptions);
+  message_type msg(&alloc, templates->find(1));
+  message_type reset(&alloc, templates->find(2));
+  message_mref msg_ref = msg.mref();
+  std::vector<char> capture;
+  std::vector<std::size_t> offsets;
+  for (uint32_t i = 0; i < 40; ++i) {
+    offsets.push_back(capture.size());
+    std::vector<char> payload;
+    if (i % 5 == 0) {
+      encoder.encode(reset.cref(), payload);
+    } else {
+      msg_ref[0].as(i / 3);
+      msg_ref[1].as(int64_t(i) * 100);
+      encoder.encode(msg_ref, payload);
+    }
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    for (int b = 0; b < 4; ++b)
+      capture.push_back(static_cast<char>(length >> (8*b)));
+    capture.insert(capture.end(), payload.begin(), payload.end());
+  }
+  // an incomplete frame
+  capture.push_back('\x05');
+
+  fast_frame_format format = fast_frame_format::length_prefix(4, false);
+  const char* first = capture.data();
+  const char* last = first + capture.size();
+
+  auto transform = [](const message_cref& msg, const fast_frame&) -> uint64_t {
+    if (msg.id() == 1)
+      return uint64_t(uint32_cref(msg[0]).value()) * 1000000 + int64_cref(msg[1]).value();
+    return 0;
+  };
+
+  fast_decoder decoder(&alloc);
+  decoder.include(templates);
+  fast_frame_reader reader(format, first, last);
+  std::vector<uint64_t> expected;
+  reader.decode(decoder, [&](const message_cref& msg, const fast_frame& frame) {
+    expected.push_back(transform(msg, frame));
+  }, true);
+  REQUIRE(expected.size() == 40);
+
+  fast_parallel_replay replay(templates, format, 3);
+  replay.min_segment_size(0);
+  std::vector<uint64_t> results;
+  std::size_t count = replay.decode(first, last, transform, [&](uint64_t value) {
+    results.push_back(value);
+  });
+  REQUIRE(count == 40);
+  REQUIRE(replay.segment_count() == 8);
+  REQUIRE(replay.position() == reader.position());
+  REQUIRE(results == expected);
+
+  // the segments are no smaller than the minimum size
+  replay.min_segment_size(capture.size()/2);
+  results.clear();
+  REQUIRE(replay.decode(first, last, transform, [&](uint64_t value) {
+    results.push_back(value);
+  }) == 40);
+  REQUIRE(replay.segment_count() == 2);
+  REQUIRE(results == expected);
+
+  // a message which fails to decode is reported after the ones before it;
+  // the unknown template id of the 11th message does not split the capture
+  capture[offsets[10]+5] = '\x83';
+  replay.min_segment_size(0);
+  results.clear();
+  REQUIRE_THROWS_AS(replay.decode(first, last, transform, [&](uint64_t value) {
+    results.push_back(value);
+  }), mfast::fast_error);
+  REQUIRE(replay.segment_count() == 7);
+  REQUIRE(results.size() == 10);
+  REQUIRE(std::equal(results.begin(), results.end(), expected.begin()));
+}
+
+TEST_CASE("test fast coder without code generation for decoding into message buffers","[decode_into_test]")
+{
+  const char* xml_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><increment/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<sequence name=\"sequence1\">\n"
+    "<uInt32 name=\"field3\" id=\"13\"><delta/></uInt32>\n"
+    "</sequence>\n"
+    "</template>\n"
+    "<template name=\"Other\" id=\"2\">\n"
+    "<uInt32 name=\"field4\" id=\"21\"></uInt32>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description description(xml_content);
+  const templates_description* descriptions[] = { &description };
+
+  debug_allocator alloc;
+  fast_encoder encoder(&alloc);
+  encoder.include(descriptions);
+  fast_decoder decoder(&alloc);
+  decoder.include(descriptions);
+
+  // the encoder refers to the strings of the messages as previous values
+  message_type msg1(&alloc, encoder.template_with_id(1));
+  message_type msg2(&alloc, encoder.template_with_id(1));
+  message_type msg3(&alloc, encoder.template_with_id(1));
+  message_type* messages[] = { &msg1, &msg2, &msg3 };
+  std::vector<char> stream;
+  for (uint32_t i = 1; i <= 3; ++i) {
+    message_mref msg_ref = messages[i-1]->mref();
+    msg_ref[0].as(i);
+    msg_ref[1].as(i < 3 ? "ABC" : "DEF");
+    sequence_mref seq(msg_ref[2]);
+    seq.resize(i);
+    for (uint32_t j = 0; j < i; ++j)
+      seq[j][0].as(i*10 + j);
+    encoder.encode(msg_ref, stream, i == 1);
+  }
+
+  // the messages of a pool stay valid while the decoder goes on
+  debug_allocator target_alloc;
+  message_type target1(&target_alloc, encoder.template_with_id(1));
+  message_type target2(&target_alloc, encoder.template_with_id(1));
+  message_type other(&target_alloc, encoder.template_with_id(2));
+
+  const char* first = stream.data();
+  const char* last = first + stream.size();
+  decoder.decode_into(target1.mref(), first, last, true);
+  decoder.decode_into(target2.mref(), first, last);
+  REQUIRE(uint32_cref(target1.cref()[0]).value() == 1U);
+  REQUIRE(uint32_cref(target2.cref()[0]).value() == 2U);
+  REQUIRE(sequence_cref(target2.cref()[2]).size() == 2U);
+  REQUIRE(uint32_cref(sequence_cref(target2.cref()[2])[1][0]).value() == 21U);
+
+  // a message of another template is not decoded
+  const char* pending = first;
+  REQUIRE_THROWS_AS(decoder.decode_into(other.mref(), first, last), coder::template_mismatch_error);
+  REQUIRE(first == pending);
+
+  decoder.decode_into(target1.mref(), first, last);
+  REQUIRE(first == last);
+  REQUIRE(target1.cref() == msg3.cref());
+  REQUIRE(uint32_cref(target2.cref()[0]).value() == 2U);
+  REQUIRE(std::strcmp(ascii_string_cref(target2.cref()[1]).c_str(), "ABC") == 0);
+
+  // neither is a message of a template with the same id and number of fields
+  // but fields of other types, at the top level or in a sequence
+  const char* mismatched_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><increment/></uInt32>\n"
+    "<uInt32 name=\"field2\" id=\"12\"><copy/></uInt32>\n"
+    "<sequence name=\"sequence1\">\n"
+    "<uInt32 name=\"field3\" id=\"13\"><delta/></uInt32>\n"
+    "</sequence>\n"
+    "</template>\n"
+    "<template name=\"Nested\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><increment/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "<sequence name=\"sequence1\">\n"
+    "<string name=\"field3\" id=\"13\"><delta/></string>\n"
+    "</sequence>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description mismatched(mismatched_content);
+  REQUIRE(mismatched.size() == 2U);
+  for (std::size_t i = 0; i < mismatched.size(); ++i) {
+    message_type mismatched_target(&target_alloc, mismatched[i]);
+    first = stream.data();
+    REQUIRE_THROWS_AS(decoder.decode_into(mismatched_target.mref(), first, last, true), coder::template_mismatch_error);
+    REQUIRE(first == stream.data());
+  }
+
+  // the dictionary keeps copies of the strings decoded into a target, which
+  // may then be modified or destroyed, even once a message is rolled back
+  fast_encoder copy_encoder(&alloc), change_encoder(&alloc);
+  copy_encoder.include(descriptions);
+  change_encoder.include(descriptions);
+  message_type msg4(&alloc, encoder.template_with_id(1));
+  message_mref msg4_ref = msg4.mref();
+  msg4_ref[0].as(4);
+  msg4_ref[1].as("GHI");
+  std::vector<char> copy_stream, change_stream;
+  copy_encoder.encode(msg4_ref, copy_stream, true);
+  change_encoder.encode(msg4_ref, change_stream, true);
+  std::size_t msg4_size = copy_stream.size();
+  msg4_ref[0].as(5);
+  copy_encoder.encode(msg4_ref, copy_stream);
+  msg4_ref[1].as("JKL");
+  change_encoder.encode(msg4_ref, change_stream);
+  msg4_ref[1].as("GHI");
+
+  dictionary_journal journal;
+  decoder.journal(&journal);
+  {
+    message_type transient1(&target_alloc, encoder.template_with_id(1));
+    message_type transient2(&target_alloc, encoder.template_with_id(1));
+    first = copy_stream.data();
+    decoder.decode_into(transient1.mref(), first, first + msg4_size, true);
+    first = change_stream.data() + msg4_size;
+    last = change_stream.data() + change_stream.size() - 1;
+    REQUIRE_THROWS(decoder.decode_into(transient2.mref(), first, last));
+    transient1.mref()[1].as("XYZ");
+    transient2.mref()[1].as("XYZ");
+  }
+  first = copy_stream.data() + msg4_size;
+  last = copy_stream.data() + copy_stream.size();
+  decoder.decode_into(target1.mref(), first, last);
+  REQUIRE(first == last);
+  REQUIRE(target1.cref() == msg4.cref());
+}
+
+TEST_CASE("test fast coder without code generation for bounding the encoded size","[size_bound_test]")
+{
+  const char* xml_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt64 name=\"field1\" id=\"11\"><delta/></uInt64>\n"
+    "<string name=\"field2\" id=\"12\"><delta/></string>\n"
+    "<byteVector name=\"field3\" id=\"13\" presence=\"optional\"></byteVector>\n"
+    "<decimal name=\"field4\" id=\"14\"><copy/></decimal>\n"
+    "<sequence name=\"sequence1\">\n"
+    "<string name=\"field5\" id=\"15\"><copy/></string>\n"
+    "<int64 name=\"field6\" id=\"16\"><delta/></int64>\n"
+    "</sequence>\n"
+    "</template>\n"
+    "<template name=\"Other\" id=\"2\">\n"
+    "<uInt32 name=\"field7\" id=\"21\"></uInt32>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description description(xml_content);
+  const templates_description* descriptions[] = { &description };
+
+  debug_allocator alloc;
+  fast_encoder encoder(&alloc);
+  encoder.include(descriptions);
+
+  message_type msg(&alloc, encoder.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+  msg_ref[0].as(UINT64_MAX);
+  msg_ref[1].as(std::string(300, 'A').c_str());
+  const unsigned char bytes[] = "0123456789";
+  byte_vector_mref(msg_ref[2]).assign(bytes, bytes + 10);
+  decimal_mref(msg_ref[3]).as(INT64_MIN, -63);
+  sequence_mref seq(msg_ref[4]);
+  seq.resize(20);
+  for (uint32_t i = 0; i < 20; ++i) {
+    seq[i][0].as("ABCDEFGHIJ" + i % 10);
+    seq[i][1].as(i % 2 ? INT64_MAX : INT64_MIN);
+  }
+
+  std::size_t bound = encoder.encoded_size_bound(msg.cref());
+  std::vector<char> stream;
+  encoder.encode(msg.cref(), stream, true);
+  REQUIRE(stream.size() <= bound);
+  // the template id is left out from now on
+  stream.clear();
+  encoder.encode(msg.cref(), stream, true);
+
+  // a buffer smaller than the bound is filled as long as the message fits
+  std::vector<char> buffer(stream.size());
+  REQUIRE(encoder.encode(msg.cref(), buffer.data(), buffer.size(), true) == stream.size());
+  REQUIRE(buffer == stream);
+  REQUIRE_THROWS_AS(encoder.encode(msg.cref(), buffer.data(), buffer.size() - 1, true), buffer_overflow_error);
+
+  // the template id, the presence map and the field
+  message_type other(&alloc, encoder.template_with_id(2));
+  REQUIRE(encoder.encoded_size_bound(other.cref()) == 11U);
+}
+
+TEST_CASE("test fast coder without code generation for presence maps without overlong encodings","[non_overlong_pmap_coder_test]")
+{
+  const char* xml_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><copy/></uInt32>\n"
+    "<sequence name=\"sequence1\">\n"
+    "<uInt32 name=\"field2\" id=\"12\"><copy/></uInt32>\n"
+    "<group name=\"group1\">\n"
+    "<uInt32 name=\"field3\" id=\"13\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field4\" id=\"14\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field5\" id=\"15\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field6\" id=\"16\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field7\" id=\"17\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field8\" id=\"18\"><copy/></uInt32>\n"
+    "<uInt32 name=\"field9\" id=\"19\"><copy/></uInt32>\n"
+    "<string name=\"field10\" id=\"20\"><copy/></string>\n"
+    "</group>\n"
+    "</sequence>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description description(xml_content);
+  const templates_description* descriptions[] = { &description };
+
+  debug_allocator alloc;
+  fast_encoder overlong_encoder(&alloc);
+  overlong_encoder.include(descriptions);
+  fast_encoder encoder(&alloc);
+  encoder.include(descriptions);
+  encoder.allow_overlong_pmap(false);
+
+  message_type msg(&alloc, encoder.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+  msg_ref[0].as(1);
+  sequence_mref seq(msg_ref[1]);
+  seq.resize(3);
+  for (uint32_t i = 0; i < 3; ++i) {
+    seq[i][0].as(10 + i);
+    // the presence maps of the groups take two bytes, which are left empty
+    // by repeating the values
+    group_mref group(seq[i][1]);
+    for (uint32_t j = 0; j < 7; ++j)
+      group[j].as(20 + j);
+    group[7].as("ABC");
+  }
+
+  std::vector<char> overlong_stream, stream;
+  overlong_encoder.encode(msg_ref, overlong_stream, true);
+  encoder.encode(msg_ref, stream, true);
+  // the presence maps of the last two groups are shortened
+  REQUIRE(stream.size() + 2 == overlong_stream.size());
+
+  fast_decoder decoder(&alloc);
+  decoder.include(descriptions);
+  const char* first = stream.data();
+  message_cref decoded = decoder.decode(first, first + stream.size(), true);
+  REQUIRE(first == stream.data() + stream.size());
+  REQUIRE(decoded == msg.cref());
+}
+
+TEST_CASE("test fast coder without code generation for encoding into chunks","[chunked_buffer_test]")
+{
+  const char* xml_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><increment/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"></string>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description description(xml_content);
+  const templates_description* descriptions[] = { &description };
+
+  debug_allocator alloc;
+  fast_encoder reference_encoder(&alloc);
+  reference_encoder.include(descriptions);
+  fast_encoder encoder(&alloc);
+  encoder.include(descriptions);
+
+  message_type msg(&alloc, encoder.template_with_id(1));
+  message_mref msg_ref = msg.mref();
+  const uint32_t num_messages = 20;
+  std::vector<char> stream;
+  std::vector<std::size_t> ends;
+  // the last messages are larger than a chunk
+  fast_chunked_buffer buffer(128);
+  for (uint32_t i = 0; i < num_messages; ++i) {
+    msg_ref[0].as(i);
+    msg_ref[1].as(std::string(i * 10, 'A').c_str());
+    reference_encoder.encode(msg_ref, stream, i == 0);
+    ends.push_back(stream.size());
+    encoder.encode(msg_ref, buffer, i == 0);
+  }
+  REQUIRE(buffer.size() == stream.size());
+
+  // the messages of a chunk share an entry, which never splits a message
+  REQUIRE(buffer.iovec_count() < num_messages);
+  std::vector<char> contents;
+  for (std::size_t i = 0; i < buffer.iovec_count(); ++i) {
+    const char* data = static_cast<const char*>(buffer.iovecs()[i].iov_base);
+    contents.insert(contents.end(), data, data + buffer.iovecs()[i].iov_len);
+    REQUIRE(std::find(ends.begin(), ends.end(), contents.size()) != ends.end());
+  }
+  REQUIRE(contents == stream);
+
+  // the chunks are reused, with an entry for each message
+  buffer.clear();
+  REQUIRE(buffer.empty());
+  buffer.entry_per_message(true);
+  for (uint32_t i = 0; i < num_messages; ++i) {
+    msg_ref[0].as(i);
+    msg_ref[1].as(std::string(i * 10, 'A').c_str());
+    encoder.encode(msg_ref, buffer, i == 0);
+  }
+  REQUIRE(buffer.iovec_count() == num_messages);
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < num_messages; ++i) {
+    const char* data = static_cast<const char*>(buffer.iovecs()[i].iov_base);
+    REQUIRE(buffer.iovecs()[i].iov_len == ends[i] - start);
+    REQUIRE(std::equal(data, data + ends[i] - start, stream.data() + start));
+    start = ends[i];
+  }
+}
+
+TEST_CASE("test fast coder without code generation for packing messages into packets","[packetizer_test]")
+{
+  const char* xml_content =
+    "<?xml version=\" 1.0 \"?>\n"
+    "<templates xmlns=\"http://www.fixprotocol.org/ns/template-definition\" "
+    "templateNs=\"http://www.fixprotocol.org/ns/templates/sample\" ns=\"http://www.fixprotocol.org/ns/fix\">\n"
+    "<template name=\"Test\" id=\"1\">\n"
+    "<uInt32 name=\"field1\" id=\"11\"><increment/></uInt32>\n"
+    "<string name=\"field2\" id=\"12\"><copy/></string>\n"
+    "</template>\n"
+    "<template name=\"Other\" id=\"2\">\n"
+    "<uInt32 name=\"field3\" id=\"21\"><copy/></uInt32>\n"
+    "</template>\n"
+    "</templates>\n";
+  dynamic_templates_description description(xml_content);
+  const templates_description* descriptions[] = { &description };
+
+  debug_allocator alloc;
+  fast_encoder encoder(&alloc);
+  encoder.include(descriptions);
+
+  message_type msg1(&alloc, encoder.template_with_id(1));
+  message_type msg2(&alloc, encoder.template_with_id(2));
+  const uint32_t num_messages = 100;
+  auto message_at = [&](uint32_t i) -> message_cref {
+    if (i % 3 == 2) {
+      msg2.mref()[0].as(i);
+      return msg2.cref();
+    }
+    msg1.mref()[0].as(i);
+    msg1.mref()[1].as(std::string(1 + i % 17, 'A' + i % 26).c_str());
+    return msg1.cref();
+  };
+  auto check = [&](const message_cref& msg, uint32_t i) {
+    REQUIRE(msg.id() == (i % 3 == 2 ? 2U : 1U));
+    REQUIRE(uint32_cref(msg[0]).value() == i);
+    if (i % 3 != 2)
+      REQUIRE(std::string(ascii_string_cref(msg[1]).c_str()) == std::string(1 + i % 17, 'A' + i % 26));
+  };
+
+  // a sequence number and a payload length
+  fast_frame_format format(6, fast_frame_format::big_endian_length);
+  format.length_offset = 4;
+  format.length_size = 2;
+  format.sequence_size = 4;
+  const std::size_t max_packet_size = 64;
+
+  std::vector<std::vector<char> > packets;
+  fast_packetizer<fast_encoder> packetizer(encoder, format, max_packet_size,
+    [&](const char* data, std::size_t size) {
+      packets.push_back(std::vector<char>(data, data + size));
+    });
+  for (uint32_t i = 0; i < num_messages; ++i)
+    packetizer.encode(message_at(i));
+  packetizer.flush();
+  REQUIRE(packets.size() > 1);
+
+  // a packet is only closed when the next message does not fit
+  fast_decoder decoder(&alloc);
+  decoder.include(descriptions);
+  uint32_t i = 0;
+  for (std::size_t k = 0; k < packets.size(); ++k) {
+    REQUIRE(packets[k].size() <= max_packet_size);
+    fast_frame_reader reader(format, packets[k].data(), packets[k].data() + packets[k].size());
+    fast_frame frame;
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.sequence == k);
+    REQUIRE(reader.position() == packets[k].data() + packets[k].size());
+    const char* first = frame.payload;
+    const char* last = first + frame.payload_size;
+    while (first < last) {
+      const char* start = first;
+      check(decoder.decode(first, last, i == 0), i);
+      if (start == frame.payload && k > 0)
+        REQUIRE(packets[k-1].size() + (first - start) > max_packet_size);
+      ++i;
+    }
+  }
+  REQUIRE(i == num_messages);
+
+  // every packet can be decoded on its own
+  std::size_t sequence = packets.size();
+  packets.clear();
+  packetizer.reset_every_packet(true);
+  for (i = 0; i < num_messages; ++i)
+    packetizer.encode(message_at(i));
+  packetizer.flush();
+  i = 0;
+  for (std::size_t k = 0; k < packets.size(); ++k) {
+    fast_decoder packet_decoder(&alloc);
+    packet_decoder.include(descriptions);
+    fast_frame_reader reader(format, packets[k].data(), packets[k].data() + packets[k].size());
+    fast_frame frame;
+    REQUIRE(reader.next(frame));
+    REQUIRE(frame.sequence == sequence + k);
+    const char* first = frame.payload;
+    const char* last = first + frame.payload_size;
+    for (bool reset = true; first < last; reset = false)
+      check(packet_decoder.decode(first, last, reset), i++);
+  }
+  REQUIRE(i == num_messages);
+
+  // a message larger than a packet is dropped
+  packets.clear();
+  packetizer.reset_every_packet(false);
+  msg1.mref()[1].as(std::string(max_packet_size, 'A').c_str());
+  REQUIRE_THROWS_AS(packetizer.encode(msg1.cref()), buffer_overflow_error);
+  packetizer.encode(message_at(0));
+  packetizer.flush();
+  REQUIRE(packets.size() == 1U);
+  fast_decoder packet_decoder(&alloc);
+  packet_decoder.include(descriptions);
+  fast_frame_reader reader(format, packets[0].data(), packets[0].data() + packets[0].size());
+  fast_frame frame;
+  REQUIRE(reader.next(frame));
+  const char* first = frame.payload;
+  check(packet_decoder.decode(first, first + frame.payload_size, true), 0);
+}
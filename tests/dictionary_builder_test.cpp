@@ -37,7 +37,7 @@ same_dict(const field_instruction* lhs, const field_instruction* rhs)
   const ascii_field_instruction* rhs_inst = static_cast<const ascii_field_instruction*>(rhs);
 
   if (&lhs_inst->prev_value() == &rhs_inst->prev_value())
-    return true;
+    return lhs_inst->dictionary_slot() == rhs_inst->dictionary_slot();
   return false;
 }
 
@@ -48,7 +48,7 @@ different_dict(const field_instruction* lhs, const field_instruction* rhs)
   const ascii_field_instruction* rhs_inst = static_cast<const ascii_field_instruction*>(rhs);
 
   if (&lhs_inst->prev_value() != &rhs_inst->prev_value())
-    return true;
+    return lhs_inst->dictionary_slot() != rhs_inst->dictionary_slot();
   return false;
 }
 
@@ -150,3 +150,59 @@ TEST_CASE("test the construction of fast dictionary", "[typeRef_test]")
 
 }
 
+
+TEST_CASE("test the reset of fast dictionary values", "[dictionary_block_test]")
+{
+  dictionary_block dictionary;
+  uint32_t keyed = dictionary.add(true);
+  uint32_t unkeyed = dictionary.add(false);
+
+  REQUIRE(!dictionary[keyed].is_defined());
+  dictionary[keyed] = value_storage(0);
+  dictionary[unkeyed] = value_storage(0);
+  REQUIRE(dictionary[keyed].is_defined());
+
+  dictionary.reset();
+  // the values are cleared when they are accessed
+  REQUIRE(dictionary.raw(keyed).is_defined());
+  REQUIRE(!dictionary[keyed].is_defined());
+  REQUIRE(dictionary[unkeyed].is_defined());
+
+  dictionary[keyed].defined(true);
+  REQUIRE(dictionary[keyed].is_defined());
+  dictionary.reset();
+  dictionary.reset();
+  REQUIRE(!dictionary[keyed].is_defined());
+}
+
+TEST_CASE("test the lookup of templates by id", "[template_table_test]")
+{
+  template_table<int> dense;
+  for (uint32_t id = 100; id < 400; id += 2)
+    REQUIRE(dense.emplace(id, static_cast<int>(id)));
+  REQUIRE(!dense.hashed());
+  REQUIRE(!dense.emplace(100, 0));
+  REQUIRE(*dense.find(100) == 100);
+  REQUIRE(*dense.find(398) == 398);
+  REQUIRE(dense.find(101) == nullptr);
+  REQUIRE(dense.find(99) == nullptr);
+  REQUIRE(dense.find(400) == nullptr);
+
+  template_table<int> sparse;
+  const uint32_t ids[] = { 1, 1000, 65536, 65537, 0xFFFFFFFF, 0x80000000 };
+  for (uint32_t id : ids)
+    REQUIRE(sparse.emplace(id, static_cast<int>(id & 0xFFFF)));
+  REQUIRE(sparse.hashed());
+  REQUIRE(sparse.size() == 6U);
+  for (uint32_t id : ids)
+    REQUIRE(*sparse.find(id) == static_cast<int>(id & 0xFFFF));
+  REQUIRE(sparse.find(0) == nullptr);
+  REQUIRE(sparse.find(2) == nullptr);
+  REQUIRE(sparse.find(0xFFFFFFFE) == nullptr);
+
+  // the entries are not moved by the index
+  const int* first = sparse.find(1);
+  for (uint32_t id = 2; id < 200; ++id)
+    sparse.emplace(id * 1000, 0);
+  REQUIRE(sparse.find(1) == first);
+}
@@ -585,6 +585,47 @@ TEST_CASE("test the encoding of fast operator copy","[operator_copy_encode_test]
   }
 }
 
+TEST_CASE("test the encoding of fast operator copy for ascii string","[operator_copy_ascii_encode_test]")
+{
+  debug_allocator alloc;
+  value_storage storage;
+
+  ascii_field_instruction inst(operator_copy,
+                               presence_mandatory,
+                               1,
+                               "test_ascii","",
+                               nullptr,
+                               string_value_storage());
+  inst.construct_value(storage, &alloc);
+
+  ascii_string_mref result(&alloc, &storage, &inst);
+  result.as("ABC");
+  REQUIRE( encode_mref("\xC0\x41\x42\xC3", result, CHANGE_PREVIOUS_VALUE) );
+
+  // a value of the same length as the previous value reuses its buffer;
+  // it must still be compared with the old contents.
+  result.as("XYZ");
+  REQUIRE( encode_mref("\xC0\x58\x59\xDA", result, CHANGE_PREVIOUS_VALUE) );
+  result.as("XYZ");
+  REQUIRE( encode_mref("\x80", result, CHANGE_PREVIOUS_VALUE) );
+
+  inst.prev_value().defined(false);
+  result.as("ABC");
+  REQUIRE( encode_ext_cref("\xC0\x41\x42\xC3",
+                           ext_cref<ascii_string_cref, copy_operator_tag, mandatory_without_initial_value_tag>(result),
+                           CHANGE_PREVIOUS_VALUE, &alloc ) );
+  result.as("XYZ");
+  REQUIRE( encode_ext_cref("\xC0\x58\x59\xDA",
+                           ext_cref<ascii_string_cref, copy_operator_tag, mandatory_without_initial_value_tag>(result),
+                           CHANGE_PREVIOUS_VALUE, &alloc ) );
+  REQUIRE( encode_ext_cref("\x80",
+                           ext_cref<ascii_string_cref, copy_operator_tag, mandatory_without_initial_value_tag>(result),
+                           CHANGE_PREVIOUS_VALUE, &alloc ) );
+
+  inst.destruct_value(storage, &alloc);
+  inst.destruct_value(inst.prev_value(), &alloc);
+}
+
 TEST_CASE("test the encoding of fast operator increment","[operator_increment_encode_test]")
 {
   malloc_allocator allocator;
@@ -23,6 +23,7 @@
 #include <mfast/output.h>
 #include "debug_allocator.h"
 #include <stdexcept>
+#include <string>
 #include "byte_stream.h"
 
 using namespace mfast;
@@ -37,8 +38,20 @@ decode_integer(const byte_stream& bs, bool nullable, T result)
   T value;
   bool not_null = strm.decode(value, nullable);
 
-  if (not_null &&  value == result)
-    return true;
+  if (not_null &&  value == result) {
+    // decode again with trailing bytes so that the integer is read from a
+    // full machine word
+    std::string padded(bs.data(), bs.size());
+    padded.append(8, '\xFF');
+    fast_istreambuf padded_sb(padded.data(), padded.size());
+    fast_istream padded_strm(&padded_sb);
+
+    T padded_value;
+    if (padded_strm.decode(padded_value, nullable) && padded_value == result &&
+        padded_sb.in_avail() == 8)
+      return true;
+    not_null = false;
+  }
 
   if (not_null) {
     INFO(  "Got \"" << value << "\" instead." );
@@ -74,6 +87,15 @@ TEST_CASE("test the fast decoding of integers","[int32_test]")
   REQUIRE(decode_integer( "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x80",  true, (std::numeric_limits<int64_t>::max)()));
   REQUIRE(decode_integer( "\x02\x00\x00\x00\x00\x00\x00\x00\x00\x80",  true, (std::numeric_limits<uint64_t>::max)()));
 
+  REQUIRE(decode_integer( "\x3f\x7f\x7f\x7f\x7f\x7f\x7f\xff", false, INT64_C(0x7FFFFFFFFFFFFF)));
+  REQUIRE(decode_integer( "\x40\x00\x00\x00\x00\x00\x00\x80", false, INT64_C(-0x80000000000000)));
+  REQUIRE(decode_integer( "\x7f\x7f\x7f\x7f\x7f\x7f\x7f\xff", false, INT64_C(-1)));
+  REQUIRE(decode_integer( "\x7f\x7f\x7f\x7f\x7f\x7f\x7f\xff", true, INT64_C(-1)));
+  REQUIRE(decode_integer( "\x7f\x7f\x7f\x7f\x7f\x7f\x7f\xff", false, UINT64_C(0xFFFFFFFFFFFFFF)));
+  REQUIRE(decode_integer( "\x7f\xff", false, INT16_C(-1)));
+  REQUIRE(decode_integer( "\x00\x7f\xff", false, UINT16_C(0x3FFF)));
+  REQUIRE(decode_integer( "\x0f\x7f\x7f\x7f\xff", false, (std::numeric_limits<uint32_t>::max)()));
+
   { // check decoding null
     char data[] = "\x80";
     fast_istreambuf sb(data, 3);
@@ -127,6 +149,26 @@ TEST_CASE("test the fast decoding of ascii string","[ascii_string_test]")
   REQUIRE_THROWS_AS(decode_string("\x00\x00\xC0", true, nullptr, 0), mfast::fast_error );
 }
 
+TEST_CASE("test the stop bit scanning of long entities","[entity_length_test]")
+{
+  char data[100];
+  for (std::size_t len = 1; len < 80; ++len) {
+    std::memset(data, 'A', sizeof(data));
+    data[len-1] |= '\x80';
+
+    fast_istreambuf sb(data, sizeof(data));
+    REQUIRE(sb.get_entity_length() == len);
+
+    fast_istreambuf exact_sb(data, len);
+    REQUIRE(exact_sb.get_entity_length() == len);
+
+    REQUIRE(decode_string(byte_stream(data, len), false, data, len));
+
+    fast_istreambuf short_sb(data, len-1);
+    REQUIRE_THROWS_AS(short_sb.get_entity_length(), mfast::fast_error);
+  }
+}
+
 bool
 decode_byte_vector(const byte_stream& bs, bool nullable, const char* result, std::size_t result_len)
 {
@@ -273,5 +315,14 @@ TEST_CASE("test the fast decoding of presence map","[decoder_presence_map_test]"
   REQUIRE( decode_pmap( "\xC0", "\x80", 7) );
   REQUIRE( decode_pmap( "\x40\x81", "\x80\x04",  14 ) );
   REQUIRE( decode_pmap( "\x40\x40\x40\x40\x40\x40\x40\x40\xC0", "\x81\x02\x04\x08\x10\x20\x40\x80",  63 ) );
+  // presence maps followed by at least 8 bytes are loaded with a single word
+  REQUIRE( decode_pmap( "\xC0\x00\x00\x00\x00\x00\x00\x00", "\x80", 7) );
+  REQUIRE( decode_pmap( "\x40\x81\x00\x00\x00\x00\x00\x00", "\x80\x04",  14 ) );
+  REQUIRE( decode_pmap( "\x40\x00\x81\x00\x00\x00\x00\x00", "\x80\x00\x08",  21 ) );
+  // presence maps longer than 8 bytes are loaded a word at a time
+  REQUIRE( decode_pmap( "\x40\x00\x00\x00\x00\x00\x00\x00\x00\xC0", "\x80\x00\x00\x00\x00\x00\x00\x01\x00",  70 ) );
+  REQUIRE( decode_pmap( "\x41\x02\x04\x08\x10\x20\x40\x01\x02\x04\x08\xE0", "\x82\x08\x20\x82\x08\x20\x01\x04\x10\x46\x00",  84 ) );
+  REQUIRE( decode_pmap( "\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x81",
+                        "\x02\x04\x08\x10\x20\x40\x81\x02\x04\x08\x10\x20\x40\x81\x02",  119 ) );
 }
 
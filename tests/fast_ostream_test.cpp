@@ -22,9 +22,12 @@
 #include <mfast/coder/encoder/fast_ostream.h>
 #include <mfast/coder/encoder/fast_ostream_inserter.h>
 #include <mfast/coder/encoder/encoder_presence_map.h>
+#include <mfast/coder/decoder/fast_istream.h>
 #include <mfast/output.h>
 #include "debug_allocator.h"
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include "byte_stream.h"
 
 using namespace mfast;
@@ -79,6 +82,112 @@ TEST_CASE("test fast encoding for integers","[int_test]")
   REQUIRE(encode_integer((std::numeric_limits<uint64_t>::max)(), true, "\x02\x00\x00\x00\x00\x00\x00\x00\x00\x80"));
 }
 
+// the stop bit encoding of an integer, built one group at a time
+template <typename T>
+std::string
+reference_encoding(T value, bool nullable)
+{
+  std::string groups;
+  if (std::is_signed<T>::value) {
+    int64_t v = value;
+    if (nullable && v == (std::numeric_limits<int64_t>::max)())
+      return std::string("\x01\x00\x00\x00\x00\x00\x00\x00\x00\x80", 10);
+    if (nullable && v >= 0)
+      ++v;
+    // stop once the sign of the value is carried by the last group
+    do {
+      groups.insert(groups.begin(), static_cast<char>(v & 0x7F));
+      v >>= 7;
+    } while (!((v == 0 && (groups[0] & 0x40) == 0) || (v == -1 && (groups[0] & 0x40))));
+  }
+  else {
+    uint64_t v = static_cast<uint64_t>(value);
+    if (nullable && v == (std::numeric_limits<uint64_t>::max)())
+      return std::string("\x02\x00\x00\x00\x00\x00\x00\x00\x00\x80", 10);
+    if (nullable)
+      ++v;
+    do {
+      groups.insert(groups.begin(), static_cast<char>(v & 0x7F));
+      v >>= 7;
+    } while (v);
+  }
+  groups.back() |= '\x80';
+  return groups;
+}
+
+template <typename T>
+bool
+round_trip_integer(T value, bool nullable)
+{
+  const std::string expected = reference_encoding(value, nullable);
+  debug_allocator alloc;
+  fast_ostream strm(&alloc);
+
+  // a buffer with room for a whole word and one of the exact size
+  char buffer[16];
+  std::vector<char> exact(expected.size());
+  fast_ostreambuf roomy_sb(buffer);
+  fast_ostreambuf exact_sb(exact.data(), exact.size());
+  fast_ostreambuf* bufs[] = { &roomy_sb, &exact_sb };
+  for (fast_ostreambuf* sb : bufs) {
+    strm.rdbuf(sb);
+    strm.encode(value, false, nullable);
+    std::string encoded(sb->pbase(), sb->length());
+    if (encoded != expected) {
+      INFO("Encoded " << value << " as \"" << byte_stream(*sb) << "\".");
+      return false;
+    }
+
+    fast_istreambuf isb(encoded.data(), encoded.size());
+    fast_istream istrm(&isb);
+    T decoded;
+    if (!istrm.decode(decoded, nullable) || decoded != value || isb.in_avail() != 0) {
+      INFO("Decoded " << value << " as " << decoded << ".");
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+void
+round_trip_integers()
+{
+  // the values around every power of two, where the encoded length changes
+  std::vector<T> values;
+  for (unsigned k = 0; k < sizeof(T) * 8; ++k) {
+    T v = static_cast<T>(static_cast<uint64_t>(1) << k);
+    values.push_back(v);
+    values.push_back(static_cast<T>(v - 1));
+    values.push_back(static_cast<T>(v + 1));
+    values.push_back(static_cast<T>(0 - v));
+    values.push_back(static_cast<T>(0 - v - 1));
+  }
+  values.push_back((std::numeric_limits<T>::max)());
+  values.push_back((std::numeric_limits<T>::min)());
+  uint64_t x = UINT64_C(0x9E3779B97F4A7C15);
+  for (int i = 0; i < 1000; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    // random values of random lengths
+    values.push_back(static_cast<T>(x >> (x % 64)));
+  }
+
+  for (T v : values) {
+    REQUIRE(round_trip_integer(v, false));
+    REQUIRE(round_trip_integer(v, true));
+  }
+}
+
+TEST_CASE("test fast encoding for integers against the encoding of each group","[int_round_trip_test]")
+{
+  round_trip_integers<int16_t>();
+  round_trip_integers<int32_t>();
+  round_trip_integers<uint32_t>();
+  round_trip_integers<int64_t>();
+  round_trip_integers<uint64_t>();
+}
 
 bool
 encode_string(const char* str,std::size_t len, bool nullable, const byte_stream& result)
@@ -328,6 +437,36 @@ TEST_CASE("","[non_overlong_encoder_presence_map_test]")
 
     REQUIRE (byte_stream(sb) == byte_stream("\x80\xC0\x40\x41\x42\xC3"));
   }
+
+  {
+    fast_ostreambuf sb(buffer);
+    fast_ostream strm(&alloc);
+    strm.rdbuf(&sb);
+
+    strm.allow_overlong_pmap(false);
+
+    encoder_presence_map pmap;
+    pmap.init(&strm, 14);
+
+    strm.encode("\x40\x41\x42\x43",
+                4,
+                static_cast<const ascii_field_instruction*>(nullptr),
+                false);
+
+    encoder_presence_map nested_pmap;
+    nested_pmap.init(&strm, 14);
+    nested_pmap.set_next_bit(true);
+    strm.encode(0, false, false);
+    nested_pmap.commit();
+
+    for (std::size_t i = 0; i < 14; ++i) {
+      pmap.set_next_bit(false);
+    }
+
+    pmap.commit();
+
+    REQUIRE (byte_stream(sb) == byte_stream("\x80\x40\x41\x42\xC3\xC0\x80"));
+  }
 }
 
 
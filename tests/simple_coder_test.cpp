@@ -22,8 +22,15 @@
 #include <mfast/field_comparator.h>
 #include <mfast/coder/fast_encoder_v2.h>
 #include <mfast/coder/fast_decoder_v2.h>
+#include <mfast/coder/fast_token_handoff.h>
+#include <mfast/coder/fast_packetizer.h>
+#include <mfast/coder/common/template_repo.h>
+#include <algorithm>
 #include <cstring>
+#include <memory>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include "simple1.h"
 #include "simple2.h"
@@ -33,6 +40,10 @@
 #include "simple6.h"
 #include "simple7.h"
 #include "simple8.h"
+#include "simple9.h"
+#include "simple10.h"
+#include "simple11.h"
+#include "simple12.h"
 
 #include "byte_stream.h"
 #include "debug_allocator.h"
@@ -79,6 +90,70 @@ class fast_coding_test_case
       return false;
     }
 
+    bool
+    trusted_decoding(const byte_stream& bytes, const message_cref& result, std::size_t frame_size)
+    {
+      // the frame is followed by the zero padding required by decode_trusted()
+      std::vector<char> buffer(bytes.data(), bytes.data()+bytes.size());
+      buffer.resize(bytes.size() + mfast::trusted_padding);
+
+      const char* first = buffer.data();
+      message_cref msg = decoder_.decode_trusted(first, first+frame_size);
+
+      return (msg == result) && (first == buffer.data()+frame_size);
+    }
+
+    bool
+    batch_decoding(const byte_stream& bytes, const message_cref& result, std::size_t count, std::size_t header_size)
+    {
+      const char* first = bytes.data();
+      const char* last = first+bytes.size();
+      std::size_t decoded = 0;
+      std::size_t n = decoder_.decode_all(first, last, [&](const message_cref& msg) {
+        if (msg == result)
+          ++decoded;
+      }, true, header_size);
+
+      return n == count && decoded == count && first == last;
+    }
+
+    void
+    journal(dictionary_journal* journal)
+    {
+      decoder_.journal(journal);
+    }
+
+    void
+    zero_copy(bool enabled)
+    {
+      decoder_.zero_copy(enabled);
+    }
+
+    message_cref
+    decode(const char*& first, const char* last)
+    {
+      return decoder_.decode(first, last);
+    }
+
+    void
+    projection(uint32_t template_id, std::initializer_list<const char*> paths)
+    {
+      decoder_.projection(template_id, paths);
+    }
+
+    message_cref
+    projected_decoding(const message_cref& msg_ref, bool reset=false)
+    {
+      const int buffer_size = 128;
+      char buffer[buffer_size];
+      std::size_t encoded_size = encoder_.encode(msg_ref, buffer, buffer_size, reset);
+
+      const char* first = buffer;
+      message_cref msg = decoder_.decode(first, first+encoded_size, reset);
+      REQUIRE(first == buffer+encoded_size);
+      return msg;
+    }
+
   private:
     debug_allocator alloc_;
     mfast::fast_encoder_v2 encoder_;
@@ -274,3 +349,486 @@ TEST_CASE("test fast coder v2 for a template with zero segment size", "[segment_
   REQUIRE(test_case.decoding("\x80\x81\x82", msg_ref));
 }
 
+
+TEST_CASE("test fast coder v2 for trusted frames","[trusted_decoding_test]")
+{
+  fast_coding_test_case<simple1::templates_description> test_case;
+
+  debug_allocator alloc;
+  simple1::Test msg(&alloc);
+  simple1::Test_mref msg_ref = msg.mref();
+
+  msg_ref.set_field1().as(1);
+  msg_ref.set_field2().as(2);
+  msg_ref.set_field3().as(3);
+
+  REQUIRE(test_case.trusted_decoding("\xB8\x81\x82\x83", msg_ref, 4));
+  // the message extends beyond the end of the frame
+  REQUIRE_THROWS_AS(test_case.trusted_decoding("\xB8\x81\x82\x83", msg_ref, 3), mfast::fast_error);
+  // the truncated message runs into the padding
+  REQUIRE_THROWS_AS(test_case.trusted_decoding("\xB8\x81\x82", msg_ref, 3), mfast::fast_error);
+}
+
+TEST_CASE("test fast coder v2 for decoding a whole buffer","[decode_all_test]")
+{
+  fast_coding_test_case<simple1::templates_description> test_case;
+
+  debug_allocator alloc;
+  simple1::Test msg(&alloc);
+  simple1::Test_mref msg_ref = msg.mref();
+
+  msg_ref.set_field1().as(1);
+  msg_ref.set_field2().as(2);
+  msg_ref.set_field3().as(3);
+
+  // the second and third messages take the previous values of all fields
+  REQUIRE(test_case.batch_decoding("\xB8\x81\x82\x83\x80\x80", msg_ref, 3, 0));
+  // each message is preceded by a one byte header
+  REQUIRE(test_case.batch_decoding("\x04\xB8\x81\x82\x83\x01\x80", msg_ref, 2, 1));
+  // the last message is truncated
+  REQUIRE_THROWS_AS(test_case.batch_decoding("\xB8\x81\x82\x83\xB8\x81", msg_ref, 1, 0), mfast::fast_error);
+}
+
+TEST_CASE("test fast coder v2 for rolling back failed messages","[dictionary_journal_test]")
+{
+  fast_coding_test_case<simple9::templates_description> test_case;
+  dictionary_journal journal;
+  test_case.journal(&journal);
+
+  debug_allocator alloc;
+  simple9::Test msg(&alloc);
+  simple9::Test_mref msg_ref = msg.mref();
+
+  msg_ref.set_field1().as(1);
+  msg_ref.set_field2().as("AB");
+  msg_ref.set_field3().as("XY");
+  msg_ref.set_field4().as(2);
+  msg_ref.set_field5().as(3);
+
+  REQUIRE(test_case.decoding("\xFC\x81\x81\x41\xC2\x80\x58\xD9\x83\x83", msg_ref));
+
+  // every field takes its previous value
+  msg_ref.set_field4().as(3);
+  const byte_stream unchanged("\x80\x80\x80");
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // D7: the subtraction length of field3 exceeds its base value
+  REQUIRE_THROWS_AS(test_case.decoding("\xB0\x85\x43\xC4\x83", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // D6: field4 sets the shared previous value to empty for the mandatory field5
+  REQUIRE_THROWS_AS(test_case.decoding("\xB8\x85\x43\xC4\x80\xDA\x80", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+
+  // buffer underflow
+  REQUIRE_THROWS_AS(test_case.decoding("\xB8\x85\x43\xC4\x80", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding(unchanged, msg_ref));
+}
+
+TEST_CASE("test fast coder v2 for rolling back a failed dynamic templateref","[dictionary_journal_test]")
+{
+  fast_coding_test_case<simple5::templates_description> test_case;
+  dictionary_journal journal;
+  test_case.journal(&journal);
+
+  debug_allocator alloc;
+
+  simple5::Test msg(&alloc);
+  simple5::Test_mref msg_ref = msg.mref();
+
+  msg_ref.set_field1().as(1);
+  nested_message_mref nested(msg_ref.set_nested());
+
+  simple5::Nested_mref target = nested.as<simple5::Nested>();
+
+  target.set_field2().as(2);
+  target.set_field3().as(3);
+
+  REQUIRE(test_case.decoding("\xE0\x82\x81\xF0\x81\x82\x83", msg_ref));
+  // D9: the nested template id is unknown, after field1 was decoded
+  REQUIRE_THROWS_AS(test_case.decoding("\xA0\x85\xC0\x83", msg_ref), mfast::fast_error);
+  REQUIRE(test_case.decoding("\x80\xC0\x81", msg_ref));
+}
+
+TEST_CASE("test fast coder v2 for zero copy decoding","[zero_copy_test]")
+{
+  fast_coding_test_case<simple10::templates_description> test_case;
+
+  debug_allocator alloc;
+  simple10::Test msg(&alloc);
+  simple10::Test_mref msg_ref = msg.mref();
+
+  const unsigned char bytes[] = { 0x01, 0xFF };
+  msg_ref.set_field1().as(5);
+  msg_ref.set_field2().as("ABC");
+  msg_ref.set_field3().as("XY");
+  msg_ref.set_field4().assign(bytes, bytes+2);
+  msg_ref.set_field5().as("DE");
+  msg_ref.set_field6().as("Z");
+
+  const byte_stream encoded("\xF0\x81\x85\x41\x42\xC3\x82\x58\x59\x82\x01\xFF\x44\xC5\xDA");
+  test_case.zero_copy(true);
+
+  // the input is never modified; it may be read only and decoded again
+  static const char input[] = "\xF0\x81\x85\x41\x42\xC3\x82\x58\x59\x82\x01\xFF\x44\xC5\xDA";
+  const char* last = input + sizeof(input) - 1;
+  for (int i = 0; i < 2; ++i) {
+    const char* first = input;
+    message_cref result = test_case.decode(first, last);
+    REQUIRE(result == msg_ref);
+    REQUIRE(first == last);
+
+    simple10::Test_cref view(result);
+    // the byte vectors without operator refer to the input buffer
+    REQUIRE(view.get_field4().data() == reinterpret_cast<const unsigned char*>(input+10));
+    // the strings are copied into the message
+    REQUIRE(view.get_field2().data() != input+3);
+    REQUIRE(view.get_field3().data() != input+7);
+    REQUIRE(view.get_field6().data() != input+14);
+    REQUIRE(view.get_field5().data() != input+12);
+
+    REQUIRE(view.get_field2().value() == "ABC");
+    REQUIRE(view.get_field2().value() != view.get_field6().value());
+    REQUIRE(std::strcmp(view.get_field2().c_str(), view.get_field6().c_str()) < 0);
+    REQUIRE(std::strcmp(view.get_field3().c_str(), "XY") == 0);
+  }
+  REQUIRE(std::equal(input, last, encoded.data()));
+
+  test_case.zero_copy(false);
+  std::vector<char> buffer(encoded.data(), encoded.data()+encoded.size());
+  const char* first = buffer.data();
+  message_cref copied = test_case.decode(first, first+buffer.size());
+  REQUIRE(copied == msg_ref);
+  REQUIRE(simple10::Test_cref(copied).get_field4().data() != reinterpret_cast<const unsigned char*>(buffer.data()+10));
+  REQUIRE(std::equal(buffer.begin(), buffer.end(), encoded.data()));
+}
+
+TEST_CASE("test fast coder v2 for projected fields","[projection_test]")
+{
+  fast_coding_test_case<simple11::templates_description> test_case;
+
+  REQUIRE_THROWS_AS(test_case.projection(1, {"group1.field0"}), fast_static_error);
+  REQUIRE_THROWS_AS(test_case.projection(2, {"field4"}), fast_dynamic_error);
+  test_case.projection(1, {"field4", "group1.19"});
+
+  debug_allocator alloc;
+  simple11::Test msg(&alloc);
+  message_mref msg_ref = msg.mref();
+
+  msg_ref[0].as(1);
+  msg_ref[1].as("ABC");
+  msg_ref[2].as(-7);
+  decimal_mref(msg_ref[3]).as(12345, -2);
+  sequence_mref seq(msg_ref[4]);
+  seq.resize(2);
+  seq[0][0].as(10);
+  const unsigned char bytes[] = { 0x01, 0x02, 0x03 };
+  byte_vector_mref(seq[0][1]).assign(bytes, bytes+3);
+  seq[1][0].as(20);
+  byte_vector_mref(seq[1][1]).assign(bytes, bytes+1);
+  group_mref grp(msg_ref[5]);
+  grp[0].as("DEF");
+  grp[1].as(5);
+  grp[2].as(9);
+
+  message_cref first = test_case.projected_decoding(msg_ref, true);
+  REQUIRE(first[3] == msg_ref[3]);
+  REQUIRE(group_cref(first[5])[2] == grp[2]);
+  REQUIRE(sequence_cref(first[4]).size() == 0);
+
+  // the second message is decoded from the dictionary values of the skipped
+  // fields
+  msg_ref[1].as("GH");
+  msg_ref[2].as(4);
+  decimal_mref(msg_ref[3]).as(-3, 1);
+  seq.resize(1);
+  seq[0][0].as(25);
+  grp[0].as("IJKL");
+
+  message_cref second = test_case.projected_decoding(msg_ref);
+  REQUIRE(second[0] == msg_ref[0]);
+  REQUIRE(second[3] == msg_ref[3]);
+  REQUIRE(group_cref(second[5])[2] == grp[2]);
+
+  // a path naming a group selects all of its fields
+  test_case.projection(1, {"group1"});
+  grp[2].as(10);
+  message_cref third = test_case.projected_decoding(msg_ref);
+  REQUIRE(third[0] == msg_ref[0]);
+  REQUIRE(third[5] == msg_ref[5]);
+}
+
+TEST_CASE("test fast coder v2 for projected templates referred to by dynamic templateref","[projection_templateref_test]")
+{
+  fast_coding_test_case<simple12::templates_description> test_case;
+
+  debug_allocator alloc;
+  simple12::Test msg(&alloc);
+  simple12::Test_mref msg_ref = msg.mref();
+
+  msg_ref.set_field1().as(1);
+  nested_message_mref nested(msg_ref.set_nested());
+  simple12::Nested_mref target = nested.as<simple12::Nested>();
+  target.set_field2().as(2);
+  target.set_field3().as("ABC");
+
+  // the projection of a template does not apply where it is referred to by
+  // another message
+  test_case.projection(1, {"field3"});
+  message_cref decoded = test_case.projected_decoding(msg_ref, true);
+  REQUIRE(decoded == msg_ref);
+}
+
+TEST_CASE("test fast coder v2 for decoders sharing instructions","[template_set_test]")
+{
+  const templates_description* descriptions[] = { simple6::description() };
+  std::shared_ptr<const template_set> templates =
+    std::make_shared<template_set>(descriptions, 1);
+
+  debug_allocator alloc;
+  fast_decoder_v2<0> decoder_a(&alloc, templates, simple6::description());
+  fast_decoder_v2<0> decoder_b(&alloc, templates, simple6::description());
+
+  simple6::Test msg(&alloc);
+  simple6::Test_mref msg_ref = msg.mref();
+  msg_ref.set_field1().as(1);
+  msg_ref.set_field2().as(2);
+  msg_ref.set_field3().as(3);
+
+  const byte_stream first_message("\xB8\x81\x82\x83");
+  const byte_stream unchanged("\x80");
+
+  const char* first = first_message.data();
+  message_cref result = decoder_a.decode(first, first+first_message.size(), true);
+  REQUIRE(result == msg_ref);
+  REQUIRE(result.instruction() == templates->find(simple6::Test::the_id));
+
+  // the dictionary of the other decoder is still undefined
+  first = unchanged.data();
+  simple6::Test_cref initial(decoder_b.decode(first, first+unchanged.size(), true));
+  REQUIRE(initial.get_field1().value() == 11U);
+  REQUIRE(initial.get_field3().value() == 13U);
+
+  first = unchanged.data();
+  REQUIRE(decoder_a.decode(first, first+unchanged.size()) == msg_ref);
+}
+
+TEST_CASE("test fast coder v2 for restoring saved dictionaries","[dictionary_snapshot_test]")
+{
+  debug_allocator alloc;
+  fast_encoder_v2 primary_encoder(&alloc, simple9::description());
+  fast_encoder_v2 standby_encoder(&alloc, simple9::description());
+  fast_decoder_v2<0> primary_decoder(&alloc, simple9::description());
+  fast_decoder_v2<0> standby_decoder(&alloc, simple9::description());
+
+  simple9::Test msg(&alloc);
+  simple9::Test_mref msg_ref = msg.mref();
+
+  msg_ref.set_field1().as(1);
+  msg_ref.set_field2().as("AB");
+  msg_ref.set_field3().as("XY");
+  msg_ref.set_field4().as(2);
+  msg_ref.set_field5().as(3);
+
+  const byte_stream first_message("\xFC\x81\x81\x41\xC2\x80\x58\xD9\x83\x83");
+  const char* first = first_message.data();
+  REQUIRE(primary_decoder.decode(first, first+first_message.size(), true) == msg_ref);
+
+  // the template id of the only template is omitted by the encoder
+  std::vector<char> buffer;
+  primary_encoder.encode(msg_ref, buffer, true);
+  REQUIRE(byte_stream(buffer.data(), buffer.size()) == byte_stream("\xBC\x81\x41\xC2\x80\x58\xD9\x83\x83"));
+
+  std::vector<char> encoder_state, decoder_state;
+  primary_encoder.save_dictionary(encoder_state);
+  primary_decoder.save_dictionary(decoder_state);
+  standby_encoder.restore_dictionary(encoder_state);
+  standby_decoder.restore_dictionary(decoder_state);
+
+  // every field takes its previous value
+  msg_ref.set_field4().as(3);
+  const byte_stream unchanged("\x80\x80\x80");
+  first = unchanged.data();
+  REQUIRE(standby_decoder.decode(first, first+unchanged.size()) == msg_ref);
+
+  buffer.clear();
+  standby_encoder.encode(msg_ref, buffer);
+  REQUIRE(byte_stream(buffer.data(), buffer.size()) == unchanged);
+
+  // a snapshot of other templates is rejected
+  fast_decoder_v2<0> other_decoder(&alloc, simple6::description());
+  REQUIRE_THROWS_AS(other_decoder.restore_dictionary(decoder_state), coder::dictionary_snapshot_error);
+}
+
+TEST_CASE("test fast decoder v2 for decoding into message buffers","[decode_into_test]")
+{
+  fast_encoder_v2 encoder(simple9::description());
+  fast_decoder_v2<0> decoder(simple9::description());
+
+  simple9::Test msg1, msg2;
+  msg1.mref().set_field1().as(1);
+  msg1.mref().set_field2().as("AB");
+  msg1.mref().set_field3().as("XY");
+  msg1.mref().set_field4().as(2);
+  msg1.mref().set_field5().as(3);
+  msg2.mref().set_field1().as(4);
+  msg2.mref().set_field2().as("AC");
+  msg2.mref().set_field3().as("XYZ");
+  msg2.mref().set_field4().as(6);
+  msg2.mref().set_field5().as(5);
+
+  std::vector<char> stream;
+  encoder.encode(msg1.cref(), stream, true);
+  encoder.encode(msg2.cref(), stream);
+
+  debug_allocator alloc;
+  simple9::Test target1(&alloc), target2(&alloc);
+  const char* first = stream.data();
+  const char* last = first + stream.size();
+  decoder.decode_into(target1.mref(), first, last, true);
+  decoder.decode_into(target2.mref(), first, last);
+  REQUIRE(first == last);
+  REQUIRE(target1.cref() == msg1.cref());
+  REQUIRE(target2.cref() == msg2.cref());
+
+  // a message of another template is not decoded
+  simple5::Test other(&alloc);
+  first = stream.data();
+  REQUIRE_THROWS_AS(decoder.decode_into(other.mref(), first, last, true), coder::template_mismatch_error);
+  REQUIRE(first == stream.data());
+
+  // the dictionary keeps copies of the strings decoded into a target, which
+  // may then be modified or destroyed
+  simple9::Test msg3;
+  msg3.mref().set_field1().as(7);
+  msg3.mref().set_field2().as("AC");
+  msg3.mref().set_field3().as("XYZW");
+  msg3.mref().set_field4().as(6);
+  msg3.mref().set_field5().as(5);
+  encoder.encode(msg3.cref(), stream);
+  first = stream.data();
+  last = first + stream.size();
+  {
+    simple9::Test transient1(&alloc), transient2(&alloc);
+    decoder.decode_into(transient1.mref(), first, last, true);
+    decoder.decode_into(transient2.mref(), first, last);
+    transient2.mref().set_field2().as("QR");
+    transient2.mref().set_field3().as("QRS");
+  }
+  decoder.decode_into(target1.mref(), first, last);
+  REQUIRE(first == last);
+  REQUIRE(target1.cref() == msg3.cref());
+}
+
+TEST_CASE("test fast decoder v2 for handing messages off to a consumer","[token_handoff_test]")
+{
+  fast_encoder_v2 encoder(simple1::description());
+  fast_decoder_v2<2> decoder(simple1::description());
+  fast_token_handoff<2> handoff(decoder);
+
+  simple1::Test msg;
+  simple1::Test_mref msg_ref = msg.mref();
+  std::vector<char> stream;
+  const uint32_t num_messages = 1000;
+  for (uint32_t i = 0; i < num_messages; ++i) {
+    msg_ref.set_field1().as(i);
+    msg_ref.set_field2().as(i / 4);
+    msg_ref.set_field3().as(3);
+    encoder.encode(msg_ref, stream, i == 0);
+  }
+  const char* first = stream.data();
+  const char* last = first + stream.size();
+
+  REQUIRE(handoff.decode(first, last, true));
+  REQUIRE(handoff.decode(first, last));
+  // both tokens are in flight
+  const char* pending = first;
+  REQUIRE(!handoff.decode(first, last));
+  REQUIRE(first == pending);
+
+  std::size_t token0, token1;
+  message_cref message0, message1;
+  REQUIRE(handoff.consume(token0, message0));
+  REQUIRE(handoff.consume(token1, message1));
+  REQUIRE(!handoff.consume(token1, message1));
+  REQUIRE(token0 != token1);
+  REQUIRE(simple1::Test_cref(message0).get_field1().value() == 0U);
+  REQUIRE(simple1::Test_cref(message1).get_field1().value() == 1U);
+
+  handoff.release(token0);
+  REQUIRE(handoff.decode(first, last));
+  REQUIRE(handoff.consume(token0, message0));
+  REQUIRE(simple1::Test_cref(message0).get_field1().value() == 2U);
+  // the message of a token in flight is not overwritten
+  REQUIRE(simple1::Test_cref(message1).get_field1().value() == 1U);
+  handoff.release(token0);
+  handoff.release(token1);
+
+  uint32_t mismatches = 0;
+  std::thread consumer([&] {
+    std::size_t token;
+    message_cref message;
+    for (uint32_t i = 3; i < num_messages;) {
+      if (!handoff.consume(token, message)) {
+        std::this_thread::yield();
+        continue;
+      }
+      simple1::Test_cref result(message);
+      if (result.get_field1().value() != i || result.get_field2().value() != i / 4)
+        ++mismatches;
+      handoff.release(token);
+      ++i;
+    }
+  });
+
+  while (first != last) {
+    if (!handoff.decode(first, last))
+      std::this_thread::yield();
+  }
+  consumer.join();
+  REQUIRE(mismatches == 0U);
+}
+
+TEST_CASE("test fast encoder v2 for packing messages into packets","[packetizer_test]")
+{
+  fast_encoder_v2 encoder(simple1::description());
+  std::vector<std::vector<char> > packets;
+  const fast_frame_format format = fast_frame_format::block_length();
+  fast_packetizer<fast_encoder_v2> packetizer(encoder, format, 32,
+    [&](const char* data, std::size_t size) {
+      packets.push_back(std::vector<char>(data, data + size));
+    });
+  packetizer.reset_every_packet(true);
+
+  simple1::Test msg;
+  simple1::Test_mref msg_ref = msg.mref();
+  const uint32_t num_messages = 100;
+  for (uint32_t i = 0; i < num_messages; ++i) {
+    msg_ref.set_field1().as(i * 1000);
+    msg_ref.set_field2().as(i);
+    msg_ref.set_field3().as(3);
+    packetizer.encode(msg_ref);
+  }
+  packetizer.flush();
+  REQUIRE(packets.size() > 1);
+
+  uint32_t i = 0;
+  for (auto& packet : packets) {
+    REQUIRE(packet.size() <= 32U);
+    fast_frame_reader reader(format, packet.data(), packet.data() + packet.size());
+    fast_frame frame;
+    REQUIRE(reader.next(frame));
+    REQUIRE(reader.position() == packet.data() + packet.size());
+
+    // each packet is decoded by a decoder of its own
+    fast_decoder_v2<0> decoder(simple1::description());
+    const char* first = frame.payload;
+    const char* last = first + frame.payload_size;
+    for (bool reset = true; first < last; reset = false, ++i) {
+      simple1::Test_cref result(decoder.decode(first, last, reset));
+      REQUIRE(result.get_field1().value() == i * 1000);
+      REQUIRE(result.get_field2().value() == i);
+    }
+  }
+  REQUIRE(i == num_messages);
+}